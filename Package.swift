@@ -129,6 +129,7 @@ let package = Package(
     .testTarget(
       name: "x10Tests",
       dependencies: [
+        "x10_optimizers_optimizer",
         "x10_optimizers_tensor_visitor_plan",
         "TensorFlow"
       ],
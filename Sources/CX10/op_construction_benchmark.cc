@@ -0,0 +1,104 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the throughput of the traced operations construction through the C
+// API, the way the Swift bindings drive it: every operation returns a new
+// tensor handle, which is destroyed once the result is dropped. Reports the
+// heap allocations per operation, and the ObjectPool ones among them.
+// Running it with XLA_TENSOR_POOL=false gives the baseline without the pool.
+// Usage: op_construction_benchmark [ITERATIONS]
+
+#include "xla_tensor_wrapper.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace {
+
+std::atomic<int64_t> g_heap_allocations(0);
+
+int64_t CounterValue(const char* name) {
+  xla::metrics::CounterData* counter = xla::metrics::GetCounter(name);
+  return counter != nullptr ? counter->Value() : 0;
+}
+
+void RunBenchmark(int iterations) {
+  CDevice device = getDefaultDevice();
+  std::vector<float> values(64, 1.0f);
+  size_t shape[] = {8, 8};
+  OpaqueXLATensor* a = copyTensor(XLATensorScalarType_Float, values.data(),
+                                  values.size(), shape, 2, device);
+  OpaqueXLATensor* b = copyTensor(XLATensorScalarType_Float, values.data(),
+                                  values.size(), shape, 2, device);
+  // Warms up the IR values of the inputs, the thread caches and the metrics.
+  for (int i = 0; i < 1000; ++i) {
+    destroyTensor(XLATensor_mul(XLATensor_add(a, b), b));
+  }
+
+  int64_t start_heap = g_heap_allocations;
+  int64_t start_pool_heap = CounterValue("PoolHeapAllocations");
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    OpaqueXLATensor* sum = XLATensor_add(a, b);
+    OpaqueXLATensor* product = XLATensor_mul(sum, b);
+    destroyTensor(sum);
+    destroyTensor(product);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double ops = 2.0 * iterations;
+  std::printf("%.0f ops in %.3f s: %.0f ops/s, %.1f ns/op\n", ops,
+              elapsed.count(), ops / elapsed.count(),
+              elapsed.count() * 1e9 / ops);
+  std::printf("heap allocations/op: %.2f\n",
+              (g_heap_allocations - start_heap) / ops);
+  std::printf("pool heap allocations/op: %.2f\n",
+              (CounterValue("PoolHeapAllocations") - start_pool_heap) / ops);
+  destroyTensor(a);
+  destroyTensor(b);
+}
+
+}  // namespace
+
+// Counts the heap allocations of the process. The blocks reused from the
+// ObjectPool free lists do not get here.
+void* operator new(size_t size) {
+  g_heap_allocations += 1;
+  void* ptr = std::malloc(size != 0 ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+int main(int argc, char** argv) {
+  int iterations = 1000000;
+  if (argc > 1 && (!absl::SimpleAtoi(argv[1], &iterations) || iterations < 1)) {
+    std::fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return 1;
+  }
+  RunBenchmark(iterations);
+  return 0;
+}
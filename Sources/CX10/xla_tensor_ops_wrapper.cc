@@ -399,8 +399,7 @@ xla::XlaOp LowerNllLoss(xla::XlaOp logits, xla::XlaOp labels,
                       ReductionMode::kMean);
 }
 
-xla::XlaOp LowerProd(xla::XlaOp input,
-                     const std::vector<int64_t>& dimensions,
+xla::XlaOp LowerProd(xla::XlaOp input, absl::Span<const int64_t> dimensions,
                      bool keep_reduced_dimensions) {
   xla::XlaOp casted_input;
   casted_input = ConvertToNumeric(input, XlaHelpers::TypeOfXlaOp(input));
@@ -532,6 +531,244 @@ xla::XlaOp BuildTfConv(xla::XlaOp input, xla::XlaOp filter, bool depthwise,
       /*attrs=*/attrs, /*precision_config=*/&precision_config));
 }
 
+// Native shape rules for the most common ops. They compute the output shape
+// straight from the operand shapes, instead of building a throwaway XLA
+// computation with InferOutputShape(). Shapes with dynamic dimensions, and
+// the cases not covered by a rule, still go through the builder.
+
+bool HasStaticShapes(absl::Span<const Value> values) {
+  for (auto& value : values) {
+    if (!value.shape().is_static()) return false;
+  }
+  return true;
+}
+
+xla::Shape InferShapeFromLowering(absl::Span<const Value> operands,
+                                  const LowerForShapeFn& lower_fn) {
+  std::vector<xla::Shape> shapes;
+  shapes.reserve(operands.size());
+  for (auto& operand : operands) {
+    shapes.push_back(operand.shape());
+  }
+  return InferOutputShape(shapes, lower_fn);
+}
+
+template <BinaryOpBuilderWithDim T>
+xla::Shape ShapeBinaryOp(const Value& lhs, const Value& rhs) {
+  if (!HasStaticShapes({lhs, rhs})) {
+    return InferShapeFromLowering(
+        {lhs, rhs}, [](absl::Span<const xla::XlaOp> operands) {
+          return LowerBinaryOp<T>(operands[0], operands[1]);
+        });
+  }
+  return XlaHelpers::GetPromotedBinaryOpShape(lhs.shape(), rhs.shape());
+}
+
+template <BinaryOpBuilderWithDim T>
+xla::Shape ShapeCompareOp(const Value& lhs, const Value& rhs) {
+  xla::Shape result = ShapeBinaryOp<T>(lhs, rhs);
+  result.set_element_type(xla::PrimitiveType::PRED);
+  return result;
+}
+
+using ReduceOpBuilder = xla::XlaOp (*)(xla::XlaOp, absl::Span<const int64_t>,
+                                       bool);
+template <ReduceOpBuilder T>
+xla::Shape ShapeReduce(const Value& input,
+                       absl::Span<const int64_t> dimensions,
+                       bool keep_reduced_dimensions) {
+  const xla::Shape& input_shape = input.shape();
+  bool sorted = std::is_sorted(dimensions.begin(), dimensions.end()) &&
+                std::adjacent_find(dimensions.begin(), dimensions.end()) ==
+                    dimensions.end();
+  if (!input_shape.is_static() || !sorted) {
+    return InferShapeFromLowering(
+        {input}, [&](absl::Span<const xla::XlaOp> operands) {
+          return T(operands[0], dimensions, keep_reduced_dimensions);
+        });
+  }
+  std::vector<int64_t> output_dimensions;
+  size_t idim = 0;
+  for (int64_t i = 0; i < input_shape.rank(); ++i) {
+    if (idim < dimensions.size() && dimensions[idim] == i) {
+      ++idim;
+      if (keep_reduced_dimensions) output_dimensions.push_back(1);
+    } else {
+      output_dimensions.push_back(input_shape.dimensions(i));
+    }
+  }
+  XLA_CHECK_EQ(idim, dimensions.size()) << input_shape;
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(),
+                                   output_dimensions);
+}
+
+xla::Shape ShapeExpand(const Value& input, absl::Span<const int64_t> dims) {
+  const xla::Shape& input_shape = input.shape();
+  if (!input_shape.is_static()) {
+    return InferShapeFromLowering(
+        {input}, [&](absl::Span<const xla::XlaOp> operands) {
+          return BuildExpand(operands[0], dims);
+        });
+  }
+  XLA_CHECK_LE(input_shape.rank(), dims.size()) << input_shape;
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(), dims);
+}
+
+xla::Shape ShapeTranspose(const Value& input, absl::Span<const int64_t> dims) {
+  const xla::Shape& input_shape = input.shape();
+  if (!input_shape.is_static()) {
+    return InferShapeFromLowering(
+        {input}, [&](absl::Span<const xla::XlaOp> operands) {
+          return xla::Transpose(operands[0], dims);
+        });
+  }
+  XLA_CHECK_EQ(input_shape.rank(), dims.size()) << input_shape;
+  std::vector<int64_t> output_dimensions;
+  output_dimensions.reserve(dims.size());
+  for (int64_t dim : dims) {
+    output_dimensions.push_back(input_shape.dimensions(dim));
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(),
+                                   output_dimensions);
+}
+
+xla::Shape ShapeXlaSlice(const Value& input,
+                         absl::Span<const int64_t> start_indices,
+                         absl::Span<const int64_t> limit_indices,
+                         absl::Span<const int64_t> strides) {
+  const xla::Shape& input_shape = input.shape();
+  if (!input_shape.is_static()) {
+    return InferShapeFromLowering(
+        {input}, [&](absl::Span<const xla::XlaOp> operands) {
+          return xla::Slice(operands[0], start_indices, limit_indices,
+                            strides);
+        });
+  }
+  XLA_CHECK_EQ(input_shape.rank(), start_indices.size()) << input_shape;
+  XLA_CHECK_EQ(input_shape.rank(), limit_indices.size()) << input_shape;
+  XLA_CHECK_EQ(input_shape.rank(), strides.size()) << input_shape;
+  std::vector<int64_t> output_dimensions;
+  output_dimensions.reserve(strides.size());
+  for (size_t i = 0; i < strides.size(); ++i) {
+    output_dimensions.push_back(
+        (limit_indices[i] - start_indices[i] + strides[i] - 1) / strides[i]);
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(),
+                                   output_dimensions);
+}
+
+// Returns the output dimensions of a dot between operands of rank 1 or 2, or
+// nullopt for the other ranks.
+absl::optional<std::vector<int64_t>> GetDotDimensions(
+    const xla::Shape& lhs_shape, const xla::Shape& rhs_shape) {
+  if (lhs_shape.rank() < 1 || lhs_shape.rank() > 2 || rhs_shape.rank() < 1 ||
+      rhs_shape.rank() > 2) {
+    return absl::nullopt;
+  }
+  XLA_CHECK_EQ(lhs_shape.dimensions(lhs_shape.rank() - 1),
+               rhs_shape.dimensions(0))
+      << lhs_shape << " and " << rhs_shape;
+  std::vector<int64_t> dimensions;
+  if (lhs_shape.rank() == 2) dimensions.push_back(lhs_shape.dimensions(0));
+  if (rhs_shape.rank() == 2) dimensions.push_back(rhs_shape.dimensions(1));
+  return dimensions;
+}
+
+xla::Shape ShapeDot(const Value& lhs, const Value& rhs) {
+  absl::optional<std::vector<int64_t>> dimensions;
+  if (HasStaticShapes({lhs, rhs})) {
+    dimensions = GetDotDimensions(lhs.shape(), rhs.shape());
+  }
+  if (!dimensions) {
+    return InferShapeFromLowering(
+        {lhs, rhs}, [](absl::Span<const xla::XlaOp> operands) {
+          return xla::Dot(operands[0], operands[1]);
+        });
+  }
+  return xla::ShapeUtil::MakeShape(lhs.shape().element_type(), *dimensions);
+}
+
+xla::Shape ShapeMatMul(const Value& lhs, const Value& rhs) {
+  absl::optional<std::vector<int64_t>> dimensions;
+  if (HasStaticShapes({lhs, rhs})) {
+    dimensions = GetDotDimensions(lhs.shape(), rhs.shape());
+  }
+  if (!dimensions) {
+    return InferShapeFromLowering(
+        {lhs, rhs}, [](absl::Span<const xla::XlaOp> operands) {
+          return LowerBinaryValueOp<CreateMatMul>(operands[0], operands[1]);
+        });
+  }
+  return xla::ShapeUtil::MakeShape(
+      XlaHelpers::PromoteType(lhs.shape().element_type(),
+                              rhs.shape().element_type()),
+      *dimensions);
+}
+
+// Mirrors the TF convolution output size computation (see
+// tensorflow::GetWindowedOutputSizeVerboseV2()), with the spatial dimensions of
+// the filter laid out first, followed by the input and output features.
+xla::Shape ShapeTfConv(const Value& input, const Value& filter, bool depthwise,
+                       absl::Span<const int64_t> strides,
+                       tensorflow::Padding padding,
+                       absl::Span<const int64_t> explicit_paddings,
+                       tensorflow::TensorFormat data_format,
+                       absl::Span<const int64_t> dilations) {
+  auto lower_for_shape_fn = [&](absl::Span<const xla::XlaOp> operands) {
+    return BuildTfConv(operands[0], operands[1], depthwise, strides, padding,
+                       explicit_paddings, data_format, dilations);
+  };
+  const xla::Shape& input_shape = input.shape();
+  const xla::Shape& filter_shape = filter.shape();
+  size_t num_dims = input_shape.rank();
+  int num_spatial_dims = static_cast<int>(num_dims) - 2;
+  if (!HasStaticShapes({input, filter}) || num_spatial_dims < 1 ||
+      filter_shape.rank() != num_dims || strides.size() != num_dims ||
+      dilations.size() != num_dims ||
+      (padding == tensorflow::Padding::EXPLICIT &&
+       explicit_paddings.size() != 2 * num_dims) ||
+      (data_format != tensorflow::FORMAT_NHWC &&
+       data_format != tensorflow::FORMAT_NCHW)) {
+    return InferShapeFromLowering({input, filter}, lower_for_shape_fn);
+  }
+  std::vector<int64_t> dimensions(input_shape.dimensions().begin(),
+                                  input_shape.dimensions().end());
+  int feature_dim = tensorflow::GetTensorFeatureDimIndex(num_dims, data_format);
+  int64_t filter_out_depth = filter_shape.dimensions(num_spatial_dims + 1);
+  dimensions[feature_dim] =
+      depthwise ? input_shape.dimensions(feature_dim) * filter_out_depth
+                : filter_out_depth;
+  for (int i = 0; i < num_spatial_dims; ++i) {
+    int dim = tensorflow::GetTensorSpatialDimIndex(num_dims, data_format, i);
+    int64_t window = (filter_shape.dimensions(i) - 1) * dilations[dim] + 1;
+    int64_t stride = strides[dim];
+    int64_t size = input_shape.dimensions(dim);
+    if (stride <= 0) {
+      // Let the builder report the invalid configuration.
+      return InferShapeFromLowering({input, filter}, lower_for_shape_fn);
+    }
+    switch (padding) {
+      case tensorflow::Padding::VALID:
+        size = (size - window + stride) / stride;
+        break;
+      case tensorflow::Padding::SAME:
+        size = (size + stride - 1) / stride;
+        break;
+      case tensorflow::Padding::EXPLICIT:
+        size = (size + explicit_paddings[2 * dim] +
+                explicit_paddings[2 * dim + 1] - window) /
+                   stride +
+               1;
+        break;
+    }
+    if (size < 0) {
+      return InferShapeFromLowering({input, filter}, lower_for_shape_fn);
+    }
+    dimensions[dim] = size;
+  }
+  return xla::ShapeUtil::MakeShape(input_shape.element_type(), dimensions);
+}
+
 xla::XlaOp BuildTfConvBackpropFilter(
     xla::XlaOp input, absl::Span<const int64_t> filter_sizes,
     xla::XlaOp out_backprop, bool depthwise,
@@ -20,16 +20,27 @@
 
 #include "xla_tensor_wrapper.h"
 
+#include <atomic>
 #include <random>
+#include <stdexcept>
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/background_compiler.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_partitioner.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_optimizer.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_outliner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/token.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_buckets.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/strided_slice_helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 #include "tensorflow/core/util/mirror_pad_mode.h"
 
 using swift_xla::XlaHelpers;
@@ -110,21 +121,20 @@ swift_xla::XLATensor* XLATensor_makeScalar(XLAScalar value,
       atScalar(value), ToScalarType(type), ConvertDevice(cdevice)));
 }
 
+namespace {
+
 // TODO(parkers): reduce copying here...
-swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
-                                 const void* raw_value, size_t num_entries,
-                                 const size_t* shape, size_t rank,
-                                 const struct CDevice device) {
+at::Tensor CopyHostTensor(XLATensorScalarType type, const void* raw_value,
+                          size_t num_entries, const size_t* shape,
+                          size_t rank) {
   switch (type) {
-#define DEFINE_COPY_CASE(name, aten_name, DType)                 \
-  case XLATensorScalarType_##name: {                             \
-    auto* value = reinterpret_cast<const DType*>(raw_value);     \
-    std::unique_ptr<DType[]> data(new DType[num_entries]);       \
-    memcpy(data.get(), value, num_entries * sizeof(DType));      \
-    std::vector<int64_t> dims(shape, shape + rank);              \
-    at::Tensor t(std::move(data), std::move(dims));              \
-    return new swift_xla::XLATensor(                             \
-        swift_xla::XLATensor::Create(t, ConvertDevice(device))); \
+#define DEFINE_COPY_CASE(name, aten_name, DType)             \
+  case XLATensorScalarType_##name: {                         \
+    auto* value = reinterpret_cast<const DType*>(raw_value); \
+    std::unique_ptr<DType[]> data(new DType[num_entries]);   \
+    memcpy(data.get(), value, num_entries * sizeof(DType));  \
+    std::vector<int64_t> dims(shape, shape + rank);          \
+    return at::Tensor(std::move(data), std::move(dims));     \
   }
     LIST_SCALAR_TYPES(DEFINE_COPY_CASE)
 #undef DEFINE_COPY_CASE
@@ -132,6 +142,32 @@ swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
       LOG(FATAL) << "Invalid type: " << type;
   }
 }
+
+}  // namespace
+
+swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
+                                 const void* raw_value, size_t num_entries,
+                                 const size_t* shape, size_t rank,
+                                 const struct CDevice device) {
+  return new swift_xla::XLATensor(swift_xla::XLATensor::Create(
+      CopyHostTensor(type, raw_value, num_entries, shape, rank),
+      ConvertDevice(device)));
+}
+
+OpaqueXLATensor* copyTensorBucketed(enum XLATensorScalarType type,
+                                    const void* value, size_t num_entries,
+                                    const size_t* shape, size_t rank,
+                                    const struct CDevice device) {
+  return new swift_xla::XLATensor(swift_xla::CreateBucketedTensor(
+      CopyHostTensor(type, value, num_entries, shape, rank),
+      ConvertDevice(device)));
+}
+
+void SetShapeBuckets(int64_t dim, const int64_t* boundaries, size_t count) {
+  swift_xla::SetShapeBuckets(
+      dim, std::vector<int64_t>(boundaries, boundaries + count));
+}
+
 OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
                                            const void* value,
                                            size_t num_entries,
@@ -179,10 +215,21 @@ OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t) {
   // Avoid barriers for fetching trivial local tensors.
   auto current_tensor = t->CurrentTensorData();
   if (current_tensor) return new at::Tensor(std::move(*current_tensor));
+  // Same for tiny graphs over host resident values.
+  if (t->TryEvaluateOnHost()) return new at::Tensor(*t->CurrentTensorData());
   t->ApplyPendingGraph();
   return new at::Tensor(t->ToTensor(/*detached=*/false));
 }
 
+void XLATensor_materializeMany(OpaqueXLATensorArrayRef tensors,
+                               OpaqueMaterializedTensor** results) {
+  std::vector<XLATensor> xla_tensors = tensors.array();
+  std::vector<at::Tensor> materialized = XLATensor::GetTensors(&xla_tensors);
+  for (size_t i = 0; i < materialized.size(); ++i) {
+    results[i] = new at::Tensor(std::move(materialized[i]));
+  }
+}
+
 enum XLATensorScalarType MaterializedTensor_getType(
     OpaqueMaterializedTensor* t) {
   return FromScalarType(t->scalar_type());
@@ -283,6 +330,106 @@ void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec) {
   delete strided_slice_spec;
 }
 
+OpaqueXLAPrefetcher* XLAPrefetcher_create(const struct CDevice device,
+                                          size_t depth) {
+  return new swift_xla::InputPrefetcher(ConvertDevice(device), depth);
+}
+
+void destroyXLAPrefetcher(OpaqueXLAPrefetcher* prefetcher) {
+  delete prefetcher;
+}
+
+void XLAPrefetcher_enqueue(OpaqueXLAPrefetcher* prefetcher,
+                           const enum XLATensorScalarType* types,
+                           const void* const* values, const size_t* num_entries,
+                           const size_t* const* shapes, const size_t* ranks,
+                           size_t count) {
+  std::vector<at::Tensor> tensors;
+  tensors.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<int64_t> dims(shapes[i], shapes[i] + ranks[i]);
+    tensors.push_back(swift_xla::InputPrefetcher::Stage(
+        ToScalarType(types[i]), values[i], num_entries[i], std::move(dims)));
+  }
+  prefetcher->Enqueue(std::move(tensors));
+}
+
+OpaqueXLATensorArrayRef XLAPrefetcher_dequeue(
+    OpaqueXLAPrefetcher* prefetcher) {
+  return ConvertTensorList(prefetcher->Dequeue());
+}
+
+OpaqueXLACheckpoint* XLACheckpoint_open(const char* path) {
+  return new swift_xla::CheckpointLoader(path);
+}
+
+void destroyXLACheckpoint(OpaqueXLACheckpoint* checkpoint) {
+  delete checkpoint;
+}
+
+size_t XLACheckpoint_count(OpaqueXLACheckpoint* checkpoint) {
+  return checkpoint->entries().size();
+}
+
+const char* XLACheckpoint_name(OpaqueXLACheckpoint* checkpoint, size_t index) {
+  return checkpoint->entries().at(index).name.c_str();
+}
+
+OpaqueXLATensorArrayRef XLACheckpoint_load(OpaqueXLACheckpoint* checkpoint,
+                                           const struct CDevice device) {
+  return ConvertTensorList(checkpoint->Load(ConvertDevice(device)));
+}
+
+OpaqueXLACheckpointWriter* XLACheckpointWriter_start(
+    const char* path, const char* const* names,
+    OpaqueXLATensorArrayRef tensors, bool compress) {
+  return new swift_xla::CheckpointWriter(
+      path, std::vector<std::string>(names, names + tensors.size),
+      tensors.array(), compress);
+}
+
+void destroyXLACheckpointWriter(OpaqueXLACheckpointWriter* writer) {
+  delete writer;
+}
+
+bool XLACheckpointWriter_isDone(OpaqueXLACheckpointWriter* writer) {
+  return writer->IsDone();
+}
+
+size_t XLACheckpointWriter_wait(OpaqueXLACheckpointWriter* writer) {
+  return writer->Wait();
+}
+
+OpaqueXLAFlatParameterGroup* XLAFlatParameterGroup_create(
+    OpaqueXLATensorArrayRef tensors) {
+  return new swift_xla::FlatParameterGroup(tensors.array());
+}
+
+void destroyXLAFlatParameterGroup(OpaqueXLAFlatParameterGroup* group) {
+  delete group;
+}
+
+OpaqueXLATensor* XLAFlatParameterGroup_buffer(
+    OpaqueXLAFlatParameterGroup* group) {
+  return new XLATensor(group->buffer());
+}
+
+void XLAFlatParameterGroup_setBuffer(OpaqueXLAFlatParameterGroup* group,
+                                     OpaqueXLATensor* buffer) {
+  group->set_buffer(*buffer);
+}
+
+OpaqueXLATensor* XLAFlatParameterGroup_pack(OpaqueXLAFlatParameterGroup* group,
+                                            OpaqueXLATensorArrayRef tensors) {
+  return new XLATensor(group->Pack(tensors.array()));
+}
+
+OpaqueXLATensorArrayRef XLAFlatParameterGroup_unpack(
+    OpaqueXLAFlatParameterGroup* group, OpaqueXLATensor* flat) {
+  return ConvertTensorList(flat != nullptr ? group->Unpack(*flat)
+                                           : group->Unpack());
+}
+
 // Ops.
 OpaqueXLATensor* XLATensor_annotate(OpaqueXLATensor* a,
                                     const char* annotation) {
@@ -305,6 +452,25 @@ OpaqueXLATensorArrayRef XLATensor_cross_replica_sum(
   const auto& result_tensors = reduced_and_token.first;
   return ConvertTensorList(result_tensors);
 }
+OpaqueXLATensorArrayRef XLATensor_multi_tensor_adam(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef first_moments,
+    OpaqueXLATensorArrayRef second_moments, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* beta1, OpaqueXLATensor* beta2,
+    OpaqueXLATensor* weight_decay, double epsilon) {
+  return ConvertTensorList(XLATensor::multi_tensor_adam(
+      weights.array(), grads.array(), first_moments.array(),
+      second_moments.array(), *learning_rate, *beta1, *beta2, *weight_decay,
+      epsilon));
+}
+OpaqueXLATensorArrayRef XLATensor_multi_tensor_sgd(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef velocities, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* momentum, OpaqueXLATensor* weight_decay, bool nesterov) {
+  return ConvertTensorList(XLATensor::multi_tensor_sgd(
+      weights.array(), grads.array(), velocities.array(), *learning_rate,
+      *momentum, *weight_decay, nesterov));
+}
 OpaqueString* XLATensor_get_annotations(OpaqueXLATensor* a) {
   std::string ir_dag_text =
       swift_xla::ir::DumpUtil::GetAnnotations({a->GetIrValue().node.get()});
@@ -361,6 +527,102 @@ void SetMatMulPrecision(bool use_full_precision) {
                                         ? xla::PrecisionConfig::HIGHEST
                                         : xla::PrecisionConfig::DEFAULT);
 }
+void SetIrOptimization(bool enabled) {
+  swift_xla::ir::SetGraphOptimizationEnabled(enabled);
+}
+void SetIrOutlining(bool enabled) {
+  swift_xla::ir::SetGraphOutliningEnabled(enabled);
+}
+void SetOpByOpExecution(bool enabled, bool split_chained) {
+  XLATensor::SetSyncTensorsOpByOp(enabled);
+  xla::XrtComputationClient::SetSplitChainedExecution(split_chained);
+}
+void SetGraphPartitioning(bool enabled) {
+  swift_xla::GraphPartitioner::SetEnabled(enabled);
+}
+void SetBackgroundCompilation(bool enabled) {
+  swift_xla::BackgroundCompiler::SetEnabled(enabled);
+}
+void SetParallelLowering(bool enabled, int64_t min_nodes) {
+  XLATensor::SetParallelLowering(enabled, min_nodes);
+}
+int64_t RunMultiWaitChecks(int64_t rounds) {
+  constexpr size_t kTasks = 64;
+  std::atomic<int64_t> failures(0);
+  auto check = [&failures](bool ok) {
+    if (!ok) {
+      failures += 1;
+    }
+  };
+  auto waits_with_exception = [](xla::util::MultiWait* mwait) {
+    try {
+      mwait->Wait();
+    } catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  for (int64_t round = 0; round < rounds; ++round) {
+    // An empty fan-out is completed from the start.
+    {
+      xla::util::MultiWait mwait(0);
+      mwait.Wait();
+      bool called = false;
+      mwait.OnDone([&](std::exception_ptr exptr) {
+        called = true;
+        check(exptr == nullptr);
+      });
+      check(called);
+    }
+    // The continuation is set before the completions, or races with them
+    // (odd rounds), and one of the completers throws. The continuation runs
+    // after the waiters are released, so it signals its own MultiWait.
+    {
+      xla::util::MultiWait mwait(kTasks);
+      xla::util::MultiWait callback_done(1);
+      std::atomic<size_t> runs(0);
+      std::atomic<int> calls(0);
+      auto on_done = [&](std::exception_ptr exptr) {
+        calls += 1;
+        check(exptr != nullptr);
+        check(runs.load() == kTasks);
+        callback_done.Done();
+      };
+      if (round % 2 == 0) {
+        mwait.OnDone(on_done);
+      }
+      for (size_t i = 0; i < kTasks; ++i) {
+        xla::env::ScheduleClosure(mwait.Completer([&runs, i, round]() {
+          runs += 1;
+          if (i == static_cast<size_t>(round) % kTasks) {
+            throw std::runtime_error("MultiWait check failure");
+          }
+        }));
+      }
+      if (round % 2 != 0) {
+        mwait.OnDone(on_done);
+      }
+      check(waits_with_exception(&mwait));
+      callback_done.Wait();
+      check(calls.load() == 1);
+    }
+    // The continuation is set after the completions, and runs right away.
+    {
+      xla::util::MultiWait mwait(kTasks);
+      for (size_t i = 0; i < kTasks; ++i) {
+        xla::env::ScheduleClosure(mwait.Completer([]() {}));
+      }
+      mwait.Wait();
+      int calls = 0;
+      mwait.OnDone([&](std::exception_ptr exptr) {
+        calls += 1;
+        check(exptr == nullptr);
+      });
+      check(calls == 1);
+    }
+  }
+  return failures.load();
+}
 StridedSliceSpec* ComputeIndexingBoundsAndStrides(
     Int64ArrayRef input_sizes, Int64ArrayRef begin, Int64ArrayRef end,
     Int64ArrayRef strides, int32_t begin_mask, int32_t end_mask,
@@ -379,5 +641,33 @@ StridedSliceSpec* ComputeIndexingBoundsAndStrides(
 void PrintMetrics() {
   LOG(INFO) << "Metrics:\n" << xla::metrics::CreateMetricReport();
 }
+int64_t GetCounterValue(const char* name) {
+  xla::metrics::CounterData* counter = xla::metrics::GetCounter(name);
+  return counter != nullptr ? counter->Value() : 0;
+}
+OpaqueString* XLATensor_device_memory_snapshot(const struct CDevice* device) {
+  swift_xla::Device tmp_device;
+  if (device) tmp_device = ConvertDevice(*device);
+  const swift_xla::Device* converted_device = device ? &tmp_device : nullptr;
+  return new std::string(swift_xla::DeviceMemorySnapshotsToString(
+      swift_xla::XLATensor::GetDeviceMemorySnapshots(converted_device)));
+}
+OpaqueString* XLATensor_graph_profile_report(size_t top_k) {
+  swift_xla::GraphProfiler* profiler = swift_xla::GraphProfiler::Get();
+  if (profiler == nullptr) {
+    return new std::string(
+        "Graph profiling is disabled, set XLA_GRAPH_PROFILE=1 to enable it.\n");
+  }
+  return new std::string(profiler->CreateReport(top_k));
+}
+void XLATensor_graph_profile_reset() {
+  swift_xla::GraphProfiler* profiler = swift_xla::GraphProfiler::Get();
+  if (profiler != nullptr) {
+    profiler->Reset();
+  }
+}
+void SetGraphProfiling(bool enabled) {
+  swift_xla::GraphProfiler::SetEnabled(enabled);
+}
 void DeleteString(OpaqueString* str) { delete str; }
 const char* GetStringCStr(OpaqueString* str) { return str->c_str(); }
@@ -28,6 +28,9 @@
 #endif
 
 #ifdef __cplusplus
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/flat_parameter_group.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/input_prefetcher.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 using OpaqueMaterializedTensor = at::Tensor;
@@ -35,6 +38,10 @@ using OpaqueXLATensor = swift_xla::XLATensor;
 using OpaqueXLAShape = xla::util::MaybeRef<xla::Shape>;
 using XLAAnnotationScope = tensorflow::profiler::TraceMe;
 using OpaqueString = std::string;
+using OpaqueXLAPrefetcher = swift_xla::InputPrefetcher;
+using OpaqueXLACheckpoint = swift_xla::CheckpointLoader;
+using OpaqueXLACheckpointWriter = swift_xla::CheckpointWriter;
+using OpaqueXLAFlatParameterGroup = swift_xla::FlatParameterGroup;
 extern "C" {
 #else
 typedef struct OpaqueXLATensor {
@@ -47,6 +54,14 @@ typedef struct XLAAnnotationScope {
 } XLAAnnotationScope;
 typedef struct OpaqueString {
 } OpaqueString;
+typedef struct OpaqueXLAPrefetcher {
+} OpaqueXLAPrefetcher;
+typedef struct OpaqueXLACheckpoint {
+} OpaqueXLACheckpoint;
+typedef struct OpaqueXLACheckpointWriter {
+} OpaqueXLACheckpointWriter;
+typedef struct OpaqueXLAFlatParameterGroup {
+} OpaqueXLAFlatParameterGroup;
 #endif
 
 XLA_API XLAAnnotationScope* MakeAnnotationScope(const char* scope);
@@ -107,8 +122,26 @@ XLA_API OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type
                                                    size_t rank,
                                                    const struct CDevice device,
                                                    bool to_reduced_precision);
+// Same as copyTensor, but pads the dimensions which have bucket boundaries to
+// their bucket, with the real sizes carried as dynamic dimensions. Inputs whose
+// sizes vary from step to step then share compilations.
+XLA_API OpaqueXLATensor* copyTensorBucketed(enum XLATensorScalarType type,
+                                            const void* value,
+                                            size_t num_entries,
+                                            const size_t* shape, size_t rank,
+                                            const struct CDevice device);
+// Sets the bucket boundaries used by copyTensorBucketed for dimension dim. An
+// empty list disables bucketing for dim.
+XLA_API void SetShapeBuckets(int64_t dim, const int64_t* boundaries,
+                             size_t count);
 XLA_API void destroyTensor(OpaqueXLATensor* t);
 XLA_API OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t);
+// Materializes all the tensors at once, which must live on the same device:
+// their pending graphs are synced as a single fused graph, and their values
+// fetched in a single transfer. Stores the tensors.size materialized tensors
+// in results, in order.
+XLA_API void XLATensor_materializeMany(OpaqueXLATensorArrayRef tensors,
+                                       OpaqueMaterializedTensor** results);
 XLA_API void destroyMaterializedTensor(OpaqueMaterializedTensor* t);
 XLA_API const void* MaterializedTensor_getData(OpaqueMaterializedTensor* t);
 XLA_API enum XLATensorScalarType MaterializedTensor_getType(
@@ -226,6 +259,74 @@ void destroyOpaqueXLATensorArrayRef(OpaqueXLATensorArrayRef tensor_list);
 
 XLA_API void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec);
 
+// Input prefetching:
+
+// Creates a prefetcher which uploads up to `depth` batches to the device ahead
+// of their use.
+XLA_API OpaqueXLAPrefetcher* XLAPrefetcher_create(const struct CDevice device,
+                                                  size_t depth);
+XLA_API void destroyXLAPrefetcher(OpaqueXLAPrefetcher* prefetcher);
+// Copies a batch of `count` host tensors into staging memory and queues it for
+// upload. Blocks while `depth` batches are already queued.
+XLA_API void XLAPrefetcher_enqueue(OpaqueXLAPrefetcher* prefetcher,
+                                   const enum XLATensorScalarType* types,
+                                   const void* const* values,
+                                   const size_t* num_entries,
+                                   const size_t* const* shapes,
+                                   const size_t* ranks, size_t count);
+// Returns the device tensors of the oldest queued batch, waiting for its upload
+// to complete if needed.
+XLA_API OpaqueXLATensorArrayRef
+XLAPrefetcher_dequeue(OpaqueXLAPrefetcher* prefetcher);
+
+// Checkpoint loading:
+
+// Memory maps the X10 checkpoint file at `path`, and parses its index.
+XLA_API OpaqueXLACheckpoint* XLACheckpoint_open(const char* path);
+XLA_API void destroyXLACheckpoint(OpaqueXLACheckpoint* checkpoint);
+XLA_API size_t XLACheckpoint_count(OpaqueXLACheckpoint* checkpoint);
+XLA_API const char* XLACheckpoint_name(OpaqueXLACheckpoint* checkpoint,
+                                       size_t index);
+// Uploads all the tensors of the checkpoint to the device, in bounded chunks
+// read straight out of the mapped file. The tensors are returned in index
+// order.
+XLA_API OpaqueXLATensorArrayRef
+XLACheckpoint_load(OpaqueXLACheckpoint* checkpoint, const struct CDevice device);
+
+// Checkpoint writing:
+
+// Captures the device data of `tensors` (synced with their pending IR), and
+// writes them as an X10 checkpoint at `path` in the background, optionally
+// Snappy compressed. The training can go on while the checkpoint is written.
+XLA_API OpaqueXLACheckpointWriter*
+XLACheckpointWriter_start(const char* path, const char* const* names,
+                          OpaqueXLATensorArrayRef tensors, bool compress);
+// Waits for the checkpoint to be written, logging any error.
+XLA_API void destroyXLACheckpointWriter(OpaqueXLACheckpointWriter* writer);
+XLA_API bool XLACheckpointWriter_isDone(OpaqueXLACheckpointWriter* writer);
+// Waits for the checkpoint to be written, and returns its size in bytes.
+XLA_API size_t XLACheckpointWriter_wait(OpaqueXLACheckpointWriter* writer);
+
+// Flat parameter groups:
+
+// Packs `tensors`, which share their element type and device, into a single
+// flat device buffer, so that the step graphs take one parameter for them all.
+XLA_API OpaqueXLAFlatParameterGroup*
+XLAFlatParameterGroup_create(OpaqueXLATensorArrayRef tensors);
+XLA_API void destroyXLAFlatParameterGroup(OpaqueXLAFlatParameterGroup* group);
+XLA_API OpaqueXLATensor* XLAFlatParameterGroup_buffer(
+    OpaqueXLAFlatParameterGroup* group);
+// Replaces the buffer of the group, which must keep its layout.
+XLA_API void XLAFlatParameterGroup_setBuffer(OpaqueXLAFlatParameterGroup* group,
+                                             OpaqueXLATensor* buffer);
+// Packs tensors with the shapes of the group (e.g. gradients) in its layout.
+XLA_API OpaqueXLATensor* XLAFlatParameterGroup_pack(
+    OpaqueXLAFlatParameterGroup* group, OpaqueXLATensorArrayRef tensors);
+// Returns views of the logical tensors of the group within `flat`, or within
+// the buffer of the group when `flat` is null.
+XLA_API OpaqueXLATensorArrayRef XLAFlatParameterGroup_unpack(
+    OpaqueXLAFlatParameterGroup* group, OpaqueXLATensor* flat);
+
 // Ops:
 XLA_API OpaqueXLATensor* XLATensor_abs(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_acos(OpaqueXLATensor* a);
@@ -331,6 +432,19 @@ XLA_API OpaqueXLATensor*
 XLATensor_minimum(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_mul(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_mm(OpaqueXLATensor* a, OpaqueXLATensor* b);
+// Fused optimizer updates over groups of weights, lowered to a single IR node.
+// The hyperparameters are scalar tensors. Return the updated weights, followed
+// by the updated optimizer states, in the order of the arguments.
+XLA_API OpaqueXLATensorArrayRef XLATensor_multi_tensor_adam(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef first_moments,
+    OpaqueXLATensorArrayRef second_moments, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* beta1, OpaqueXLATensor* beta2,
+    OpaqueXLATensor* weight_decay, double epsilon);
+XLA_API OpaqueXLATensorArrayRef XLATensor_multi_tensor_sgd(
+    OpaqueXLATensorArrayRef weights, OpaqueXLATensorArrayRef grads,
+    OpaqueXLATensorArrayRef velocities, OpaqueXLATensor* learning_rate,
+    OpaqueXLATensor* momentum, OpaqueXLATensor* weight_decay, bool nesterov);
 XLA_API OpaqueXLATensor* XLATensor_ne(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_neg(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_nll_loss(OpaqueXLATensor* input,
@@ -442,12 +556,62 @@ XLA_API OpaqueXLATensor* XLATensor_rand(Int64ArrayRef size, int64_t seed);
 // backend. Only used for testing, it has a substantial performance cost.
 XLA_API void SetMatMulPrecision(bool use_full_precision);
 
+// Sets whether the step graphs are optimized before being compiled, overriding
+// XLA_IR_OPTIMIZE. Only used for testing.
+XLA_API void SetIrOptimization(bool enabled);
+
+// Sets whether the repeated subgraphs of the step graphs are outlined before
+// being compiled, overriding XLA_IR_OUTLINE. Only used for testing.
+XLA_API void SetIrOutlining(bool enabled);
+
+// Sets whether the step graphs are run op by op, with the chained ops split
+// into one execution each when split_chained is true, overriding
+// XLA_SYNC_TENSORS_OPBYOP and XRT_SPLIT_CHAINED_EXEC. Only used for testing.
+XLA_API void SetOpByOpExecution(bool enabled, bool split_chained);
+
+// Sets whether the step graphs are partitioned at the cut points found between
+// their variants, overriding XLA_GRAPH_PARTITION. Only used for testing.
+XLA_API void SetGraphPartitioning(bool enabled);
+
+// Sets whether the graphs missing from the computation cache are compiled in
+// background, overriding XLA_BACKGROUND_COMPILE. Only used for testing.
+XLA_API void SetBackgroundCompilation(bool enabled);
+
+// Sets whether the graphs of at least min_nodes nodes are lowered in parallel,
+// overriding XLA_PARALLEL_LOWERING and XLA_PARALLEL_LOWERING_MIN_NODES, and
+// drops the cached computations. Only used for testing.
+XLA_API void SetParallelLowering(bool enabled, int64_t min_nodes);
+
+// Runs rounds of MultiWait fan-outs on the thread pool, with failing
+// completers and with continuations set before and after the completions, and
+// returns the number of failed checks. Only used for testing.
+XLA_API int64_t RunMultiWaitChecks(int64_t rounds);
+
 XLA_API StridedSliceSpec* ComputeIndexingBoundsAndStrides(
     Int64ArrayRef input_sizes, Int64ArrayRef begin, Int64ArrayRef end,
     Int64ArrayRef strides, int32_t begin_mask, int32_t end_mask,
     int32_t ellipsis_mask, int32_t new_axis_mask, int32_t shrink_axis_mask);
 
 XLA_API void PrintMetrics();
+// Returns the value of the given counter, zero if it was never incremented.
+// Only used for testing.
+XLA_API int64_t GetCounterValue(const char* name);
+
+// Returns a report of the device memory held by the live buffers of the given
+// device (or of all the devices, if null), its high-water marks for the current
+// and the previous step, and its attribution to the IR scopes which computed
+// the buffers.
+XLA_API OpaqueString* XLATensor_device_memory_snapshot(
+    const struct CDevice* device);
+
+// Returns a report of the `top_k` computations (all of them if zero) which took
+// the most execution time, keyed by graph hash, with their compile times, sizes
+// and IR scopes. Requires XLA_GRAPH_PROFILE.
+XLA_API OpaqueString* XLATensor_graph_profile_report(size_t top_k);
+XLA_API void XLATensor_graph_profile_reset();
+// Enables or disables the graph profiling, overriding XLA_GRAPH_PROFILE. Only
+// used for testing.
+XLA_API void SetGraphProfiling(bool enabled);
 
 // Randomly shuffles the array defined by (data, size) by seed and then
 // returns the result.
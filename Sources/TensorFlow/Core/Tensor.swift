@@ -179,6 +179,19 @@ extension Tensor {
     }
     return array.scalars
   }
+
+  /// Returns the scalars of each of the given tensors.
+  ///
+  /// When all the tensors live on the same XLA device, their pending computations run as a single
+  /// graph and their values are fetched with a single transfer.
+  public static func scalars(of tensors: [Tensor]) -> [[Scalar]] {
+    guard let device = tensors.first?.device, device.backend == .XLA,
+      tensors.allSatisfy({ $0.device == device })
+    else {
+      return tensors.map { $0.scalars }
+    }
+    return XLATensor.fetchTensorValues(tensors.map { $0.xlaTensor }, Scalar.self)
+  }
 }
 
 extension Tensor where Scalar: TensorFlowFloatingPoint {
@@ -241,3 +241,17 @@ public func LazyTensorBarrier(on device: Device? = nil, devices: [Device] = [],
     }
   }
 }
+
+/// Returns a report of the device memory held by the live tensors (on device if provided), with
+/// the high-water marks of the current and the previous step, attributed to the IR scopes which
+/// computed them. Useful to track leaks and to size the batches.
+public func DeviceMemorySnapshot(on device: Device? = nil) -> String {
+  let str: UnsafeMutablePointer<OpaqueString>
+  if var cdevice = device?.cdevice {
+    str = XLATensor_device_memory_snapshot(&cdevice)
+  } else {
+    str = XLATensor_device_memory_snapshot(nil)
+  }
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
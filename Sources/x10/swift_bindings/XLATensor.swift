@@ -171,6 +171,33 @@ extension XLATensor {
     return (data: data, dims: dims)
   }
 
+  /// Fetches the values of all the tensors, which must live on the same device, with a single
+  /// fused computation and a single transfer.
+  static func fetchTensorValues<Scalar: XLAScalarType>(
+    _ tensors: [XLATensor], _ t: Scalar.Type
+  ) -> [[Scalar]] {
+    var materialized = [UnsafeMutablePointer<OpaqueMaterializedTensor>?](
+      repeating: nil, count: tensors.count)
+    tensors.withArrayRef { tensorsRef in
+      materialized.withUnsafeMutableBufferPointer { results in
+        XLATensor_materializeMany(tensorsRef, results.baseAddress)
+      }
+    }
+    return zip(tensors, materialized).map { (tensor, materialized) in
+      let count = tensor.shape.reduce(1, *)
+      precondition(
+        MaterializedTensor_getType(materialized) == Scalar.xlaTensorScalarType,
+        "Types mismatch when fetching tensor values.")
+      let data = Array(
+        UnsafeBufferPointer(
+          start:
+            UnsafePointer<Scalar>(OpaquePointer(MaterializedTensor_getData(materialized))),
+          count: count))
+      destroyMaterializedTensor(materialized)
+      return data
+    }
+  }
+
   var dtype: XLATensorScalarType {
     defer { _fixLifetime(self) }
     return XLATensor_dtype(handle)
@@ -367,6 +394,65 @@ extension XLATensor {
     }
   }
 
+  static func multiTensorAdam(
+    weights: [XLATensor], grads: [XLATensor], firstMoments: [XLATensor],
+    secondMoments: [XLATensor], learningRate: XLATensor, beta1: XLATensor, beta2: XLATensor,
+    weightDecay: XLATensor, epsilon: Double
+  ) -> (weights: [XLATensor], firstMoments: [XLATensor], secondMoments: [XLATensor]) {
+    defer { _fixLifetime(learningRate) }
+    defer { _fixLifetime(beta1) }
+    defer { _fixLifetime(beta2) }
+    defer { _fixLifetime(weightDecay) }
+    let results: [XLATensor] = weights.withArrayRef { weightsRef in
+      grads.withArrayRef { gradsRef in
+        firstMoments.withArrayRef { firstMomentsRef in
+          secondMoments.withArrayRef { secondMomentsRef in
+            let tensorListHandle = XLATensor_multi_tensor_adam(
+              weightsRef, gradsRef, firstMomentsRef, secondMomentsRef, learningRate.handle,
+              beta1.handle, beta2.handle, weightDecay.handle, epsilon)
+            defer {
+              destroyOpaqueXLATensorArrayRef(tensorListHandle)
+            }
+            return (0..<tensorListHandle.size).map { i in
+              XLATensor(_handle: tensorListHandle.data[i]!)
+            }
+          }
+        }
+      }
+    }
+    let count = weights.count
+    return (
+      Array(results[0..<count]), Array(results[count..<2 * count]),
+      Array(results[2 * count..<3 * count])
+    )
+  }
+
+  static func multiTensorSGD(
+    weights: [XLATensor], grads: [XLATensor], velocities: [XLATensor],
+    learningRate: XLATensor, momentum: XLATensor, weightDecay: XLATensor, nesterov: Bool
+  ) -> (weights: [XLATensor], velocities: [XLATensor]) {
+    defer { _fixLifetime(learningRate) }
+    defer { _fixLifetime(momentum) }
+    defer { _fixLifetime(weightDecay) }
+    let results: [XLATensor] = weights.withArrayRef { weightsRef in
+      grads.withArrayRef { gradsRef in
+        velocities.withArrayRef { velocitiesRef in
+          let tensorListHandle = XLATensor_multi_tensor_sgd(
+            weightsRef, gradsRef, velocitiesRef, learningRate.handle, momentum.handle,
+            weightDecay.handle, nesterov)
+          defer {
+            destroyOpaqueXLATensorArrayRef(tensorListHandle)
+          }
+          return (0..<tensorListHandle.size).map { i in
+            XLATensor(_handle: tensorListHandle.data[i]!)
+          }
+        }
+      }
+    }
+    let count = weights.count
+    return (Array(results[0..<count]), Array(results[count..<2 * count]))
+  }
+
   static func irText(_ a: XLATensor) -> String {
     let str = XLATensor_ir_text(a.handle)
     defer { DeleteString(str) }
@@ -495,3 +581,17 @@ extension XLATensor {
 public func PrintX10Metrics() {
   PrintMetrics()
 }
+
+/// Returns a report of the `k` computations (all of them if zero) which took the most execution
+/// time, with their execution and compile times, sizes and the IR scopes they were traced in.
+/// Requires the `XLA_GRAPH_PROFILE` environment variable to be set.
+public func GraphProfileReport(top k: Int = 10) -> String {
+  let str = XLATensor_graph_profile_report(k)
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Clears the statistics reported by `GraphProfileReport`.
+public func ResetGraphProfile() {
+  XLATensor_graph_profile_reset()
+}
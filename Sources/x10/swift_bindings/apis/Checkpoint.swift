@@ -0,0 +1,117 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Reads a checkpoint in the X10 format, a set of named dense tensors laid out to be uploaded to a
+/// device straight out of the memory mapped file.
+///
+/// The tensors are uploaded in chunks of about `XLA_CHECKPOINT_CHUNK_SIZE` bytes, so the peak host
+/// memory usage does not depend on the size of the checkpoint.
+public final class XLACheckpointReader {
+  private let handle: UnsafeMutablePointer<OpaqueXLACheckpoint>
+
+  /// Maps the checkpoint file at `path`, and parses its index.
+  public init(path: String) {
+    handle = XLACheckpoint_open(path)
+  }
+
+  deinit { destroyXLACheckpoint(handle) }
+
+  /// The names of the tensors of the checkpoint, in the order they were written in.
+  public var names: [String] {
+    (0..<XLACheckpoint_count(handle)).map { String(cString: XLACheckpoint_name(handle, $0)) }
+  }
+
+  /// Uploads all the tensors of the checkpoint to `device`, and returns them by name.
+  public func load(on device: Device = Device.defaultXLA) -> [String: AnyTensor] {
+    precondition(device.backend == .XLA, "Checkpoint loading requires an XLA device.")
+    let tensorListHandle = XLACheckpoint_load(handle, device.cdevice)
+    defer {
+      destroyOpaqueXLATensorArrayRef(tensorListHandle)
+    }
+    return Dictionary(
+      uniqueKeysWithValues: zip(
+        names,
+        (0..<tensorListHandle.size).map { i in
+          wrapCheckpointTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+        }))
+  }
+}
+
+/// Writes a checkpoint in the X10 format in the background, while the training goes on.
+///
+/// The device data of the tensors is captured when the writer is created (ideally right after a
+/// `LazyTensorBarrier()`, once the step has been synced), and fetched from the device in chunks of
+/// at most `XLA_CHECKPOINT_WRITE_BUFFER_SIZE` bytes. The checkpoint is written next to its path,
+/// and renamed once complete, so it can be read by `XLACheckpointReader`.
+public final class XLACheckpointWriter {
+  private let handle: UnsafeMutablePointer<OpaqueXLACheckpointWriter>
+
+  /// Starts writing `tensors`, which must all live on the same XLA device, to the checkpoint at
+  /// `path`, with their contents Snappy compressed if `compress` is true.
+  public init(path: String, tensors: [String: AnyTensor], compress: Bool = false) {
+    let names = tensors.keys.sorted()
+    handle = withCStrings(names) { cNames in
+      names.map { tensors[$0]! }.withArrayRef { tensorsRef in
+        XLACheckpointWriter_start(path, cNames, tensorsRef, compress)
+      }
+    }
+  }
+
+  /// Waits for the checkpoint to be written. The errors are logged.
+  deinit { destroyXLACheckpointWriter(handle) }
+
+  /// Whether the checkpoint has been written, or failed to.
+  public var isDone: Bool { XLACheckpointWriter_isDone(handle) }
+
+  /// Waits for the checkpoint to be written, and returns its size in bytes.
+  public func wait() -> Int {
+    XLACheckpointWriter_wait(handle)
+  }
+}
+
+/// Calls `body` with null terminated copies of `strings`.
+private func withCStrings<Result>(
+  _ strings: [String], _ body: ([UnsafePointer<CChar>?]) -> Result
+) -> Result {
+  var cStrings: [UnsafePointer<CChar>?] = []
+  cStrings.reserveCapacity(strings.count)
+  func recurse(_ index: Int) -> Result {
+    if index == strings.count {
+      return body(cStrings)
+    }
+    return strings[index].withCString { cString in
+      cStrings.append(cString)
+      return recurse(index + 1)
+    }
+  }
+  return recurse(0)
+}
+
+/// The scalar types which the checkpoint tensors can have.
+private let checkpointScalarTypes: [TensorFlowScalar.Type] = [
+  Float.self, Double.self, BFloat16.self, Int64.self, Int32.self, Int16.self, Int8.self,
+  UInt8.self, Bool.self,
+]
+
+/// Returns the tensor of the scalar type of `tensor`.
+private func wrapCheckpointTensor(_ tensor: XLATensor) -> AnyTensor {
+  let dtype = tensor.dtype
+  guard let scalarType = checkpointScalarTypes.first(where: { $0.xlaTensorScalarType == dtype })
+  else {
+    fatalError("Unsupported checkpoint tensor type: \(dtype)")
+  }
+  return scalarType.wrapTensor(tensor)
+}
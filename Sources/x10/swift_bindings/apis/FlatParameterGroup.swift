@@ -0,0 +1,65 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// A group of parameters sharing their scalar type and device, stored in a single flat device
+/// buffer, so that the step graphs take one parameter for the whole group.
+///
+/// The logical tensors are views of the buffer, and should not outlive the step: the ones still
+/// alive at the step barrier get synced as buffers of their own.
+public final class FlatParameterGroup<Scalar: TensorFlowScalar> {
+  private let handle: UnsafeMutablePointer<OpaqueXLAFlatParameterGroup>
+
+  /// Packs `tensors`, which must live on the same XLA device, into the buffer of the group.
+  public init(_ tensors: [Tensor<Scalar>]) {
+    handle = tensors.map { $0.xlaTensor }.withArrayRef { tensors in
+      XLAFlatParameterGroup_create(tensors)
+    }
+  }
+
+  deinit { destroyXLAFlatParameterGroup(handle) }
+
+  /// The flat buffer of the group. A new buffer must keep the layout of the group, as the result
+  /// of an update of the buffer or of `pack(_:)` does.
+  public var buffer: Tensor<Scalar> {
+    get { Tensor(_xla: XLATensor(_handle: XLAFlatParameterGroup_buffer(handle))) }
+    set {
+      let xlaTensor = newValue.xlaTensor
+      defer { _fixLifetime(xlaTensor) }
+      XLAFlatParameterGroup_setBuffer(handle, xlaTensor.handle)
+    }
+  }
+
+  /// Packs tensors with the shapes of the group (e.g. gradients) in the layout of the group.
+  public func pack(_ tensors: [Tensor<Scalar>]) -> Tensor<Scalar> {
+    tensors.map { $0.xlaTensor }.withArrayRef { tensors in
+      Tensor(_xla: XLATensor(_handle: XLAFlatParameterGroup_pack(handle, tensors)))
+    }
+  }
+
+  /// Returns the logical tensors of the group within `flat`, which has the layout of the group,
+  /// or within the buffer of the group.
+  public func unpack(_ flat: Tensor<Scalar>? = nil) -> [Tensor<Scalar>] {
+    let flatXLATensor = flat?.xlaTensor
+    defer { _fixLifetime(flatXLATensor) }
+    let tensorListHandle = XLAFlatParameterGroup_unpack(handle, flatXLATensor?.handle)
+    defer {
+      destroyOpaqueXLATensorArrayRef(tensorListHandle)
+    }
+    return (0..<tensorListHandle.size).map { i in
+      Tensor(_xla: XLATensor(_handle: tensorListHandle.data[i]!))
+    }
+  }
+}
@@ -0,0 +1,76 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Uploads batches of host tensors to an XLA device ahead of their use, so that the transfer of
+/// the inputs of the next step overlaps with the execution of the current one.
+///
+/// Batches are handed back by `dequeue(_:)` in the order they were passed to `enqueue(_:)`. At
+/// most `depth` batches are queued at any time, and `enqueue(_:)` blocks once the queue is full.
+public final class InputPrefetcher {
+  private let handle: UnsafeMutablePointer<OpaqueXLAPrefetcher>
+
+  /// Creates a prefetcher uploading up to `depth` batches to `device` ahead of their use.
+  public init(on device: Device = Device.defaultXLA, depth: Int = 2) {
+    precondition(device.backend == .XLA, "Input prefetching requires an XLA device.")
+    precondition(depth > 0, "The prefetching depth must be positive.")
+    handle = XLAPrefetcher_create(device.cdevice, depth)
+  }
+
+  deinit { destroyXLAPrefetcher(handle) }
+
+  /// Copies the batch into staging memory and queues it for upload.
+  public func enqueue<Scalar: TensorFlowScalar>(_ batch: [ShapedArray<Scalar>]) {
+    let types = [XLATensorScalarType](repeating: Scalar.xlaTensorScalarType, count: batch.count)
+    let numEntries = batch.map { $0.scalars.count }
+    let ranks = batch.map { $0.shape.count }
+    withBaseAddresses(batch.map { $0.scalars }) { values in
+      withBaseAddresses(batch.map { $0.shape }) { shapes in
+        let rawValues = values.map { $0.map { UnsafeRawPointer($0) } }
+        XLAPrefetcher_enqueue(
+          handle, types, rawValues, numEntries, shapes, ranks, batch.count)
+      }
+    }
+  }
+
+  /// Returns the device tensors of the oldest queued batch, waiting for its upload to complete.
+  public func dequeue<Scalar: TensorFlowScalar>(_ type: Scalar.Type) -> [Tensor<Scalar>] {
+    let tensorListHandle = XLAPrefetcher_dequeue(handle)
+    defer {
+      destroyOpaqueXLATensorArrayRef(tensorListHandle)
+    }
+    return (0..<tensorListHandle.size).map { i in
+      Tensor(_xla: XLATensor(_handle: tensorListHandle.data[i]!))
+    }
+  }
+}
+
+/// Calls `body` with the base addresses of the storage of `arrays`.
+private func withBaseAddresses<T, Result>(
+  _ arrays: [[T]], _ body: ([UnsafePointer<T>?]) -> Result
+) -> Result {
+  var addresses: [UnsafePointer<T>?] = []
+  addresses.reserveCapacity(arrays.count)
+  func recurse(_ index: Int) -> Result {
+    if index == arrays.count {
+      return body(addresses)
+    }
+    return arrays[index].withUnsafeBufferPointer { buffer in
+      addresses.append(buffer.baseAddress)
+      return recurse(index + 1)
+    }
+  }
+  return recurse(0)
+}
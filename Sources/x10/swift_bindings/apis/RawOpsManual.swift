@@ -919,6 +919,45 @@ public enum _RawXLA {
     }
   }
 
+  /// Applies an SGD step with momentum to a group of weights with a single fused node.
+  ///
+  /// Matches `makeSGD`: the gradient is scaled by the weight decay, the velocity is updated,
+  /// and the weight is moved by the (optionally Nesterov) step. The hyperparameters are
+  /// scalar tensors so that changing them does not change the graph.
+  public static func multiTensorSGD<T: FloatingPoint & TensorFlowScalar>(
+    weights: [Tensor<T>], grads: [Tensor<T>], velocities: [Tensor<T>],
+    learningRate: Tensor<T>, momentum: Tensor<T>, weightDecay: Tensor<T>, nesterov: Bool
+  ) -> (weights: [Tensor<T>], velocities: [Tensor<T>]) {
+    let results = XLATensor.multiTensorSGD(
+      weights: weights.map { $0.xlaTensor }, grads: grads.map { $0.xlaTensor },
+      velocities: velocities.map { $0.xlaTensor }, learningRate: learningRate.xlaTensor,
+      momentum: momentum.xlaTensor, weightDecay: weightDecay.xlaTensor, nesterov: nesterov)
+    return (
+      results.weights.map { Tensor(_xla: $0) }, results.velocities.map { Tensor(_xla: $0) }
+    )
+  }
+
+  /// Applies an Adam step with weight decay to a group of weights with a single fused node.
+  ///
+  /// Matches `makeAdam`: both moments are updated and the weight is moved by
+  /// `-learningRate * (firstMoment / (sqrt(secondMoment) + epsilon) + weightDecay * weight)`.
+  public static func multiTensorAdam<T: FloatingPoint & TensorFlowScalar>(
+    weights: [Tensor<T>], grads: [Tensor<T>], firstMoments: [Tensor<T>],
+    secondMoments: [Tensor<T>], learningRate: Tensor<T>, beta1: Tensor<T>, beta2: Tensor<T>,
+    weightDecay: Tensor<T>, epsilon: Double
+  ) -> (weights: [Tensor<T>], firstMoments: [Tensor<T>], secondMoments: [Tensor<T>]) {
+    let results = XLATensor.multiTensorAdam(
+      weights: weights.map { $0.xlaTensor }, grads: grads.map { $0.xlaTensor },
+      firstMoments: firstMoments.map { $0.xlaTensor },
+      secondMoments: secondMoments.map { $0.xlaTensor }, learningRate: learningRate.xlaTensor,
+      beta1: beta1.xlaTensor, beta2: beta2.xlaTensor, weightDecay: weightDecay.xlaTensor,
+      epsilon: epsilon)
+    return (
+      results.weights.map { Tensor(_xla: $0) }, results.firstMoments.map { Tensor(_xla: $0) },
+      results.secondMoments.map { Tensor(_xla: $0) }
+    )
+  }
+
   /// Compute the cumulative product of the tensor `x` along `axis`.
   ///
   /// By default, this op performs an inclusive cumprod, which means that the first
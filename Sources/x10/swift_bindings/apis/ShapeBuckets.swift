@@ -0,0 +1,52 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Sets the bucket boundaries of `dimension` for the inputs uploaded with `BucketedTensor`, in
+/// increasing order. Empty boundaries disable bucketing for `dimension`.
+public func SetShapeBucketBoundaries(_ boundaries: [Int], dimension: Int) {
+  let boundaries = boundaries.map { Int64($0) }
+  boundaries.withUnsafeBufferPointer { boundaries in
+    SetShapeBuckets(Int64(dimension), boundaries.baseAddress, boundaries.count)
+  }
+}
+
+/// An input uploaded to an XLA device with its bucketed dimensions padded up to their bucket, so
+/// that the inputs whose sizes vary from step to step within a bucket share compilations.
+public struct BucketedTensor<Scalar: TensorFlowScalar> {
+  /// The device tensor. Its bucketed dimensions are dynamic: their static size is the bucket,
+  /// with the real size carried along.
+  public let tensor: Tensor<Scalar>
+  /// The real shape of the input, before padding.
+  public let shape: TensorShape
+
+  /// Uploads `scalars` with the given real `shape` to `device`.
+  public init(shape: TensorShape, scalars: [Scalar], on device: Device = .defaultXLA) {
+    precondition(device.backend == .XLA, "Shape bucketing requires an XLA device.")
+    precondition(
+      shape.contiguousSize == scalars.count,
+      "The shape requires \(shape.contiguousSize) scalars but \(scalars.count) were provided.")
+    let dims = shape.dimensions
+    let handle = scalars.withUnsafeBufferPointer { data in
+      dims.withUnsafeBufferPointer { dims in
+        copyTensorBucketed(
+          Scalar.xlaTensorScalarType, data.baseAddress, data.count, dims.baseAddress, dims.count,
+          device.cdevice)!
+      }
+    }
+    self.tensor = Tensor(_xla: XLATensor(_handle: handle))
+    self.shape = shape
+  }
+}
@@ -126,7 +126,7 @@ def node_type_define(op):
       if arg[0] == shape_fn: return f"{arg[0]}.shape()"
     if shape_fn == "shape":
       return "shape"
-    return f"""{shape_fn}({", ".join(arg[0] for arg in op["args"])})"""
+    return f"""[&]() {{ return {shape_fn}({", ".join(arg[0] for arg in op["args"])}); }}"""
   def format_shape_lower_arg(arg):
     name, stype, _ = arg
     if stype == "Tensor": return f"{name}_ir"
@@ -104,6 +104,11 @@ public struct HyperparameterDictionary {
 // TODO: Experiment with efficiently fusing these...
 public typealias OptimizerCallback = (inout OptimizerWeightStepState, inout OptimizerState) -> Void
 
+/// Updates all the weights of a parameter group at once, setting the `step` of each of them.
+public typealias OptimizerGroupCallback = (
+  inout [OptimizerWeightStepState], inout OptimizerState
+) -> Void
+
 /// An optimizer that works on a single parameter group.
 public struct ParameterGroupOptimizer {
   public init() {}
@@ -111,6 +116,9 @@ public struct ParameterGroupOptimizer {
   public var globals: [(HyperparameterDictionary, Device) -> Tensor<Float>] = []
   public var localCount: Int = 0
   public var callbacks: [OptimizerCallback] = []
+  /// Replaces `callbacks` when the model is on an XLA device, so that the whole group is updated
+  /// by a single fused node.
+  public var groupCallback: OptimizerGroupCallback? = nil
   public var stateCount: Int = 0
 }
 
@@ -217,6 +225,10 @@ where
     }
     var step = direction
     let crsScale : Double? = crossReplicaSumCount.map { 1.0 / Double($0) }
+    // The weights of the groups with a group callback are collected, and updated once the
+    // traversal is done.
+    let useGroupCallbacks = device.backend == .XLA
+    var groupStates = parameterGroups.map { _ in [OptimizerWeightStepState]() }
     // step plays dual-duties as an inout parameter for efficiency.
     let _ = kpPlan.mapTensors(&step, model.differentiableVectorView) {
       (step: inout Tensor<Float>, weight: Tensor<Float>, i: Int) in
@@ -227,9 +239,26 @@ where
       if let crsScale = crsScale {
         state.grad = _Raw.crossReplicaSum([state.grad], crsScale).first!
       }
+      if useGroupCallbacks && paramGroup.groupCallback != nil {
+        groupStates[selector].append(state)
+        return
+      }
       for cb in paramGroup.callbacks { cb(&state, &optimizerState) }
       step = state.step ?? Tensor<Float>(zerosLike: step)
     }
+    var groupSteps: [Int: Tensor<Float>] = [:]
+    for (selector, var states) in groupStates.enumerated() where !states.isEmpty {
+      parameterGroups[selector].groupCallback!(&states, &optimizerState)
+      for state in states {
+        groupSteps[state.weightId] = state.step ?? Tensor<Float>(zerosLike: state.grad)
+      }
+    }
+    if !groupSteps.isEmpty {
+      let _ = kpPlan.mapTensors(&step, model.differentiableVectorView) {
+        (step: inout Tensor<Float>, _: Tensor<Float>, i: Int) in
+        if let groupStep = groupSteps[i] { step = groupStep }
+      }
+    }
     model.move(by: step)
   }
 
@@ -320,6 +349,12 @@ public struct ParameterGroupOptimizerBuilder {
     result.callbacks.append(cb)
   }
 
+  /// Sets the callback updating the whole parameter group on XLA devices. It must compute the
+  /// same steps as the per-weight callbacks, which are still used on the other devices.
+  public mutating func setGroupCallback(_ cb: @escaping OptimizerGroupCallback) {
+    result.groupCallback = cb
+  }
+
   /// Returns the optimizer and clears the builder.
   public mutating func makeOptimizer() -> ParameterGroupOptimizer {
     let tmp = result
@@ -66,6 +66,24 @@ extension ParameterGroupOptimizerBuilder {
     }
   }
 
+  /// Updates the whole parameter group with a single fused SGD node, computing the same steps as
+  /// `scaleGradient(byWeightDecay:)`, `updateVelocity` and `sgdStep`.
+  public mutating func multiTensorSGDStep(
+    nesterov: Bool, mom: GlobalAccessor, lr: GlobalAccessor, weightDecay: GlobalAccessor,
+    velocity: StateAccessor
+  ) {
+    setGroupCallback { (states: inout [OptimizerWeightStepState], optState: inout OptimizerState) in
+      let (weights, velocities) = _RawXLA.multiTensorSGD(
+        weights: states.map { $0.weight }, grads: states.map { $0.grad },
+        velocities: states.map { optState[$0, velocity] }, learningRate: states[0][lr],
+        momentum: states[0][mom], weightDecay: states[0][weightDecay], nesterov: nesterov)
+      for i in states.indices {
+        optState[states[i], velocity] = velocities[i]
+        states[i].step = weights[i] - states[i].weight
+      }
+    }
+  }
+
   /// Recomputes the velocity parameter based on the new gradient (scaled by the learning rate).
   public mutating func updateVelocity(
     mom: GlobalAccessor, lr: GlobalAccessor, velocity: StateAccessor
@@ -119,6 +137,7 @@ public func makeSGD(
   let velocity = b[state: "velocity"]
   b.updateVelocity(mom: mom, lr: lr, velocity: velocity)
   b.sgdStep(nesterov: nesterov, mom: mom, lr: lr, velocity: velocity)
+  b.multiTensorSGDStep(nesterov: nesterov, mom: mom, lr: lr, weightDecay: wd, velocity: velocity)
   return b.makeOptimizer()
 }
 
@@ -159,5 +178,20 @@ public func makeAdam(
     state.step = -state[lr] * update
   }
 
+  b.setGroupCallback {
+    (states: inout [OptimizerWeightStepState], optState: inout OptimizerState) in
+    let (weights, firstMoments, secondMoments) = _RawXLA.multiTensorAdam(
+      weights: states.map { $0.weight }, grads: states.map { $0.grad },
+      firstMoments: states.map { optState[$0, firstMoment] },
+      secondMoments: states.map { optState[$0, secondMoment] }, learningRate: states[0][lr],
+      beta1: states[0][beta1], beta2: states[0][beta2], weightDecay: states[0][wd],
+      epsilon: Double(epsilon))
+    for i in states.indices {
+      optState[states[i], firstMoment] = firstMoments[i]
+      optState[states[i], secondMoment] = secondMoments[i]
+      states[i].step = weights[i] - states[i].weight
+    }
+  }
+
   return b.makeOptimizer()
 }
@@ -24,10 +24,11 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
-#include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
 namespace xla {
@@ -187,6 +188,29 @@ int32_t ComputationClient::Device::mesh_id() const {
   TF_LOG(FATAL) << "Unsupported";
 }
 
+int64_t ComputationClient::Device::ResetPeakBytes() {
+  return peak_bytes_.exchange(live_bytes_.load());
+}
+
+void ComputationClient::Device::AddLiveBytes(int64_t bytes) {
+  int64_t live_bytes = live_bytes_.fetch_add(bytes) + bytes;
+  int64_t peak_bytes = peak_bytes_.load();
+  while (live_bytes > peak_bytes &&
+         !peak_bytes_.compare_exchange_weak(peak_bytes, live_bytes)) {
+  }
+}
+
+int64_t ComputationClient::Data::ShapeBytes(const Shape& shape) {
+  if (shape.IsTuple()) {
+    int64_t bytes = 0;
+    for (const Shape& element_shape : shape.tuple_shapes()) {
+      bytes += ShapeBytes(element_shape);
+    }
+    return bytes;
+  }
+  return shape.IsArray() ? ShapeUtil::ByteSizeOfElements(shape) : 0;
+}
+
 std::vector<std::string> ComputationClient::GetAllDevices() const {
   std::vector<std::string> out;
   auto tmp = GetAllDevicePointers();
@@ -18,6 +18,7 @@
 #define X10_XLA_CLIENT_COMPUTATION_CLIENT_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <map>
 #include <memory>
@@ -97,9 +98,22 @@ class ComputationClient {
 
     virtual bool IsLocal() { return false; }
 
+    // The bytes of the buffers held by the live Data objects of the device,
+    // and the highest value they reached since the last ResetPeakBytes() call.
+    int64_t live_bytes() const { return live_bytes_.load(); }
+    int64_t peak_bytes() const { return peak_bytes_.load(); }
+
+    // Restarts the peak tracking from the current live bytes, and returns the
+    // previous peak.
+    int64_t ResetPeakBytes();
+
+    void AddLiveBytes(int64_t bytes);
+
    private:
     std::string name_;
     swift_xla::Device device_id_;
+    std::atomic<int64_t> live_bytes_{0};
+    std::atomic<int64_t> peak_bytes_{0};
   };
   class Data {
    public:
@@ -110,7 +124,9 @@ class ComputationClient {
     using OpaqueHandle = int64_t;
 
     Data(Device* device, Shape shape)
-        : device_(std::move(device)), shape_(std::move(shape)) {}
+        : device_(std::move(device)),
+          shape_(std::move(shape)),
+          bytes_(ShapeBytes(shape_)) {}
 
     virtual ~Data() {}
 
@@ -118,6 +134,9 @@ class ComputationClient {
 
     const Shape& shape() const { return shape_; }
 
+    // The device memory accounted for this data.
+    int64_t bytes() const { return bytes_; }
+
     Info* info() const { return info_.get(); }
 
     std::shared_ptr<Info> SetInfo(std::shared_ptr<Info> info) {
@@ -131,10 +150,38 @@ class ComputationClient {
 
     virtual bool HasValue() const = 0;
 
+   protected:
+    // Accounts the bytes of the buffer which the data got attached to its
+    // device, until the last Data sharing the buffer is destroyed.
+    void AttachBuffer() {
+      if (device_ != nullptr) {
+        live_buffer_ = std::make_shared<LiveBuffer>(device_, bytes_);
+      }
+    }
+
+    // Shares the buffer accounting of data, whose buffer is now shared with
+    // this one by Assign(). The placeholders are not accounted before that.
+    void AssignBuffer(const Data& data) { live_buffer_ = data.live_buffer_; }
+
    private:
+    struct LiveBuffer {
+      LiveBuffer(Device* device, int64_t bytes)
+          : device(device), bytes(bytes) {
+        device->AddLiveBytes(bytes);
+      }
+      ~LiveBuffer() { device->AddLiveBytes(-bytes); }
+
+      Device* device;
+      int64_t bytes;
+    };
+
+    static int64_t ShapeBytes(const Shape& shape);
+
     Device* device_;
     Shape shape_;
+    int64_t bytes_;
     std::shared_ptr<Info> info_;
+    std::shared_ptr<LiveBuffer> live_buffer_;
   };
 
   class Computation {
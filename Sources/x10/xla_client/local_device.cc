@@ -1,5 +1,7 @@
 #include "tensorflow/compiler/xla/xla_client/local_device.h"
 
+#include <list>
+#include <mutex>
 #include <tuple>
 
 #include "absl/container/node_hash_map.h"
@@ -7,11 +9,14 @@
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/service/platform_util.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/stream_executor/event.h"
 
 namespace xla {
 namespace {
@@ -117,6 +122,186 @@ std::vector<const xla::Shape*> ArgumentLayoutAsPointers(
   return argument_layout_ptrs;
 }
 
+// A device memory allocator which keeps the buffers released by the
+// ScopedShapedBuffer-s in per-size free lists, instead of handing them back to
+// the wrapped stream executor allocator. A training loop uploads and produces
+// the same shapes at every step, so both the input uploads and the computation
+// outputs end up recycling the memory of the tensors which died in the previous
+// step. The cached bytes are capped, trimming the least recently used sizes
+// first, and the whole cache is dropped if the wrapped allocator runs out of
+// memory.
+//
+// The computations run asynchronously on the compute stream, so a buffer can be
+// released (its last reference dropped) while a computation which was already
+// launched still reads or writes it. Each cached block carries an event recorded
+// on the compute stream when it was released, and is only handed out again once
+// that event has completed. Otherwise an upload running on a substream could
+// overwrite it under the running computation.
+class CachingDeviceMemoryAllocator : public se::DeviceMemoryAllocator {
+  struct CachedBlock {
+    se::DeviceMemoryBase memory;
+    // Completes once the compute stream work queued before the release is done.
+    std::unique_ptr<se::Event> released;
+  };
+
+  struct AllocBlocks {
+    explicit AllocBlocks(tensorflow::uint64 size) : size(size) {}
+
+    tensorflow::uint64 size;
+    std::vector<CachedBlock> blocks;
+  };
+
+  using AllocList = std::list<AllocBlocks>;
+
+ public:
+  CachingDeviceMemoryAllocator(se::DeviceMemoryAllocator* allocator,
+                               se::Stream* compute_stream, size_t max_size)
+      : se::DeviceMemoryAllocator(allocator->platform()),
+        allocator_(allocator),
+        compute_stream_(compute_stream),
+        max_size_(max_size) {}
+
+  ~CachingDeviceMemoryAllocator() override {
+    std::lock_guard<std::mutex> lock(lock_);
+    TrimCache(0);
+  }
+
+  using se::DeviceMemoryAllocator::Allocate;
+
+  StatusOr<se::OwningDeviceMemory> Allocate(
+      int device_ordinal, tensorflow::uint64 size, bool retry_on_failure,
+      tensorflow::int64 memory_space) override {
+    if (size == 0 || memory_space != 0) {
+      // Only the default memory space is cached. Blocks from other spaces
+      // are tracked so that Deallocate() can route them back.
+      TF_ASSIGN_OR_RETURN(se::OwningDeviceMemory mem,
+                          allocator_->Allocate(device_ordinal, size,
+                                               retry_on_failure, memory_space));
+      se::DeviceMemoryBase block = mem.Release();
+      if (!block.is_null()) {
+        std::lock_guard<std::mutex> lock(lock_);
+        uncached_.insert(block.opaque());
+      }
+      return se::OwningDeviceMemory(block, device_ordinal, this);
+    }
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      auto it = allocs_.find(size);
+      if (it != allocs_.end()) {
+        std::vector<CachedBlock>& blocks = it->second->blocks;
+        // The most recently released blocks are the least likely to be
+        // available, so look from the oldest ones.
+        for (auto block_it = blocks.begin(); block_it != blocks.end();
+             ++block_it) {
+          if (block_it->released->PollForStatus() !=
+              se::Event::Status::kComplete) {
+            continue;
+          }
+          se::DeviceMemoryBase block = block_it->memory;
+          blocks.erase(block_it);
+          size_ -= size;
+          // LRU
+          alloc_list_.splice(alloc_list_.begin(), alloc_list_, it->second);
+          XLA_COUNTER("DeviceBufferPoolHit", 1);
+          return se::OwningDeviceMemory(block, device_ordinal, this);
+        }
+        if (!blocks.empty()) {
+          XLA_COUNTER("DeviceBufferPoolInUse", 1);
+        }
+      }
+    }
+    XLA_COUNTER("DeviceBufferPoolMiss", 1);
+    StatusOr<se::OwningDeviceMemory> mem_or =
+        allocator_->Allocate(device_ordinal, size,
+                             /*retry_on_failure=*/false, memory_space);
+    if (!mem_or.ok()) {
+      // The cached blocks might be what is keeping the allocation from
+      // fitting, so return them all to the wrapped allocator and retry.
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        TrimCache(0);
+      }
+      mem_or = allocator_->Allocate(device_ordinal, size, retry_on_failure,
+                                    memory_space);
+    }
+    TF_RETURN_IF_ERROR(mem_or.status());
+    se::DeviceMemoryBase block = mem_or.ValueOrDie().Release();
+    return se::OwningDeviceMemory(block, device_ordinal, this);
+  }
+
+  Status Deallocate(int device_ordinal, se::DeviceMemoryBase mem) override {
+    if (mem.is_null()) {
+      return Status::OK();
+    }
+    auto released = std::make_unique<se::Event>(compute_stream_->parent());
+    std::lock_guard<std::mutex> lock(lock_);
+    if (uncached_.erase(mem.opaque()) > 0 || mem.size() > max_size_ ||
+        !released->Init()) {
+      return allocator_->Deallocate(device_ordinal, mem);
+    }
+    compute_stream_->ThenRecordEvent(released.get());
+    device_ordinal_ = device_ordinal;
+    auto it = allocs_.find(mem.size());
+    if (it == allocs_.end()) {
+      it = allocs_
+               .emplace(mem.size(), alloc_list_.insert(alloc_list_.begin(),
+                                                       AllocBlocks(mem.size())))
+               .first;
+    }
+    it->second->blocks.push_back(CachedBlock{mem, std::move(released)});
+    size_ += mem.size();
+    TrimCache(max_size_);
+    XLA_VALUE_METRIC("DeviceBufferPoolCachedBytes", size_);
+    return Status::OK();
+  }
+
+  bool AllowsAsynchronousDeallocation() const override {
+    return allocator_->AllowsAsynchronousDeallocation();
+  }
+
+  StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+    return allocator_->GetStream(device_ordinal);
+  }
+
+ private:
+  // Frees the cached blocks, starting from the least recently used sizes, until
+  // the cached bytes fit within max_size. Must be called with lock_ held. The
+  // wrapped allocator is not stream ordered either, so this is what happened to
+  // every released buffer before they were cached.
+  void TrimCache(size_t max_size) {
+    for (auto it = alloc_list_.rbegin();
+         size_ > max_size && it != alloc_list_.rend(); ++it) {
+      while (!it->blocks.empty() && size_ > max_size) {
+        XLA_COUNTER("DeviceBufferPoolTrimmed", 1);
+        TF_CHECK_OK(
+            allocator_->Deallocate(device_ordinal_, it->blocks.back().memory));
+        size_ -= it->size;
+        it->blocks.pop_back();
+      }
+    }
+  }
+
+  se::DeviceMemoryAllocator* allocator_;
+  se::Stream* compute_stream_;
+  size_t max_size_ = 0;
+  std::mutex lock_;
+  // The device ordinal the cached blocks belong to. Each LocalDevice owns its
+  // allocator, so this is the same for all of them.
+  int device_ordinal_ = 0;
+  size_t size_ = 0;
+  AllocList alloc_list_;
+  absl::node_hash_map<tensorflow::uint64, AllocList::iterator> allocs_;
+  absl::node_hash_set<const void*> uncached_;
+};
+
+std::unique_ptr<CachingDeviceMemoryAllocator> MakeDeviceAllocator(
+    se::DeviceMemoryAllocator* allocator, se::Stream* compute_stream) {
+  static size_t max_size =
+      sys_util::GetEnvInt("XLA_DEVICE_BUFFER_POOL_MAXSIZE", 1000000000);
+  return std::make_unique<CachingDeviceMemoryAllocator>(
+      allocator, compute_stream, max_size);
+}
+
 }  // namespace
 
 class LocalTransferManager : public ComputationClient::TransferManager {
@@ -137,7 +322,9 @@ class LocalDevice : public ComputationClient::Device {
         stream_(std::make_unique<se::Stream>(
             client->backend().stream_executor(device_ordinal).ValueOrDie())),
         transfer_from_device_stream_(std::make_unique<se::Stream>(
-            client->backend().stream_executor(device_ordinal).ValueOrDie())) {
+            client->backend().stream_executor(device_ordinal).ValueOrDie())),
+        allocator_(MakeDeviceAllocator(client->backend().memory_allocator(),
+                                       stream_.get())) {
     stream_->Init();
     transfer_from_device_stream_->Init();
   }
@@ -150,6 +337,7 @@ class LocalDevice : public ComputationClient::Device {
     return transfer_from_device_stream_.get();
   }
   bool is_cpu() const { return is_cpu_; }
+  se::DeviceMemoryAllocator* allocator() const { return allocator_.get(); }
   TransferManager* GetTransferManager() const override {
     static LocalTransferManager local_transfer;
     return &local_transfer;
@@ -231,6 +419,8 @@ class LocalDevice : public ComputationClient::Device {
   bool is_cpu_;
   std::unique_ptr<se::Stream> stream_;
   std::unique_ptr<se::Stream> transfer_from_device_stream_;
+  // Declared after the streams, so that it is destroyed before them.
+  std::unique_ptr<CachingDeviceMemoryAllocator> allocator_;
 };
 
 class LocalData : public Data {
@@ -239,13 +429,16 @@ class LocalData : public Data {
   LocalData(Device* device, ScopedShapedBuffer buffer, int64_t computation_id)
       : Data(device, buffer.on_host_shape()),
         buffer_(std::make_shared<ScopedShapedBuffer>(std::move(buffer))),
-        computation_id_(computation_id) {}
+        computation_id_(computation_id) {
+    AttachBuffer();
+  }
 
   void Assign(const Data& data) override {
     const LocalData& xrt_data = dynamic_cast<const LocalData&>(data);
     if (&xrt_data != this) {
       buffer_ = xrt_data.buffer_;
       computation_id_ = xrt_data.computation_id_;
+      AssignBuffer(xrt_data);
     }
   }
 
@@ -287,8 +480,7 @@ DataPtr LocalDevice::TransferToServer(xla::BorrowingLiteral literal,
                                       const xla::Shape& dest_shape) {
   tensorflow::profiler::TraceMe trace("TransferSingleTensorToServer");
 
-  stream_executor::DeviceMemoryAllocator* allocator =
-      client()->backend().memory_allocator();
+  stream_executor::DeviceMemoryAllocator* allocator = this->allocator();
   xla::TransferManager* transfer_manager =
       client()->backend().transfer_manager();
 
@@ -351,8 +543,7 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
   for (size_t i = 0; i < tensors.size(); ++i) {
     const TensorSource& tensor = tensors[i];
 
-    stream_executor::DeviceMemoryAllocator* allocator =
-        device->client()->backend().memory_allocator();
+    stream_executor::DeviceMemoryAllocator* allocator = device->allocator();
     xla::TransferManager* transfer_manager =
         device->client()->backend().transfer_manager();
 
@@ -492,7 +683,10 @@ std::vector<DataPtr> LocalDevice::ExecuteComputation(
 
   xla::ExecutableRunOptions run_options;
   run_options.set_stream(stream_.get());
-  run_options.set_allocator(client_->backend().memory_allocator());
+  // Outputs come from the same pool the uploads and the dead tensors' buffers
+  // go through, so step outputs recycle the memory released by the previous
+  // step.
+  run_options.set_allocator(allocator());
   run_options.set_intra_op_thread_pool(
       client_->backend().eigen_intra_op_thread_pool_device());
 
@@ -16,27 +16,58 @@
 
 #include <chrono>
 #include <exception>
+#include <thread>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 
 namespace xla {
 namespace util {
+namespace {
+
+// The number of times a waiter checks the completions before parking.
+constexpr int kSpinCount = 256;
+
+}  // namespace
 
 void MultiWait::Done() {
-  bool notify = false;
+  // Only the last completion can touch the object after the increment.
+  size_t count = count_;
+  if (completed_count_.fetch_add(1, std::memory_order_acq_rel) + 1 != count) {
+    return;
+  }
+  // The last completion. The lock orders the notification against the
+  // waiters about to park, and the continuation against OnDone(). The object
+  // might be gone once the lock is released.
+  std::function<void(std::exception_ptr)> callback;
+  std::exception_ptr exptr;
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    completed_count_ += 1;
-    notify = completed_count_ >= count_;
-  }
-  if (notify) {
+    completed_.store(true, std::memory_order_release);
+    callback = std::move(callback_);
+    exptr = exptr_;
     cv_.notify_all();
   }
+  if (callback != nullptr) {
+    callback(std::move(exptr));
+  }
+}
+
+bool MultiWait::SpinWait() const {
+  for (int i = 0; i < kSpinCount; ++i) {
+    if (IsCompleted()) {
+      return true;
+    }
+    std::this_thread::yield();
+  }
+  return false;
 }
 
 void MultiWait::Wait() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  cv_.wait(lock, [this] { return completed_count_ >= count_; });
+  if (!SpinWait()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return IsCompleted(); });
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
   if (exptr_ != nullptr) {
     std::rethrow_exception(exptr_);
   }
@@ -45,7 +76,7 @@ void MultiWait::Wait() {
 void MultiWait::Wait(double wait_seconds) {
   std::unique_lock<std::mutex> lock(mutex_);
   if (!cv_.wait_for(lock, std::chrono::duration<double>(wait_seconds),
-                    [this] { return completed_count_ >= count_; })) {
+                    [this] { return IsCompleted(); })) {
     TF_LOG(FATAL) << "Hit timeout";
   }
   if (exptr_ != nullptr) {
@@ -56,21 +87,29 @@ void MultiWait::Wait(double wait_seconds) {
 void MultiWait::Reset(size_t count) {
   std::lock_guard<std::mutex> lock(mutex_);
   count_ = count;
-  completed_count_ = 0;
+  completed_count_.store(0, std::memory_order_relaxed);
+  completed_.store(false, std::memory_order_relaxed);
   exptr_ = nullptr;
+  callback_ = nullptr;
 }
 
-std::function<void()> MultiWait::Completer(std::function<void()> func) {
-  auto completer = [this, func = std::move(func)]() {
-    try {
-      func();
-    } catch (...) {
-      std::lock_guard<std::mutex> lock(mutex_);
-      exptr_ = std::current_exception();
+void MultiWait::OnDone(std::function<void(std::exception_ptr)> callback) {
+  std::exception_ptr exptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    XLA_CHECK(callback_ == nullptr) << "MultiWait continuation already set";
+    if (!IsCompleted()) {
+      callback_ = std::move(callback);
+      return;
     }
-    Done();
-  };
-  return completer;
+    exptr = exptr_;
+  }
+  callback(std::move(exptr));
+}
+
+void MultiWait::SetException(std::exception_ptr exptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  exptr_ = std::move(exptr);
 }
 
 }  // namespace util
@@ -17,7 +17,9 @@
 #ifndef X10_XLA_CLIENT_MULTI_WAIT_H_
 #define X10_XLA_CLIENT_MULTI_WAIT_H_
 
+#include <atomic>
 #include <condition_variable>
+#include <exception>
 #include <functional>
 #include <mutex>
 
@@ -27,6 +29,11 @@ namespace xla {
 namespace util {
 
 // Support waiting for a number of tasks to complete.
+//
+// The completions are counted with an atomic counter, so that only the last
+// one takes the lock (to wake up the waiters and run the continuation). The
+// waiters spin for a short while before parking on the condition variable,
+// since the fan-outs are often made of tiny tasks.
 class MultiWait {
  public:
   explicit MultiWait(size_t count) : count_(count) {}
@@ -42,20 +49,51 @@ class MultiWait {
   void Wait(double wait_seconds);
 
   // Resets the threshold counter for the MultiWait object. The completed count
-  // is also reset to zero.
+  // is also reset to zero, and the continuation dropped. Must not race with
+  // the completions.
   void Reset(size_t count);
 
+  // Runs callback once count completions happened, with the exception thrown
+  // by the completers (if any), instead of blocking a thread in Wait(). The
+  // callback runs on the thread signaling the last completion, or right away
+  // if the completions already happened. Only one callback can be set.
+  void OnDone(std::function<void(std::exception_ptr)> callback);
+
   // Creates a completer functor which signals the mult wait object once func
   // has completed. Handles exceptions by signaling the multi wait with the
-  // proper status value.
-  std::function<void()> Completer(std::function<void()> func);
+  // proper status value. The completer holds func by value, so wrapping it
+  // does not allocate.
+  template <typename F>
+  auto Completer(F func) {
+    return [this, func = std::move(func)]() mutable {
+      try {
+        func();
+      } catch (...) {
+        SetException(std::current_exception());
+      }
+      Done();
+    };
+  }
 
  private:
+  bool IsCompleted() const {
+    return count_ == 0 || completed_.load(std::memory_order_acquire);
+  }
+
+  // Spins for a while, and returns whether the completions happened.
+  bool SpinWait() const;
+
+  void SetException(std::exception_ptr exptr);
+
   std::mutex mutex_;
   std::condition_variable cv_;
   size_t count_ = 0;
-  size_t completed_count_ = 0;
+  std::atomic<size_t> completed_count_{0};
+  // Set under the lock by the last completion, so that the waiters are done
+  // with the object only after it.
+  std::atomic<bool> completed_{false};
   std::exception_ptr exptr_;
+  std::function<void(std::exception_ptr)> callback_;
 };
 
 }  // namespace util
@@ -2,10 +2,120 @@
 
 #include <sstream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace xla {
 namespace util {
 namespace {
 
+// Blocks at least this large are hashed with the striped hash below, which
+// processes 64 bytes per iteration over 8 independent lanes.
+constexpr size_t kStripedHashMinSize = 256;
+constexpr size_t kStripeSize = 64;
+constexpr size_t kStripeLanes = kStripeSize / sizeof(uint64_t);
+// Number of stripes between two scrambles of the accumulators.
+constexpr size_t kStripesPerBlock = 16;
+
+constexpr uint64_t kPrime32 = 0x9e3779b1;
+constexpr uint64_t kPrime64_1 = 0x9e3779b185ebca87;
+constexpr uint64_t kPrime64_2 = 0xc2b2ae3d27d4eb4f;
+constexpr uint64_t kPrime64_3 = 0x165667b19e3779f9;
+
+alignas(16) constexpr uint64_t kStripeKeys[kStripeLanes] = {
+    0xbe4ba423396cfeb8, 0x1cad21f72c81017c, 0xdb979083e96dd4de,
+    0x1f67b3b7a4a44072, 0x78e5c0cc4ee679cb, 0x2172ffcc7dd05a82,
+    0x8e2443f7744608b8, 0x4c263a81e69035e0};
+constexpr uint64_t kMergeKeys[2][kStripeLanes] = {
+    {0xcb00c391bb52283c, 0xa32e531b8b65d088, 0x4ef90da297486471,
+     0xd8acdea946ef1938, 0x3f349ce33f76faa8, 0x1d4f0bc7c7bbdcf9,
+     0x3159b4cd4be0518a, 0x647378d9c97e9fc8},
+    {0xc3ebd33483acc5ea, 0xeb6313faffa081c5, 0x49daf0b751dd0d17,
+     0x9e68d429265516d3, 0xfca1477d58be162b, 0xce31d07ad1b8f88f,
+     0x280416958f3acb45, 0x7e404bbbcafbd7af}};
+
+void AccumulateStripe(uint64_t* acc, const uint8_t* stripe) {
+#if defined(__SSE2__)
+  __m128i* xacc = reinterpret_cast<__m128i*>(acc);
+  const __m128i* xstripe = reinterpret_cast<const __m128i*>(stripe);
+  const __m128i* xkeys = reinterpret_cast<const __m128i*>(kStripeKeys);
+  for (size_t i = 0; i < kStripeLanes / 2; ++i) {
+    __m128i data = _mm_loadu_si128(xstripe + i);
+    __m128i data_key = _mm_xor_si128(data, _mm_load_si128(xkeys + i));
+    // Multiplies the low and high 32 bits of each 64 bit lane.
+    __m128i product = _mm_mul_epu32(
+        data_key, _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1)));
+    __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+    xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(product, swapped));
+  }
+#else
+  for (size_t i = 0; i < kStripeLanes; ++i) {
+    uint64_t data;
+    std::memcpy(&data, stripe + i * sizeof(data), sizeof(data));
+    uint64_t data_key = data ^ kStripeKeys[i];
+    acc[i ^ 1] += data;
+    acc[i] += (data_key & 0xffffffff) * (data_key >> 32);
+  }
+#endif
+}
+
+// Mixes the high bits of the accumulators back into the low ones, which the
+// 32x32 bit multiplications above would otherwise never look at.
+void ScrambleAccumulators(uint64_t* acc) {
+  for (size_t i = 0; i < kStripeLanes; ++i) {
+    acc[i] = (acc[i] ^ (acc[i] >> 47) ^ kStripeKeys[i]) * kPrime32;
+  }
+}
+
+uint64_t Avalanche(uint64_t h) {
+  h ^= h >> 37;
+  h *= kPrime64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t MergeAccumulators(const uint64_t* acc, const uint64_t* keys,
+                           uint64_t start) {
+  uint64_t result = start;
+  for (size_t i = 0; i < kStripeLanes; i += 2) {
+    hash_t product = hash_t(acc[i] ^ keys[i]) * (acc[i + 1] ^ keys[i + 1]);
+    result += absl::Uint128Low64(product) ^ absl::Uint128High64(product);
+  }
+  return Avalanche(result);
+}
+
+hash_t StripedHash(const uint8_t* data, size_t n, const hash_t& seed) {
+  uint64_t seed_low = absl::Uint128Low64(seed);
+  uint64_t seed_high = absl::Uint128High64(seed);
+  alignas(16) uint64_t acc[kStripeLanes] = {
+      kPrime32 ^ seed_low,   kPrime64_1 ^ seed_high, kPrime64_2 ^ seed_low,
+      kPrime64_3 ^ seed_high, kPrime64_1 + seed_low, kPrime64_2 + seed_high,
+      kPrime64_3 + seed_low, kPrime32 + seed_high};
+  size_t num_stripes = n / kStripeSize;
+  const uint8_t* stripe = data;
+  for (; num_stripes >= kStripesPerBlock; num_stripes -= kStripesPerBlock) {
+    for (size_t i = 0; i < kStripesPerBlock; ++i) {
+      AccumulateStripe(acc, stripe);
+      stripe += kStripeSize;
+    }
+    ScrambleAccumulators(acc);
+  }
+  for (; num_stripes > 0; --num_stripes) {
+    AccumulateStripe(acc, stripe);
+    stripe += kStripeSize;
+  }
+  // The last (partial) stripe is the one ending at the end of the data, which
+  // overlaps the previous one. There is at least one full stripe, as the data
+  // is never smaller than kStripedHashMinSize.
+  if (n % kStripeSize != 0) {
+    AccumulateStripe(acc, data + n - kStripeSize);
+  }
+  uint64_t low = MergeAccumulators(acc, kMergeKeys[0], n * kPrime64_1);
+  uint64_t high = MergeAccumulators(acc, kMergeKeys[1], ~(n * kPrime64_2));
+  return absl::MakeUint128(high, low);
+}
+
 hash_t LoadHash(const uint8_t** data, const uint8_t* top) {
   std::ptrdiff_t size = top - (*data);
   if (size >= sizeof(hash_t)) {
@@ -32,6 +142,9 @@ hash_t HashBlock(const void* data, size_t n, const hash_t& seed) {
   const int r = 47;
 
   const uint8_t* u8_data = reinterpret_cast<const uint8_t*>(data);
+  if (n >= kStripedHashMinSize) {
+    return StripedHash(u8_data, n, seed);
+  }
   const uint8_t* top = u8_data + n;
   hash_t h = seed ^ (n * m);
   while (u8_data < top) {
@@ -14,15 +14,24 @@
 
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <limits>
 #include <list>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <unordered_map>
 
-#include "absl/container/node_hash_map.h"
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
@@ -42,6 +51,7 @@
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/platform/net.h"
 #include "tensorflow/core/protobuf/cluster.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -101,7 +111,9 @@ XrtComputationClient::XrtData::XrtData(XrtDevice* device, Shape device_shape,
       handle_ptr(std::make_shared<XrtHandle>(handle, [device, handle]() {
         reinterpret_cast<XrtComputationClient*>(device->computation_client())
             ->ReleaseXrtData(device->name(), handle);
-      })) {}
+      })) {
+  AttachBuffer();
+}
 
 namespace {
 
@@ -116,7 +128,7 @@ static const char* const kLocalService = "localservice";
 struct TensorAllocatorTraits {
   static void *allocate(size_t size, size_t alignment) {
 #if defined(_WIN32)
-    return ::_aligned_malloc(alignment, size);
+    return ::_aligned_malloc(size, alignment);
 #elif defined(__APPLE__)
     void *ptr;
     ::posix_memalign(&ptr, alignment, size);
@@ -131,132 +143,320 @@ struct TensorAllocatorTraits {
     return ::_aligned_free(allocation);
 #else
     return ::free(allocation);
+#endif
+  }
+
+  // Hints the kernel to back the given (page aligned) memory range with
+  // transparent huge pages. No-op where not supported.
+  static void advise_huge_pages(void *ptr, size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    ::madvise(ptr, size, MADV_HUGEPAGE);
 #endif
   }
 };
 
-// A simple Tensorflow Allocator which caches Tensor allocations in order to
-// avoid paying the kernel's clear_page_c() price.
+// A Tensorflow Allocator which caches Tensor allocations in order to avoid
+// paying the kernel's clear_page_c() price. Requests are rounded up to size
+// classes (four per power of two, so at most 25% of internal fragmentation),
+// which lets tensors of close sizes share the same cached blocks. Freed blocks
+// go to a small per-thread cache first, so that most allocations do not contend
+// on a lock. A full thread cache is flushed into the per-class free lists, and
+// so are all of them (on their next use) when the free lists alone cannot be
+// trimmed within the max cache size.
 class TensorAllocator : public tensorflow::Allocator {
-  struct AllocKey {
-    struct Hash {
-      size_t operator()(const AllocKey& hk) const {
-        return util::StdHashCombine(hk.alignment, hk.num_bytes);
-      }
-    };
-
-    bool operator==(const AllocKey& rhs) const {
-      return num_bytes == rhs.num_bytes && alignment == rhs.alignment;
-    }
-
-    size_t alignment = 0;
+  static constexpr size_t kBlockAlignment = 64;
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+  static constexpr int kMinClassShift = 8;
+  static constexpr int kSubClassShift = 2;
+  static constexpr int kNumSizeClasses =
+      ((64 - kMinClassShift) << kSubClassShift) + 1;
+  // The size class of the blocks which are never cached.
+  static constexpr int kUncachedClass = -1;
+
+  // Stored right before the memory returned to the caller.
+  struct BlockHeader {
     size_t num_bytes = 0;
+    // The offset of the returned memory from the start of the allocation.
+    size_t offset = 0;
+    int size_class = kUncachedClass;
   };
 
-  struct AllocBlocks {
-    explicit AllocBlocks(const AllocKey& alloc_key) : alloc_key(alloc_key) {}
-
-    AllocKey alloc_key;
+  struct SizeClass {
+    std::mutex lock;
     std::vector<void*> blocks;
   };
 
-  using AllocList = std::list<AllocBlocks>;
+  struct ThreadCache {
+    ~ThreadCache() { TensorAllocator::Get()->ReleaseThreadCache(this); }
+
+    std::vector<void*> blocks[kNumSizeClasses];
+    size_t size = 0;
+    // The trim_epoch_ of the allocator when the cache was last flushed.
+    size_t trim_epoch = 0;
+  };
 
  public:
   static TensorAllocator* Get() {
     static size_t max_size =
         sys_util::GetEnvInt("XLA_TENSOR_ALLOCATOR_MAXSIZE", 1000000000);
-    static TensorAllocator* allocator = new TensorAllocator(max_size);
+    static size_t thread_cache_size = sys_util::GetEnvInt(
+        "XLA_TENSOR_ALLOCATOR_THREAD_CACHE_SIZE", 16 * 1024 * 1024);
+    static bool huge_pages =
+        sys_util::GetEnvBool("XLA_TENSOR_ALLOCATOR_HUGE_PAGES", false);
+    static TensorAllocator* allocator =
+        new TensorAllocator(max_size, thread_cache_size, huge_pages);
     return allocator;
   }
 
   std::string Name() override { return "XLA_TensorAllocator"; }
 
   void* AllocateRaw(size_t alignment, size_t num_bytes) override {
-    // We use an alignment-sized area before the memory returned to the caller,
-    // to store a pointer to its AllocBlocks.
-    alignment = std::max<size_t>(alignment, sizeof(void*));
-    // To call aligned_alloc(), num_bytes must be multiple of alignment.
-    num_bytes = RoundUpTo(num_bytes, alignment);
+    if (alignment > kBlockAlignment || num_bytes > max_size_) {
+      XLA_COUNTER("TensorAllocatorUncached", 1);
+      return NewUncachedBlock(alignment, num_bytes);
+    }
+    int size_class = SizeClassIndex(num_bytes);
+    size_t class_bytes = SizeClassBytes(size_class);
+    void* block = PopThreadCache(size_class, class_bytes);
+    if (block != nullptr) {
+      XLA_COUNTER("TensorAllocatorThreadCacheHit", 1);
+    } else {
+      block = PopSizeClass(size_class);
+      if (block != nullptr) {
+        XLA_COUNTER("TensorAllocatorHit", 1);
+      } else {
+        XLA_COUNTER("TensorAllocatorMiss", 1);
+        TrimCache(class_bytes);
+        block = NewBlock(size_class, class_bytes);
+      }
+    }
+    GetHeader(block)->num_bytes = num_bytes;
+    requested_bytes_ += num_bytes;
+    in_use_bytes_ += class_bytes;
+    return block;
+  }
+
+  void DeallocateRaw(void* ptr) override {
+    if (ptr == nullptr) {
+      return;
+    }
+    BlockHeader* header = GetHeader(ptr);
+    if (header->size_class == kUncachedClass) {
+      FreeBlock(ptr);
+      return;
+    }
+    size_t class_bytes = SizeClassBytes(header->size_class);
+    requested_bytes_ -= header->num_bytes;
+    in_use_bytes_ -= class_bytes;
+    cached_bytes_ += class_bytes;
+    if (!PushThreadCache(ptr, header->size_class, class_bytes)) {
+      PushSizeClass(ptr, header->size_class);
+    }
+  }
+
+ private:
+  TensorAllocator(size_t max_size, size_t thread_cache_size, bool huge_pages)
+      : max_size_(max_size),
+        thread_cache_size_(thread_cache_size),
+        huge_pages_(huge_pages) {}
+
+  static int SizeClassIndex(size_t num_bytes) {
+    if (num_bytes <= (size_t(1) << kMinClassShift)) {
+      return 0;
+    }
+    int shift = tensorflow::Log2Floor64(num_bytes - 1);
+    size_t base = size_t(1) << shift;
+    size_t sub_class = (num_bytes - 1 - base) >> (shift - kSubClassShift);
+    return ((shift - kMinClassShift) << kSubClassShift) +
+           static_cast<int>(sub_class) + 1;
+  }
 
-    AllocKey alloc_key = {alignment, num_bytes};
+  static size_t SizeClassBytes(int size_class) {
+    if (size_class == 0) {
+      return size_t(1) << kMinClassShift;
+    }
+    int shift = kMinClassShift + ((size_class - 1) >> kSubClassShift);
+    size_t sub_class = (size_class - 1) & ((1 << kSubClassShift) - 1);
+    size_t base = size_t(1) << shift;
+    return base + (sub_class + 1) * (base >> kSubClassShift);
+  }
+
+  static BlockHeader* GetHeader(void* ptr) {
+    return reinterpret_cast<BlockHeader*>(ptr) - 1;
+  }
+
+  static ThreadCache* GetThreadCache() {
+    static thread_local ThreadCache cache;
+    return &cache;
+  }
+
+  // Returns the cache of the calling thread, flushed if a trim asked for the
+  // blocks of the thread caches since its last flush.
+  ThreadCache* GetTrimmedThreadCache() {
+    ThreadCache* cache = GetThreadCache();
+    size_t trim_epoch = trim_epoch_.load();
+    if (cache->trim_epoch != trim_epoch) {
+      ReleaseThreadCache(cache);
+      cache->trim_epoch = trim_epoch;
+    }
+    return cache;
+  }
+
+  void* PopThreadCache(int size_class, size_t class_bytes) {
+    ThreadCache* cache = GetTrimmedThreadCache();
+    std::vector<void*>& blocks = cache->blocks[size_class];
+    if (blocks.empty()) {
+      return nullptr;
+    }
+    void* block = blocks.back();
+    blocks.pop_back();
+    cache->size -= class_bytes;
+    cached_bytes_ -= class_bytes;
+    return block;
+  }
+
+  bool PushThreadCache(void* ptr, int size_class, size_t class_bytes) {
+    // Only the smaller blocks are kept per thread, to avoid a single thread
+    // sitting on big chunks of memory other threads could be using.
+    if (class_bytes > thread_cache_size_ / 16) {
+      return false;
+    }
+    ThreadCache* cache = GetTrimmedThreadCache();
+    if (cache->size + class_bytes > thread_cache_size_) {
+      // The blocks a thread keeps freeing are the ones other threads are
+      // likely to allocate, so hand them over to the free lists.
+      XLA_COUNTER("TensorAllocatorThreadCacheFlush", 1);
+      ReleaseThreadCache(cache);
+    }
+    cache->blocks[size_class].push_back(ptr);
+    cache->size += class_bytes;
+    return true;
+  }
+
+  void ReleaseThreadCache(ThreadCache* cache) {
+    for (int size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+      for (void* block : cache->blocks[size_class]) {
+        PushSizeClass(block, size_class);
+      }
+      cache->blocks[size_class].clear();
+    }
+    cache->size = 0;
+  }
+
+  void* PopSizeClass(int size_class) {
+    SizeClass* sclass = &size_classes_[size_class];
     void* block = nullptr;
-    AllocBlocks* alloc_blocks = nullptr;
-    std::lock_guard<std::mutex> lock(lock_);
-    auto it = allocs_.find(alloc_key);
-    if (it != allocs_.end()) {
-      alloc_blocks = &*it->second;
-      if (!alloc_blocks->blocks.empty()) {
-        block = alloc_blocks->blocks.back();
-        alloc_blocks->blocks.pop_back();
+    {
+      std::lock_guard<std::mutex> lock(sclass->lock);
+      if (!sclass->blocks.empty()) {
+        block = sclass->blocks.back();
+        sclass->blocks.pop_back();
       }
-      // LRU
-      alloc_list_.splice(alloc_list_.begin(), alloc_list_, it->second);
-    } else {
-      allocs_.emplace(alloc_key, alloc_list_.insert(alloc_list_.begin(),
-                                                    AllocBlocks(alloc_key)));
-      alloc_blocks = &alloc_list_.front();
     }
-    if (block == nullptr) {
-      TrimCache(alloc_key.num_bytes);
-      block = NewBlock(alloc_blocks);
+    if (block != nullptr) {
+      cached_bytes_ -= SizeClassBytes(size_class);
     }
+    UpdateMetrics();
     return block;
   }
 
-  void DeallocateRaw(void* ptr) override {
-    if (ptr != nullptr) {
-      // The pointer to AllocBlocks is right before the user memory.
-      AllocBlocks* alloc_blocks = reinterpret_cast<AllocBlocks**>(ptr)[-1];
-      std::lock_guard<std::mutex> lock(lock_);
-      if (alloc_blocks->alloc_key.num_bytes < max_size_) {
-        alloc_blocks->blocks.push_back(ptr);
-      } else {
-        // We do not cache blocks whose size is bigger than the max cache size.
-        FreeBlock(ptr, alloc_blocks);
-      }
+  void PushSizeClass(void* ptr, int size_class) {
+    SizeClass* sclass = &size_classes_[size_class];
+    std::lock_guard<std::mutex> lock(sclass->lock);
+    sclass->blocks.push_back(ptr);
+  }
+
+  void* NewBlock(int size_class, size_t class_bytes) {
+    // The BlockHeader lives within an extra alignment sized area before the
+    // returned memory.
+    size_t alloc_size = kBlockAlignment + class_bytes;
+    size_t alignment = kBlockAlignment;
+    bool huge_pages = huge_pages_ && alloc_size >= kHugePageSize;
+    if (huge_pages) {
+      alloc_size = RoundUpTo(alloc_size, kHugePageSize);
+      alignment = kHugePageSize;
     }
+    void* ptr = TensorAllocatorTraits::allocate(alloc_size, alignment);
+    XLA_CHECK(ptr != nullptr);
+    if (huge_pages) {
+      TensorAllocatorTraits::advise_huge_pages(ptr, alloc_size);
+      XLA_COUNTER("TensorAllocatorHugePageBlocks", 1);
+    }
+    ptr = reinterpret_cast<char*>(ptr) + kBlockAlignment;
+    BlockHeader* header = new (GetHeader(ptr)) BlockHeader();
+    header->offset = kBlockAlignment;
+    header->size_class = size_class;
+    size_ += class_bytes;
+    return ptr;
   }
 
- private:
-  explicit TensorAllocator(size_t max_size) : max_size_(max_size) {}
-
-  void* NewBlock(AllocBlocks* alloc_blocks) {
-    // We allocate an extra alignment sized area to store the AllocBlocks
-    // pointer.
-    void *ptr = TensorAllocatorTraits::allocate(
-        alloc_blocks->alloc_key.alignment + alloc_blocks->alloc_key.num_bytes,
-        alloc_blocks->alloc_key.alignment);
+  void* NewUncachedBlock(size_t alignment, size_t num_bytes) {
+    if (alignment < kBlockAlignment) {
+      alignment = kBlockAlignment;
+    }
+    // To call aligned_alloc(), the size must be multiple of alignment.
+    void* ptr = TensorAllocatorTraits::allocate(
+        alignment + RoundUpTo(num_bytes, alignment), alignment);
     XLA_CHECK(ptr != nullptr);
-    ptr = reinterpret_cast<char*>(ptr) + alloc_blocks->alloc_key.alignment;
-    // Store the pointer to AllocBlocks right before the user memory.
-    reinterpret_cast<AllocBlocks**>(ptr)[-1] = alloc_blocks;
-    size_ += alloc_blocks->alloc_key.num_bytes;
+    ptr = reinterpret_cast<char*>(ptr) + alignment;
+    BlockHeader* header = new (GetHeader(ptr)) BlockHeader();
+    header->num_bytes = num_bytes;
+    header->offset = alignment;
     return ptr;
   }
 
-  void FreeBlock(void* ptr, AllocBlocks* alloc_blocks) {
-    size_ -= alloc_blocks->alloc_key.num_bytes;
-    TensorAllocatorTraits::deallocate(
-        reinterpret_cast<char*>(ptr) - alloc_blocks->alloc_key.alignment);
+  void FreeBlock(void* ptr) {
+    BlockHeader* header = GetHeader(ptr);
+    if (header->size_class != kUncachedClass) {
+      size_ -= SizeClassBytes(header->size_class);
+    }
+    TensorAllocatorTraits::deallocate(reinterpret_cast<char*>(ptr) -
+                                      header->offset);
   }
 
+  // Frees blocks sitting in the per-class free lists, starting from the
+  // biggest classes, until num_bytes more can be allocated within the max
+  // cache size. If that is not enough, the thread caches are asked to flush
+  // their blocks into the free lists, for the next trims to free them.
   void TrimCache(size_t num_bytes) {
-    auto it = alloc_list_.rbegin();
-    for (; size_ + num_bytes > max_size_ && it != alloc_list_.rend(); ++it) {
-      AllocBlocks* alloc_blocks = &*it;
-      while (!alloc_blocks->blocks.empty() && size_ + num_bytes > max_size_) {
-        FreeBlock(alloc_blocks->blocks.back(), alloc_blocks);
-        alloc_blocks->blocks.pop_back();
+    for (int size_class = kNumSizeClasses - 1;
+         size_class >= 0 && size_ + num_bytes > max_size_; --size_class) {
+      SizeClass* sclass = &size_classes_[size_class];
+      size_t class_bytes = SizeClassBytes(size_class);
+      std::lock_guard<std::mutex> lock(sclass->lock);
+      while (!sclass->blocks.empty() && size_ + num_bytes > max_size_) {
+        FreeBlock(sclass->blocks.back());
+        sclass->blocks.pop_back();
+        cached_bytes_ -= class_bytes;
+        XLA_COUNTER("TensorAllocatorTrimmed", 1);
       }
     }
+    if (size_ + num_bytes > max_size_ && cached_bytes_ > 0) {
+      trim_epoch_ += 1;
+    }
+  }
+
+  void UpdateMetrics() {
+    XLA_VALUE_METRIC("TensorAllocatorCachedBytes", cached_bytes_.load());
+    size_t in_use_bytes = in_use_bytes_.load();
+    if (in_use_bytes > 0) {
+      // The share of the in use blocks which is lost to size class rounding.
+      XLA_VALUE_METRIC("TensorAllocatorFragmentation",
+                       1.0 - static_cast<double>(requested_bytes_.load()) /
+                                 in_use_bytes);
+    }
   }
 
   size_t max_size_ = 0;
-  std::mutex lock_;
-  size_t size_ = 0;
-  AllocList alloc_list_;
-  absl::node_hash_map<AllocKey, AllocList::iterator, AllocKey::Hash> allocs_;
+  size_t thread_cache_size_ = 0;
+  bool huge_pages_ = false;
+  // The bytes held by the cached size class blocks, either in use or cached.
+  std::atomic<size_t> size_{0};
+  std::atomic<size_t> cached_bytes_{0};
+  std::atomic<size_t> in_use_bytes_{0};
+  std::atomic<size_t> requested_bytes_{0};
+  std::atomic<size_t> trim_epoch_{0};
+  SizeClass size_classes_[kNumSizeClasses];
 };
 
 std::string StripPrefix(const std::string& value, const std::string& prefix) {
@@ -560,6 +760,12 @@ bool ParseEnvDevices(XrtComputationClient::Options* options) {
   return !options->global_device_map.empty();
 }
 
+std::atomic<bool>* SplitChainedExecutionEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      sys_util::GetEnvInt("XRT_SPLIT_CHAINED_EXEC", 0) != 0);
+  return enabled;
+}
+
 }  // namespace
 
 std::unique_ptr<ComputationClient> ComputationClient::Create() {
@@ -586,6 +792,7 @@ void XrtComputationClient::XrtData::Assign(const Data& data) {
   const XrtData& xrt_data = dynamic_cast<const XrtData&>(data);
   if (&xrt_data != this) {
     handle_ptr = xrt_data.handle_ptr;
+    AssignBuffer(xrt_data);
   }
 }
 
@@ -1039,9 +1246,13 @@ XrtComputationClient::ExecuteParallel(
 
 std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChained(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
-  static int64_t split_mode = sys_util::GetEnvInt("XRT_SPLIT_CHAINED_EXEC", 0);
-  return split_mode ? ExecuteChainedSplit(ops, device)
-                    : ExecuteChainedXrt(ops, device);
+  return SplitChainedExecutionEnabled()->load()
+             ? ExecuteChainedSplit(ops, device)
+             : ExecuteChainedXrt(ops, device);
+}
+
+void XrtComputationClient::SetSplitChainedExecution(bool enabled) {
+  SplitChainedExecutionEnabled()->store(enabled);
 }
 
 std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
@@ -1129,60 +1340,53 @@ std::vector<ComputationClient::DataPtr>
 XrtComputationClient::ExecuteChainedSplit(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
   metrics::TimedSection timed(ExecuteChainedMetric());
+  static const size_t max_parallelism = std::max<int64_t>(
+      sys_util::GetEnvInt("XRT_SPLIT_CHAINED_EXEC_PARALLELISM", 8), 1);
 
+  // The uses count the consumers still to run, to drop intermediate results as
+  // soon as possible, while the pending inputs count the producers still to
+  // complete before an op becomes ready.
   std::vector<int64_t> uses(ops.size(), 0);
-  for (auto& op : ops) {
-    for (auto& input : op.inputs) {
+  std::vector<size_t> pending_inputs(ops.size(), 0);
+  std::vector<std::vector<size_t>> consumers(ops.size());
+  std::deque<size_t> ready;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    for (auto& input : ops[i].inputs) {
+      XLA_CHECK_LT(input.op_index, i);
       uses[input.op_index] += 1;
+      pending_inputs[i] += 1;
+      consumers[input.op_index].push_back(i);
+    }
+    if (pending_inputs[i] == 0) {
+      ready.push_back(i);
     }
   }
-  XrtSessionCache::SessionMap session_map;
   std::string effective_device = GetEffectiveDevice(device);
-  const std::string& xrt_device = SwiftDeviceToXrtDevice(effective_device);
-  XrtSession* session =
-      GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
-  tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
   std::vector<std::vector<DataPtr>> ops_outputs(ops.size());
   std::vector<DataPtr> results;
-  for (size_t i = 0; i < ops.size(); ++i) {
-    const ExecuteChainedOp& op = ops[i];
-    if (op.device_data != nullptr) {
-      ops_outputs[i].push_back(op.device_data);
-    } else {
-      tensorflow::ClientSession::FeedType feed_inputs;
-      std::vector<DataPtr> arguments;
-      arguments.reserve(op.inputs.size());
-      for (auto& input : op.inputs) {
-        XLA_CHECK_LT(input.op_index, i);
-        XLA_CHECK_LT(input.output_index.value_or(0),
-                     ops_outputs[input.op_index].size());
-        arguments.push_back(
-            ops_outputs[input.op_index][input.output_index.value_or(0)]);
-      }
-
-      std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
-          &session_map, dynamic_cast<const XrtComputation&>(*op.computation),
-          BuildParallelArguments(arguments), /*explode_tuple=*/true,
-          {effective_device}, &feed_inputs);
-
-      std::vector<tensorflow::Tensor> outputs;
-      util::CheckComputationStatus(
-          session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs),
-          {&op.computation->computation()},
-          {&op.computation->program_shape().result()});
-      XLA_CHECK_EQ(outputs.size(), 1);
-      ops_outputs[i] = GetComputationResults(
-          outputs[0], op.computation->program_shape().result(),
-          effective_device);
-    }
-
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t running = 0;
+  size_t completed = 0;
+  std::exception_ptr exptr;
+
+  // Must be called with the mutex held, once the outputs of the op at index
+  // have been stored.
+  auto complete_op = [&](size_t index) {
+    const ExecuteChainedOp& op = ops[index];
     for (auto& output : op.outputs) {
       if (output.result_index >= results.size()) {
         results.resize(output.result_index + 1);
       }
-      XLA_CHECK_LT(output.output_index.value_or(0), ops_outputs[i].size());
+      XLA_CHECK_LT(output.output_index.value_or(0), ops_outputs[index].size());
       results[output.result_index] =
-          ops_outputs[i][output.output_index.value_or(0)];
+          ops_outputs[index][output.output_index.value_or(0)];
+    }
+    for (size_t consumer : consumers[index]) {
+      pending_inputs[consumer] -= 1;
+      if (pending_inputs[consumer] == 0) {
+        ready.push_back(consumer);
+      }
     }
     // Drop references to any intermediate result which is not used anymore.
     for (auto& input : op.inputs) {
@@ -1191,13 +1395,113 @@ XrtComputationClient::ExecuteChainedSplit(
         ops_outputs[input.op_index].clear();
       }
     }
-    // We can reset the TF op cache here so that we don't keep allocating new
-    // TF op nodes on the session graph.
-    session->Reset();
+    ++completed;
+  };
+
+  // Stores the first error hit by the dispatch or by the runners. Must be
+  // called with the mutex held.
+  auto set_error = [&](std::exception_ptr error) {
+    if (exptr == nullptr) {
+      exptr = std::move(error);
+    }
+  };
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (completed < ops.size() && exptr == nullptr) {
+    try {
+      while (!ready.empty() && running < max_parallelism) {
+        size_t index = ready.front();
+        ready.pop_front();
+        const ExecuteChainedOp& op = ops[index];
+        if (op.device_data != nullptr) {
+          ops_outputs[index].push_back(op.device_data);
+          complete_op(index);
+          continue;
+        }
+        std::vector<DataPtr> arguments;
+        arguments.reserve(op.inputs.size());
+        for (auto& input : op.inputs) {
+          XLA_CHECK_LT(input.output_index.value_or(0),
+                       ops_outputs[input.op_index].size());
+          arguments.push_back(
+              ops_outputs[input.op_index][input.output_index.value_or(0)]);
+        }
+        ++running;
+        XLA_VALUE_METRIC("ExecuteChainedSplitInFlight", running);
+        auto runner = [&, index, arguments = std::move(arguments)]() {
+          std::vector<DataPtr> outputs;
+          std::exception_ptr op_exptr;
+          try {
+            outputs =
+                ExecuteChainedSplitOp(ops[index], arguments, effective_device);
+          } catch (...) {
+            op_exptr = std::current_exception();
+          }
+          std::lock_guard<std::mutex> runner_lock(mutex);
+          if (op_exptr == nullptr) {
+            try {
+              ops_outputs[index] = std::move(outputs);
+              complete_op(index);
+            } catch (...) {
+              op_exptr = std::current_exception();
+            }
+          }
+          if (op_exptr != nullptr) {
+            set_error(std::move(op_exptr));
+          }
+          --running;
+          // Notify with the lock held, as the waiter owns the condition
+          // variable and returns as soon as it sees the last op completing.
+          cv.notify_all();
+        };
+        try {
+          env::ScheduleIoClosure(std::move(runner));
+        } catch (...) {
+          --running;
+          throw;
+        }
+      }
+    } catch (...) {
+      set_error(std::current_exception());
+      break;
+    }
+    cv.wait(lock, [&] {
+      return completed == ops.size() || exptr != nullptr ||
+             (!ready.empty() && running < max_parallelism);
+    });
+  }
+  // On error, wait for the ops in flight, which reference our local state.
+  cv.wait(lock, [&] { return running == 0; });
+  if (exptr != nullptr) {
+    std::rethrow_exception(exptr);
   }
   return results;
 }
 
+std::vector<ComputationClient::DataPtr>
+XrtComputationClient::ExecuteChainedSplitOp(const ExecuteChainedOp& op,
+                                            absl::Span<const DataPtr> arguments,
+                                            const std::string& device) {
+  XrtSessionCache::SessionMap session_map;
+  const std::string& xrt_device = SwiftDeviceToXrtDevice(device);
+  XrtSession* session =
+      GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
+  tensorflow::ClientSession::FeedType feed_inputs;
+  std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
+      &session_map, dynamic_cast<const XrtComputation&>(*op.computation),
+      BuildParallelArguments(arguments), /*explode_tuple=*/true, {device},
+      &feed_inputs);
+
+  std::vector<tensorflow::Tensor> outputs;
+  tensorflow::Status status =
+      session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs);
+  util::CheckComputationStatus(status, {&op.computation->computation()},
+                               {&op.computation->program_shape().result()});
+  XLA_CHECK_EQ(outputs.size(), 1);
+  return GetComputationResults(
+      outputs[0], op.computation->program_shape().result(), device);
+}
+
 std::vector<std::vector<ComputationClient::DataPtr>>
 XrtComputationClient::DeconstructTuple(absl::Span<const DataPtr> tuples) {
   metrics::TimedSection timed(DeconstructTupleMetric());
@@ -197,6 +197,10 @@ class XrtComputationClient : public ComputationClient,
 
   static Worker ParseWorker(const std::string& worker);
 
+  // Sets whether ExecuteChained() runs the ops one XRTExecute at a time,
+  // overriding XRT_SPLIT_CHAINED_EXEC.
+  static void SetSplitChainedExecution(bool enabled);
+
   static std::string GetMultiProcessingDevice();
 
  private:
@@ -337,10 +341,20 @@ class XrtComputationClient : public ComputationClient,
                                          const std::string& device);
 
   // Implement the chained execution using multiple XRTExecute in many RPC round
-  // trips.
+  // trips. The ops are scheduled following their dependencies, with the ones
+  // whose inputs are ready being run concurrently on separate sessions (up to
+  // XRT_SPLIT_CHAINED_EXEC_PARALLELISM at a time).
   std::vector<DataPtr> ExecuteChainedSplit(
       absl::Span<const ExecuteChainedOp> ops, const std::string& device);
 
+  // Runs a single computation op of an ExecuteChainedSplit() plan, using a
+  // session exclusively checked out of the session cache. The cache rewinds the
+  // session node caches on checkout, so the execute nodes created by previous
+  // ops get reused.
+  std::vector<DataPtr> ExecuteChainedSplitOp(
+      const ExecuteChainedOp& op, absl::Span<const DataPtr> arguments,
+      const std::string& device);
+
   // Creates an XRT graph with an XRTCompile operation:
   //
   //  XRTCompile(
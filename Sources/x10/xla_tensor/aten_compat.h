@@ -19,10 +19,12 @@
 #include <cassert>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#include "absl/numeric/int128.h"
 #include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "absl/types/variant.h"
@@ -772,19 +774,25 @@
 #define FORALL_XLA_SYMBOLS(_, __)  \
   __(xla, all_to_all)              \
   _(xla, as_strided_view_update)   \
+  _(xla, call)                     \
   _(xla, cast)                     \
   _(xla, collective_permute)       \
   _(xla, cross_replica_sum)        \
   _(xla, device_data)              \
   _(xla, diagonal_view_update)     \
+  _(xla, flat_pack)                \
+  _(xla, flat_unpack)              \
   _(xla, generic_slice)            \
   _(xla, get_dimensions_size)      \
   _(xla, moving_average)           \
+  _(xla, multi_tensor_adam)        \
+  _(xla, multi_tensor_sgd)         \
   _(xla, nms)                      \
   _(xla, not_supported)            \
   _(xla, replication_pad)          \
   _(xla, replication_pad_backward) \
   _(xla, select)                   \
+  _(xla, set_dimension_size)       \
   _(xla, tensor_data)              \
   _(xla, token)                    \
   _(xla, unselect)                 \
@@ -997,6 +1005,21 @@ class AnyScalarBuffer {
 
   ScalarType scalar_type() const { return type_; }
 
+  // Returns the hash of the buffer content computed by hash_fn, which only gets
+  // called the first time (and after the content has been modified), for the
+  // buffers owning their data.
+  template <typename F>
+  absl::uint128 content_hash(const F& hash_fn) const {
+    if (!memoize_content_hash_) {
+      return hash_fn();
+    }
+    std::lock_guard<std::mutex> lock(content_hash_mutex_);
+    if (!content_hash_) {
+      content_hash_ = hash_fn();
+    }
+    return *content_hash_;
+  }
+
   std::unique_ptr<AnyScalarBuffer> dup() {
     switch (type_) {
 #define DUP_CASE(name, aten_name, DType)                \
@@ -1020,10 +1043,22 @@ class AnyScalarBuffer {
   void set_base(const void* base) { base_ = base; }
   void set_size(size_t size) { size_ = size; }
 
+  // Must be called by the subclasses handing out writable access to the data.
+  void invalidate_content_hash() {
+    std::lock_guard<std::mutex> lock(content_hash_mutex_);
+    content_hash_ = absl::nullopt;
+  }
+
+  // For the buffers whose data can change under them.
+  void disable_content_hash_memoization() { memoize_content_hash_ = false; }
+
  private:
   const void* base_;
   size_t size_;
   ScalarType type_;
+  bool memoize_content_hash_ = true;
+  mutable std::mutex content_hash_mutex_;
+  mutable absl::optional<absl::uint128> content_hash_;
 };
 
 // Implementation of Scalar buffer backed by a unique_ptr.
@@ -1061,6 +1096,8 @@ class NonOwnedAnyScalarBuffer : public AnyScalarBuffer {
       : AnyScalarBuffer(internal::GetScalarType<T>()) {
     set_base(data);
     set_size(len);
+    // The owner of the data is free to modify it.
+    disable_content_hash_memoization();
   }
 };
 
@@ -1099,6 +1136,9 @@ class Tensor {
     if (shape_ != other.shape_ || scalar_type() != other.scalar_type()) {
       return false;
     }
+    if (data_ == other.data_) {
+      return true;
+    }
     switch (scalar_type()) {
 #define DEFINE_COMPARE_CASE(name, aten_name, type) \
   case ScalarType::aten_name:                      \
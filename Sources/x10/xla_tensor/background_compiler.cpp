@@ -0,0 +1,117 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/background_compiler.h"
+
+#include <algorithm>
+#include <exception>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace {
+
+std::atomic<bool>* BackgroundCompileEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_BACKGROUND_COMPILE", false));
+  return enabled;
+}
+
+}  // namespace
+
+BackgroundCompiler* BackgroundCompiler::Get() {
+  static BackgroundCompiler* compiler = new BackgroundCompiler(
+      std::max<size_t>(
+          xla::sys_util::GetEnvInt("XLA_BACKGROUND_COMPILE_THREADS", 1), 1),
+      xla::sys_util::GetEnvInt("XLA_BACKGROUND_COMPILE_QUEUE_MAX", 16));
+  return BackgroundCompileEnabled()->load() ? compiler : nullptr;
+}
+
+void BackgroundCompiler::SetEnabled(bool enabled) {
+  BackgroundCompileEnabled()->store(enabled);
+}
+
+BackgroundCompiler::BackgroundCompiler(size_t max_running, size_t max_queued)
+    : max_running_(max_running), max_queued_(max_queued) {}
+
+BackgroundCompiler::Status BackgroundCompiler::Schedule(
+    const xla::hash_t& hash, std::function<void()> compile_fn) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failed_.contains(hash)) {
+      return Status::kFailed;
+    }
+    if (pending_.contains(hash)) {
+      return Status::kPending;
+    }
+    if (running_ >= max_running_ && queue_.size() >= max_queued_) {
+      XLA_COUNTER("BackgroundCompileQueueFull", 1);
+      return Status::kQueueFull;
+    }
+    pending_.insert(hash);
+    XLA_COUNTER("BackgroundCompiles", 1);
+    if (running_ >= max_running_) {
+      queue_.emplace_back(hash, std::move(compile_fn));
+      XLA_VALUE_METRIC("BackgroundCompileQueueSize", queue_.size());
+      return Status::kScheduled;
+    }
+    running_ += 1;
+  }
+  Run(Task(hash, std::move(compile_fn)));
+  return Status::kScheduled;
+}
+
+void BackgroundCompiler::Run(Task task) {
+  auto runfn = [this, task = std::move(task)]() {
+    bool failed = false;
+    try {
+      XLA_TIMED("BackgroundCompileTime");
+      task.second();
+    } catch (const std::exception& ex) {
+      TF_LOG(ERROR) << "Background compilation of IR graph hash "
+                    << xla::util::HexHash(task.first)
+                    << " failed: " << ex.what();
+      failed = true;
+    } catch (...) {
+      TF_LOG(ERROR) << "Background compilation of IR graph hash "
+                    << xla::util::HexHash(task.first) << " failed";
+      failed = true;
+    }
+    absl::optional<Task> next;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.erase(task.first);
+      if (failed) {
+        XLA_COUNTER("BackgroundCompileErrors", 1);
+        failed_.insert(task.first);
+      }
+      if (queue_.empty()) {
+        running_ -= 1;
+      } else {
+        next = std::move(queue_.front());
+        queue_.pop_front();
+      }
+    }
+    if (next) {
+      Run(std::move(*next));
+    }
+  };
+  xla::env::ScheduleClosure(std::move(runfn));
+}
+
+}  // namespace swift_xla
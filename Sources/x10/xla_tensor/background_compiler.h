@@ -0,0 +1,81 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+// Runs the compilations of the graphs missing from the computation cache in
+// background, while the steps needing them fall back to the op-by-op
+// execution. Enabled by XLA_BACKGROUND_COMPILE, with at most
+// XLA_BACKGROUND_COMPILE_THREADS (1 by default) compilations running at the
+// same time, and at most XLA_BACKGROUND_COMPILE_QUEUE_MAX (16 by default)
+// other ones queued. The graphs missing from the cache while the queue is full
+// are compiled synchronously.
+class BackgroundCompiler {
+ public:
+  enum class Status {
+    // The compilation has been queued.
+    kScheduled,
+    // A compilation of the same graph is already queued or running.
+    kPending,
+    // A compilation of the same graph failed, and the caller should compile it
+    // synchronously to surface the error.
+    kFailed,
+    // The queue is full, and the caller should compile the graph
+    // synchronously.
+    kQueueFull,
+  };
+
+  // Returns the compiler, or nullptr if the background compilation is
+  // disabled.
+  static BackgroundCompiler* Get();
+
+  // Enables or disables the background compilation, overriding
+  // XLA_BACKGROUND_COMPILE.
+  static void SetEnabled(bool enabled);
+
+  // Schedules compile_fn, which compiles the graph with the given hash and
+  // adds it to the computation cache. An exception thrown by compile_fn marks
+  // the graph as failed.
+  Status Schedule(const xla::hash_t& hash, std::function<void()> compile_fn);
+
+ private:
+  using Task = std::pair<xla::hash_t, std::function<void()>>;
+
+  BackgroundCompiler(size_t max_running, size_t max_queued);
+
+  void Run(Task task);
+
+  std::mutex mutex_;
+  const size_t max_running_;
+  const size_t max_queued_;
+  size_t running_ = 0;
+  std::deque<Task> queue_;
+  absl::flat_hash_set<xla::hash_t, xla::util::HashReducer> pending_;
+  absl::flat_hash_set<xla::hash_t, xla::util::HashReducer> failed_;
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,462 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace swift_xla {
+namespace {
+
+constexpr char kCheckpointMagic[] = "X10CKPT1";
+constexpr size_t kCheckpointMagicSize = sizeof(kCheckpointMagic) - 1;
+
+// Implementation of Scalar buffer backed by a region of a mapped checkpoint,
+// or by the buffer its content has been decompressed into.
+class CheckpointScalarBuffer : public at::AnyScalarBuffer {
+ public:
+  CheckpointScalarBuffer(at::ScalarType type, const void* data, size_t len)
+      : at::AnyScalarBuffer(type) {
+    set_base(data);
+    set_size(len);
+    // The content is only hashed once, if ever, before the upload.
+    disable_content_hash_memoization();
+  }
+
+  CheckpointScalarBuffer(at::ScalarType type, std::string data, size_t len)
+      : CheckpointScalarBuffer(type, nullptr, len) {
+    owned_data_ = std::move(data);
+    set_base(owned_data_.data());
+  }
+
+ private:
+  std::string owned_data_;
+};
+
+template <typename T>
+void AppendValue(T value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class HeaderReader {
+ public:
+  HeaderReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    std::memcpy(&value, Consume(sizeof(value)), sizeof(value));
+    return value;
+  }
+
+  std::string ReadString(size_t size) {
+    const char* data = Consume(size);
+    return std::string(data, size);
+  }
+
+  size_t position() const { return position_; }
+
+ private:
+  const char* Consume(size_t size) {
+    XLA_CHECK_LE(size, size_ - position_) << "Truncated X10 checkpoint header";
+    const char* data = data_ + position_;
+    position_ += size;
+    return data;
+  }
+
+  const char* data_;
+  size_t size_;
+  size_t position_ = 0;
+};
+
+uint64_t RoundUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t EntryElementsCount(const CheckpointEntry& entry) {
+  return xla::util::Multiply<size_t>(entry.dimensions);
+}
+
+// Drops the pages backing the given range of a read-only file mapping, which
+// have been uploaded already. They would be read again from the file if
+// touched.
+void ReleasePages(const char* data, size_t size) {
+#if defined(__linux__) || defined(__APPLE__)
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t start = RoundUp(reinterpret_cast<uintptr_t>(data), page_size);
+  uintptr_t end = (reinterpret_cast<uintptr_t>(data) + size) / page_size *
+                  page_size;
+  if (start < end) {
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_DONTNEED);
+  }
+#endif
+}
+
+// The type of the host tensors wrapping the checkpoint content, which unlike
+// TensorTypeFromXlaType() keeps the width of the reduced precision types.
+at::ScalarType HostTensorType(xla::PrimitiveType element_type) {
+  switch (element_type) {
+    case xla::PrimitiveType::BF16:
+      return at::ScalarType::BFloat16;
+    case xla::PrimitiveType::F16:
+      return at::ScalarType::Half;
+    default:
+      return TensorTypeFromXlaType(element_type);
+  }
+}
+
+std::string Uncompress(const CheckpointEntry& entry, const char* data) {
+  size_t size = 0;
+  XLA_CHECK(tensorflow::port::Snappy_GetUncompressedLength(
+      data, entry.stored_size, &size))
+      << "Snappy is not available, or corrupted checkpoint entry "
+      << entry.name;
+  XLA_CHECK_EQ(size, entry.size)
+      << "Invalid uncompressed size for checkpoint entry " << entry.name;
+  std::string buffer(size, '\0');
+  XLA_CHECK(tensorflow::port::Snappy_Uncompress(data, entry.stored_size,
+                                                &buffer[0]))
+      << "Corrupted checkpoint entry " << entry.name;
+  return buffer;
+}
+
+}  // namespace
+
+std::string SerializeCheckpointHeader(
+    absl::Span<const CheckpointEntry> entries) {
+  std::string index;
+  AppendValue<uint64_t>(entries.size(), &index);
+  for (const CheckpointEntry& entry : entries) {
+    AppendValue<uint32_t>(entry.name.size(), &index);
+    index.append(entry.name);
+    AppendValue<int32_t>(entry.element_type, &index);
+    AppendValue<uint32_t>(entry.dimensions.size(), &index);
+    for (int64_t dim : entry.dimensions) {
+      AppendValue<int64_t>(dim, &index);
+    }
+    AppendValue<uint64_t>(entry.offset, &index);
+    AppendValue<uint64_t>(entry.size, &index);
+    AppendValue<uint32_t>(static_cast<uint32_t>(entry.compression), &index);
+    AppendValue<uint64_t>(entry.stored_size, &index);
+  }
+  std::string header(kCheckpointMagic, kCheckpointMagicSize);
+  AppendValue<uint64_t>(index.size(), &header);
+  header.append(index);
+  header.resize(RoundUp(header.size(), kCheckpointAlignment), '\0');
+  return header;
+}
+
+uint64_t ParseCheckpointHeader(const char* data, size_t size,
+                               std::vector<CheckpointEntry>* entries) {
+  HeaderReader reader(data, size);
+  XLA_CHECK_EQ(reader.ReadString(kCheckpointMagicSize), kCheckpointMagic)
+      << "Not an X10 checkpoint";
+  uint64_t index_size = reader.Read<uint64_t>();
+  size_t index_start = reader.position();
+  uint64_t count = reader.Read<uint64_t>();
+  entries->clear();
+  for (uint64_t i = 0; i < count; ++i) {
+    CheckpointEntry entry;
+    entry.name = reader.ReadString(reader.Read<uint32_t>());
+    entry.element_type = static_cast<xla::PrimitiveType>(
+        reader.Read<int32_t>());
+    uint32_t rank = reader.Read<uint32_t>();
+    for (uint32_t dim = 0; dim < rank; ++dim) {
+      entry.dimensions.push_back(reader.Read<int64_t>());
+    }
+    entry.offset = reader.Read<uint64_t>();
+    entry.size = reader.Read<uint64_t>();
+    entry.compression =
+        static_cast<CheckpointCompression>(reader.Read<uint32_t>());
+    entry.stored_size = reader.Read<uint64_t>();
+    XLA_CHECK(entry.compression == CheckpointCompression::kNone ||
+              entry.compression == CheckpointCompression::kSnappy)
+        << "Invalid compression for checkpoint entry " << entry.name;
+    XLA_CHECK(entry.compression != CheckpointCompression::kNone ||
+              entry.stored_size == entry.size)
+        << "Invalid stored size for checkpoint entry " << entry.name;
+    XLA_CHECK(xla::primitive_util::IsArrayType(entry.element_type))
+        << "Invalid element type for checkpoint entry " << entry.name;
+    XLA_CHECK_EQ(entry.size,
+                 EntryElementsCount(entry) *
+                     xla::ShapeUtil::ByteSizeOfPrimitiveType(
+                         entry.element_type))
+        << "Invalid size for checkpoint entry " << entry.name;
+    entries->push_back(std::move(entry));
+  }
+  XLA_CHECK_EQ(reader.position() - index_start, index_size)
+      << "Corrupted X10 checkpoint index";
+  return RoundUp(reader.position(), kCheckpointAlignment);
+}
+
+CheckpointLoader::CheckpointLoader(const std::string& path) {
+  XLA_CHECK_OK(tensorflow::Env::Default()->NewReadOnlyMemoryRegionFromFile(
+      path, &region_));
+  const char* data = static_cast<const char*>(region_->data());
+  data_offset_ = ParseCheckpointHeader(data, region_->length(), &entries_);
+  for (const CheckpointEntry& entry : entries_) {
+    XLA_CHECK_LE(data_offset_ + entry.offset + entry.stored_size,
+                 region_->length())
+        << "Truncated X10 checkpoint " << path << ", at entry " << entry.name;
+  }
+#if defined(__linux__) || defined(__APPLE__)
+  madvise(const_cast<char*>(data), region_->length(), MADV_SEQUENTIAL);
+#endif
+}
+
+std::vector<XLATensor> CheckpointLoader::Load(const Device& device) {
+  static const size_t kChunkSize = xla::sys_util::GetEnvInt(
+      "XLA_CHECKPOINT_CHUNK_SIZE", 256 * 1024 * 1024);
+  static const size_t kMaxChunksInFlight =
+      xla::sys_util::GetEnvInt("XLA_CHECKPOINT_CHUNKS_IN_FLIGHT", 2);
+  XLA_CHECK_GT(kMaxChunksInFlight, 0);
+  XLA_TIMED("CheckpointLoadTime");
+  // Chunks are ranges of entries, which are closed once they reach the chunk
+  // size. A single entry larger than that makes a chunk on its own.
+  std::vector<std::pair<size_t, size_t>> chunks;
+  for (size_t i = 0, chunk_bytes = 0; i < entries_.size(); ++i) {
+    if (chunks.empty() || chunk_bytes >= kChunkSize) {
+      chunks.emplace_back(i, i);
+      chunk_bytes = 0;
+    }
+    chunks.back().second = i + 1;
+    chunk_bytes += entries_[i].size;
+  }
+
+  const char* data = static_cast<const char*>(region_->data()) + data_offset_;
+  std::string device_string = device.ToString();
+  std::vector<xla::ComputationClient::DataPtr> handles(entries_.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t chunks_in_flight = 0;
+  xla::util::MultiWait mwait(chunks.size());
+  for (auto& chunk : chunks) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return chunks_in_flight < kMaxChunksInFlight; });
+      ++chunks_in_flight;
+    }
+    auto upload = [&, chunk]() {
+      xla::util::ExceptionCleanup in_flight_cleanup(
+          [&](xla::util::ExceptionCleanup::StatusType) {
+            {
+              std::lock_guard<std::mutex> lock(mutex);
+              --chunks_in_flight;
+            }
+            cv.notify_all();
+          });
+      std::vector<at::Tensor> tensors;
+      for (size_t i = chunk.first; i < chunk.second; ++i) {
+        const CheckpointEntry& entry = entries_[i];
+        at::ScalarType type = HostTensorType(entry.element_type);
+        std::unique_ptr<CheckpointScalarBuffer> buffer;
+        if (entry.compression == CheckpointCompression::kSnappy) {
+          buffer = std::make_unique<CheckpointScalarBuffer>(
+              type, Uncompress(entry, data + entry.offset),
+              EntryElementsCount(entry));
+        } else {
+          buffer = std::make_unique<CheckpointScalarBuffer>(
+              type, data + entry.offset, EntryElementsCount(entry));
+        }
+        tensors.emplace_back(std::move(buffer), entry.dimensions);
+      }
+      std::vector<xla::ComputationClient::DataPtr> chunk_handles =
+          CreateTensorsData(tensors, device_string);
+      for (size_t i = chunk.first; i < chunk.second; ++i) {
+        handles[i] = std::move(chunk_handles[i - chunk.first]);
+      }
+      uint64_t begin = entries_[chunk.first].offset;
+      uint64_t end = begin;
+      for (size_t i = chunk.first; i < chunk.second; ++i) {
+        begin = std::min(begin, entries_[i].offset);
+        end = std::max(end, entries_[i].offset + entries_[i].stored_size);
+      }
+      ReleasePages(data + begin, end - begin);
+      XLA_COUNTER("CheckpointChunks", 1);
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(upload)));
+  }
+  mwait.Wait();
+
+  std::vector<XLATensor> tensors;
+  tensors.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    tensors.push_back(
+        XLATensor::Create(std::move(handles[i]),
+                          TensorTypeFromXlaType(entries_[i].element_type)));
+  }
+  return tensors;
+}
+
+CheckpointWriter::CheckpointWriter(std::string path,
+                                   std::vector<std::string> names,
+                                   std::vector<XLATensor> tensors,
+                                   bool compress)
+    : path_(std::move(path)),
+      compress_(compress),
+      done_(false),
+      task_([this]() { return Write(); }) {
+  XLA_CHECK_EQ(names.size(), tensors.size());
+  {
+    XLA_TIMED("CheckpointStallTime");
+    // Schedules the computation of the tensors which still have pending IR,
+    // without waiting for it. The writer waits for the device on its side.
+    XLATensor::SyncTensorsGraph(&tensors, {}, /*wait=*/false,
+                                /*sync_xla_data=*/true);
+    for (size_t i = 0; i < tensors.size(); ++i) {
+      // After the sync, the tensors hold device data, possibly the placeholders
+      // of the computations in flight (which Write() waits for), unless they
+      // live on the host only, in which case they get uploaded.
+      xla::ComputationClient::DataPtr xla_data = tensors[i].CurrentXlaData();
+      if (xla_data == nullptr) {
+        xla_data = tensors[i].GetXlaData();
+      }
+      XLA_CHECK(i == 0 || tensors[i].GetDevice() == device_)
+          << "The tensors of a checkpoint must live on the same device";
+      device_ = tensors[i].GetDevice();
+      const xla::Shape& shape = xla_data->shape();
+      CheckpointEntry entry;
+      entry.name = std::move(names[i]);
+      entry.element_type = shape.element_type();
+      entry.dimensions.assign(shape.dimensions().begin(),
+                              shape.dimensions().end());
+      entry.size = xla::ShapeUtil::ByteSizeOfElements(shape);
+      entries_.push_back(std::move(entry));
+      handles_.push_back(std::move(xla_data));
+    }
+    XLATensor::PinDeviceData(handles_);
+  }
+  XLA_COUNTER("CheckpointWrites", 1);
+  task_.Schedule();
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  try {
+    Wait();
+  } catch (const std::exception& ex) {
+    TF_LOG(ERROR) << "Failed to write checkpoint " << path_ << ": "
+                  << ex.what();
+  }
+}
+
+size_t CheckpointWriter::Wait() {
+  XLA_TIMED("CheckpointStallTime");
+  return task_.Wait().GetValue();
+}
+
+size_t CheckpointWriter::Write() {
+  static const size_t kWriteBufferSize = xla::sys_util::GetEnvInt(
+      "XLA_CHECKPOINT_WRITE_BUFFER_SIZE", 256 * 1024 * 1024);
+  XLA_TIMED("CheckpointWriteTime");
+  size_t num_unpinned = 0;
+  xla::util::ExceptionCleanup done_cleanup(
+      [&](xla::util::ExceptionCleanup::StatusType) {
+        XLATensor::UnpinDeviceData(
+            absl::MakeConstSpan(handles_).subspan(num_unpinned));
+        handles_.clear();
+        done_ = true;
+      });
+  // The device data captured by the constructor might still be computed by
+  // the step graph. The computations of the following steps do not need to
+  // complete.
+  XLATensor::WaitDeviceData(handles_);
+
+  std::string temp_path = path_ + ".tmp";
+  std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+  XLA_CHECK(file.good()) << "Failed to open " << temp_path;
+  // The header is written last, once the offsets are known. Its size only
+  // depends on the names and ranks of the tensors.
+  size_t header_size = SerializeCheckpointHeader(entries_).size();
+  file.seekp(header_size);
+  uint64_t offset = 0;
+  const char padding[kCheckpointAlignment] = {};
+  for (size_t begin = 0; begin < entries_.size();) {
+    size_t end = begin;
+    for (size_t chunk_size = 0;
+         end < entries_.size() &&
+         (end == begin || chunk_size + entries_[end].size <= kWriteBufferSize);
+         ++end) {
+      chunk_size += entries_[end].size;
+    }
+    std::vector<xla::Literal> literals =
+        xla::ComputationClient::TransferFromServer(
+            absl::MakeConstSpan(handles_).subspan(begin, end - begin));
+    XLATensor::UnpinDeviceData(
+        absl::MakeConstSpan(handles_).subspan(begin, end - begin));
+    num_unpinned = end;
+    for (size_t i = begin; i < end; ++i) {
+      xla::Literal& literal = literals[i - begin];
+      const xla::Shape& shape = literal.shape();
+      if (!xla::LayoutUtil::IsMonotonicWithDim0Major(shape.layout())) {
+        literal = literal.Relayout(
+            xla::LayoutUtil::GetDefaultLayoutForShape(shape));
+      }
+      CheckpointEntry& entry = entries_[i];
+      const char* data = static_cast<const char*>(literal.untyped_data());
+      std::string compressed;
+      if (compress_ &&
+          tensorflow::port::Snappy_Compress(data, entry.size, &compressed) &&
+          compressed.size() < entry.size) {
+        entry.compression = CheckpointCompression::kSnappy;
+        entry.stored_size = compressed.size();
+        data = compressed.data();
+      } else {
+        entry.stored_size = entry.size;
+      }
+      entry.offset = offset;
+      file.write(data, entry.stored_size);
+      uint64_t padded_size = RoundUp(entry.stored_size, kCheckpointAlignment);
+      file.write(padding, padded_size - entry.stored_size);
+      offset += padded_size;
+    }
+    XLA_COUNTER("CheckpointWriteChunks", 1);
+    begin = end;
+  }
+  std::string header = SerializeCheckpointHeader(entries_);
+  XLA_CHECK_EQ(header.size(), header_size);
+  file.seekp(0);
+  file.write(header.data(), header.size());
+  file.close();
+  XLA_CHECK(file.good()) << "Failed to write " << temp_path;
+  XLA_CHECK_EQ(std::rename(temp_path.c_str(), path_.c_str()), 0)
+      << "Failed to rename " << temp_path << " to " << path_;
+  return header_size + offset;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/async_task.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/platform/file_system.h"
+
+namespace swift_xla {
+
+// The X10 checkpoint files hold a set of named dense tensors, laid out so that
+// they can be memory mapped and uploaded without intermediate copies:
+//
+//   "X10CKPT1"                       8 bytes magic
+//   index_size                       uint64
+//   index                            index_size bytes
+//   padding                          up to a multiple of kCheckpointAlignment
+//   data                             the tensors content
+//
+// The index is a uint64 entries count, followed by the entries, each made of
+// the uint32 name size, the name, the int32 xla::PrimitiveType of the
+// elements, the uint32 rank, the int64 dimensions, the uint64 offset (from the
+// start of the data section, aligned to kCheckpointAlignment) and size of its
+// content, the uint32 CheckpointCompression of the content and the uint64 size
+// it takes in the file. The content is dense, in row-major order. All the
+// integers are little-endian.
+constexpr size_t kCheckpointAlignment = 64;
+
+enum class CheckpointCompression : uint32_t {
+  kNone = 0,
+  kSnappy = 1,
+};
+
+struct CheckpointEntry {
+  std::string name;
+  xla::PrimitiveType element_type = xla::PrimitiveType::PRIMITIVE_TYPE_INVALID;
+  std::vector<int64_t> dimensions;
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  CheckpointCompression compression = CheckpointCompression::kNone;
+  uint64_t stored_size = 0;
+};
+
+// Returns the checkpoint header (magic, index size, index and padding) for the
+// given entries. Its size does not depend on the offsets and sizes of the
+// entries.
+std::string SerializeCheckpointHeader(
+    absl::Span<const CheckpointEntry> entries);
+
+// Returns the offset of the data section of the checkpoint whose header is
+// serialized in the given buffer.
+uint64_t ParseCheckpointHeader(const char* data, size_t size,
+                               std::vector<CheckpointEntry>* entries);
+
+// Loads the tensors of an X10 checkpoint onto a device, straight out of the
+// memory mapped file (the compressed tensors are decompressed in chunk sized
+// host buffers). The tensors are grouped in chunks of about
+// XLA_CHECKPOINT_CHUNK_SIZE bytes (256MB by default) uploaded on the IO thread
+// pool, with at most XLA_CHECKPOINT_CHUNKS_IN_FLIGHT chunks (2 by default)
+// being transferred at any time. The pages of the uploaded chunks are released
+// right away, so the peak host memory usage depends on the chunk size (and on
+// the largest tensor), and not on the size of the checkpoint.
+class CheckpointLoader {
+ public:
+  // Maps the checkpoint file at path, and parses its index.
+  explicit CheckpointLoader(const std::string& path);
+
+  const std::vector<CheckpointEntry>& entries() const { return entries_; }
+
+  // Uploads all the tensors of the checkpoint to the device, and returns them
+  // in the order of entries().
+  std::vector<XLATensor> Load(const Device& device);
+
+ private:
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+  std::vector<CheckpointEntry> entries_;
+  uint64_t data_offset_ = 0;
+};
+
+// Writes an X10 checkpoint of device tensors in the background, while the
+// training goes on. The device data of the tensors is captured when the writer
+// is created (ideally right after a MarkStep, once the step graph has been
+// synced), and since device data is immutable, no copy is made. The captured
+// buffers are pinned, so they are not donated to the computations of the
+// following steps until they have been fetched.
+//
+// The tensors are fetched from the device and written on the IO thread pool,
+// in chunks of at most XLA_CHECKPOINT_WRITE_BUFFER_SIZE bytes of host memory
+// (256MB by default, or a single tensor if larger), optionally compressed with
+// Snappy. The checkpoint is written next to path, and renamed to path once
+// complete. The time the training thread spends capturing the tensors, and
+// waiting for the completion, is reported by the CheckpointStallTime metric.
+class CheckpointWriter {
+ public:
+  // All the tensors must live on the same device.
+  CheckpointWriter(std::string path, std::vector<std::string> names,
+                   std::vector<XLATensor> tensors, bool compress);
+
+  // Waits for the checkpoint to be written. Errors are logged.
+  ~CheckpointWriter();
+
+  // Returns whether the checkpoint has been written, or failed to.
+  bool IsDone() const { return done_; }
+
+  // Waits for the checkpoint to be written, and returns its size in bytes. The
+  // errors hit while writing it are rethrown here.
+  size_t Wait();
+
+ private:
+  size_t Write();
+
+  std::string path_;
+  Device device_;
+  std::vector<CheckpointEntry> entries_;
+  std::vector<xla::ComputationClient::DataPtr> handles_;
+  bool compress_ = false;
+  std::atomic<bool> done_;
+  xla::util::AsyncTask<size_t> task_;
+};
+
+}  // namespace swift_xla
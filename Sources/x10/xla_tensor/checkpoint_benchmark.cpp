@@ -0,0 +1,148 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the time and the peak host memory taken to load a synthetic X10
+// checkpoint onto the default device, either through the CheckpointLoader
+// ("mmap"), or by reading every tensor into an owned host buffer and uploading
+// them all, the way copyTensor() does ("copy"). The peak resident set size is
+// a process high-water mark, so each mode has to run in its own process.
+// Usage: checkpoint_benchmark mmap|copy [SIZE_MB] [PATH]
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+namespace {
+
+// Size of the tensors of the synthetic checkpoint.
+constexpr size_t kTensorBytes = 16 << 20;
+
+// Writes a checkpoint of size_mb megabytes of float tensors, streaming the data
+// so that the writer itself does not inflate the resident set size.
+std::vector<CheckpointEntry> WriteCheckpoint(const std::string& path,
+                                             size_t size_mb) {
+  std::vector<CheckpointEntry> entries;
+  uint64_t offset = 0;
+  for (size_t i = 0; i < (size_mb << 20) / kTensorBytes; ++i) {
+    CheckpointEntry entry;
+    entry.name = "weight_" + std::to_string(i);
+    entry.element_type = xla::PrimitiveType::F32;
+    entry.dimensions = {static_cast<int64_t>(kTensorBytes / sizeof(float))};
+    entry.offset = offset;
+    entry.size = kTensorBytes;
+    entry.stored_size = kTensorBytes;
+    offset += kTensorBytes;
+    entries.push_back(std::move(entry));
+  }
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  std::string header = SerializeCheckpointHeader(entries);
+  file.write(header.data(), header.size());
+  std::vector<float> block(1 << 18);
+  for (size_t i = 0; i < block.size(); ++i) {
+    block[i] = static_cast<float>(i);
+  }
+  for (uint64_t written = 0; written < offset;
+       written += block.size() * sizeof(float)) {
+    file.write(reinterpret_cast<const char*>(block.data()),
+               block.size() * sizeof(float));
+  }
+  XLA_CHECK(file.good()) << "Failed to write " << path;
+  return entries;
+}
+
+// The baseline: every tensor is read into its own host buffer, and all of
+// them are uploaded at once.
+size_t LoadByCopy(const std::string& path, const Device& device) {
+  std::ifstream file(path, std::ios::binary);
+  std::string header(1 << 20, '\0');
+  file.read(&header[0], header.size());
+  std::vector<CheckpointEntry> entries;
+  uint64_t data_offset =
+      ParseCheckpointHeader(header.data(), file.gcount(), &entries);
+  file.clear();
+  std::vector<at::Tensor> tensors;
+  for (const CheckpointEntry& entry : entries) {
+    size_t num_elements = entry.size / sizeof(float);
+    std::unique_ptr<float[]> values(new float[num_elements]);
+    file.seekg(data_offset + entry.offset);
+    file.read(reinterpret_cast<char*>(values.get()), entry.size);
+    tensors.emplace_back(std::move(values), entry.dimensions);
+  }
+  return CreateTensorsData(tensors, device.ToString()).size();
+}
+
+size_t LoadByMmap(const std::string& path, const Device& device) {
+  CheckpointLoader loader(path);
+  return loader.Load(device).size();
+}
+
+// Returns the peak resident set size of the process, in MB, or -1 where it
+// cannot be read.
+double PeakRssMb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::strtod(line.c_str() + 6, nullptr) / 1024.0;
+    }
+  }
+  return -1;
+}
+
+void RunBenchmark(bool use_mmap, size_t size_mb, const std::string& path) {
+  const Device& device = *GetDefaultDevice();
+  std::vector<CheckpointEntry> entries = WriteCheckpoint(path, size_mb);
+  double start_rss = PeakRssMb();
+  auto start = std::chrono::steady_clock::now();
+  size_t num_tensors =
+      use_mmap ? LoadByMmap(path, device) : LoadByCopy(path, device);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  XLA_CHECK_EQ(num_tensors, entries.size());
+  std::printf("%s: loaded %zu MB (%zu tensors) in %.3f s, %.1f MB/s\n",
+              use_mmap ? "mmap" : "copy", size_mb, num_tensors,
+              elapsed.count(), size_mb / elapsed.count());
+  std::printf("peak RSS: %.1f MB (%.1f MB before loading)\n", PeakRssMb(),
+              start_rss);
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  bool valid = argc > 1 && (std::strcmp(argv[1], "mmap") == 0 ||
+                            std::strcmp(argv[1], "copy") == 0);
+  int size_mb = 1024;
+  if (!valid || (argc > 2 && (!absl::SimpleAtoi(argv[2], &size_mb) ||
+                              size_mb < 16))) {
+    std::fprintf(stderr, "Usage: %s mmap|copy [SIZE_MB] [PATH]\n", argv[0]);
+    return 1;
+  }
+  std::string path = argc > 3 ? argv[3] : "/tmp/x10_checkpoint_benchmark.ckpt";
+  swift_xla::RunBenchmark(std::strcmp(argv[1], "mmap") == 0, size_mb, path);
+  return 0;
+}
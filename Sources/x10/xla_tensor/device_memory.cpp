@@ -0,0 +1,45 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/device_memory.h"
+
+#include <sstream>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace swift_xla {
+
+const char* const kHostDataOrigin = "(host data)";
+const char* const kPendingGraphOrigin = "(pending graph)";
+const char* const kUntrackedOrigin = "(untracked)";
+
+std::string DeviceMemorySnapshotsToString(
+    absl::Span<const DeviceMemorySnapshot> snapshots) {
+  std::stringstream ss;
+  for (auto& snapshot : snapshots) {
+    ss << "Device " << snapshot.device << ": live="
+       << xla::metrics::MetricFnBytes(snapshot.live_bytes)
+       << " peak=" << xla::metrics::MetricFnBytes(snapshot.peak_bytes)
+       << " last_step_peak="
+       << xla::metrics::MetricFnBytes(snapshot.last_step_peak_bytes) << "\n";
+    for (auto& usage : snapshot.usages) {
+      ss << "  " << xla::metrics::MetricFnBytes(usage.bytes) << " in "
+         << usage.buffers << " buffers: "
+         << (usage.origin.empty() ? "(no scope)" : usage.origin) << "\n";
+    }
+  }
+  return ss.str();
+}
+
+}  // namespace swift_xla
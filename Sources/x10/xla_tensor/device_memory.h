@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// The device memory held by the buffers sharing the same origin, which is the
+// IR scope (and the Swift frame, with XLA_LOG_GRAPH_CHANGES) of the graph which
+// computed them, or one of the special origins below.
+struct DeviceMemoryUsage {
+  std::string origin;
+  int64_t bytes = 0;
+  size_t buffers = 0;
+};
+
+// Origin of the buffers uploaded from host data.
+extern const char* const kHostDataOrigin;
+// Origin of the buffers only referenced by pending IR graphs.
+extern const char* const kPendingGraphOrigin;
+// Origin of the live buffers which are not referenced by any live tensor, like
+// the ones held by in flight computations or by the device data caches.
+extern const char* const kUntrackedOrigin;
+
+struct DeviceMemorySnapshot {
+  Device device;
+  // The bytes held by all the live buffers of the device.
+  int64_t live_bytes = 0;
+  // The high-water mark of live_bytes within the current step, and within the
+  // previous one.
+  int64_t peak_bytes = 0;
+  int64_t last_step_peak_bytes = 0;
+  // Sorted by decreasing bytes.
+  std::vector<DeviceMemoryUsage> usages;
+};
+
+std::string DeviceMemorySnapshotsToString(
+    absl::Span<const DeviceMemorySnapshot> snapshots);
+
+}  // namespace swift_xla
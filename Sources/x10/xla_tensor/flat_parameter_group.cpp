@@ -0,0 +1,78 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/flat_parameter_group.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+FlatParameterGroup::FlatParameterGroup(absl::Span<const XLATensor> tensors) {
+  XLA_CHECK(!tensors.empty()) << "A flat parameter group cannot be empty";
+  const Device& device = tensors.front().GetDevice();
+  element_type_ = tensors.front().shape().get().element_type();
+  dimensions_.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    xla::util::MaybeRef<xla::Shape> shape = tensor.shape();
+    XLA_CHECK(shape.get().is_static()) << shape.get();
+    XLA_CHECK_EQ(shape.get().element_type(), element_type_) << shape.get();
+    XLA_CHECK_EQ(tensor.GetDevice(), device);
+    dimensions_.push_back(
+        xla::util::ToVector<int64_t>(shape.get().dimensions()));
+    num_elements_ += xla::ShapeUtil::ElementsIn(shape.get());
+  }
+  buffer_ = XLATensor::flat_pack(tensors);
+  XLA_COUNTER("FlatParameterGroupTensors", tensors.size());
+}
+
+void FlatParameterGroup::set_buffer(XLATensor buffer) {
+  CheckLayout(buffer);
+  buffer_ = std::move(buffer);
+}
+
+XLATensor FlatParameterGroup::Pack(absl::Span<const XLATensor> tensors) const {
+  XLA_CHECK_EQ(tensors.size(), dimensions_.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    xla::util::MaybeRef<xla::Shape> shape = tensors[i].shape();
+    XLA_CHECK(xla::util::ToVector<int64_t>(shape.get().dimensions()) ==
+              dimensions_[i])
+        << "Tensor " << i << " has shape " << shape.get()
+        << ", while the group expects ("
+        << absl::StrJoin(dimensions_[i], ", ") << ")";
+  }
+  XLATensor flat = XLATensor::flat_pack(tensors);
+  CheckLayout(flat);
+  return flat;
+}
+
+std::vector<XLATensor> FlatParameterGroup::Unpack(
+    const XLATensor& flat) const {
+  CheckLayout(flat);
+  return XLATensor::flat_unpack(flat, dimensions_);
+}
+
+void FlatParameterGroup::CheckLayout(const XLATensor& flat) const {
+  xla::util::MaybeRef<xla::Shape> shape = flat.shape();
+  XLA_CHECK(xla::ShapeUtil::Equal(
+      shape.get(), xla::ShapeUtil::MakeShape(element_type_, {num_elements_})))
+      << "The buffer of the group must be a vector of " << num_elements_
+      << " elements of " << xla::PrimitiveType_Name(element_type_)
+      << ", got " << shape.get();
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+
+namespace swift_xla {
+
+// Stores a group of parameters sharing their element type and device in a
+// single flat device buffer, so that a step graph takes one parameter (and the
+// runtime handles one buffer) for the whole group, instead of one per tensor.
+// The logical tensors are views of the buffer, sliced out of it by a single
+// FlatUnpack node, and the updated tensors (or their gradients) are packed back
+// with the same layout. An optimizer can then update the whole group at once,
+// and the gradients can be all-reduced as a single tensor.
+//
+// The views returned by Unpack() should not outlive the step: the ones still
+// alive at the step barrier get synced as buffers of their own.
+class FlatParameterGroup {
+ public:
+  // Packs the given tensors, which must have static shapes, into the buffer.
+  explicit FlatParameterGroup(absl::Span<const XLATensor> tensors);
+
+  // Returns the number of tensors of the group.
+  size_t size() const { return dimensions_.size(); }
+
+  const std::vector<std::vector<int64_t>>& dimensions() const {
+    return dimensions_;
+  }
+
+  const XLATensor& buffer() const { return buffer_; }
+
+  // Replaces the buffer, which must have the layout of the group (for example
+  // the result of an optimizer update of the buffer, or of Pack()).
+  void set_buffer(XLATensor buffer);
+
+  // Packs tensors with the shapes of the group, in the group layout.
+  XLATensor Pack(absl::Span<const XLATensor> tensors) const;
+
+  // Returns the views of the logical tensors of the group within flat, which
+  // has the group layout.
+  std::vector<XLATensor> Unpack(const XLATensor& flat) const;
+
+  std::vector<XLATensor> Unpack() const { return Unpack(buffer_); }
+
+ private:
+  void CheckLayout(const XLATensor& flat) const;
+
+  std::vector<std::vector<int64_t>> dimensions_;
+  xla::PrimitiveType element_type_ = xla::PrimitiveType::PRIMITIVE_TYPE_INVALID;
+  int64_t num_elements_ = 0;
+  XLATensor buffer_;
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,309 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_partitioner.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+
+namespace swift_xla {
+namespace {
+
+const char* RoleName(GraphPartitioner::Role role) {
+  switch (role) {
+    case GraphPartitioner::Role::kWhole:
+      return "Whole";
+    case GraphPartitioner::Role::kPrefix:
+      return "Prefix";
+    case GraphPartitioner::Role::kVolatile:
+      return "Volatile";
+    case GraphPartitioner::Role::kSuffix:
+      return "Suffix";
+  }
+  return "Unknown";
+}
+
+size_t TraceIndex(size_t size, size_t depth, bool reversed) {
+  return reversed ? size - 1 - depth : depth;
+}
+
+size_t GetHistory() {
+  static const size_t history =
+      xla::sys_util::GetEnvInt("XLA_GRAPH_PARTITION_HISTORY", 16);
+  return history;
+}
+
+std::atomic<bool>* GraphPartitioningEnabled() {
+  static std::atomic<bool>* enabled =
+      new std::atomic<bool>(xla::sys_util::GetEnvBool(
+          "XLA_GRAPH_PARTITION",
+          xla::sys_util::GetEnvBool("XLA_TRACELETS", false)));
+  return enabled;
+}
+
+}  // namespace
+
+GraphPartitioner* GraphPartitioner::Get() {
+  static GraphPartitioner* partitioner = new GraphPartitioner();
+  return GraphPartitioningEnabled()->load() ? partitioner : nullptr;
+}
+
+void GraphPartitioner::SetEnabled(bool enabled) {
+  GraphPartitioningEnabled()->store(enabled);
+}
+
+GraphPartitioner::GraphPartitioner() {
+  for (Role role : {Role::kWhole, Role::kPrefix, Role::kVolatile,
+                    Role::kSuffix}) {
+    std::string name = absl::StrCat("Partition", RoleName(role));
+    RoleCounters counters;
+    counters.hits = std::make_unique<xla::metrics::Counter>(
+        absl::StrCat(name, "CacheHits"));
+    counters.misses = std::make_unique<xla::metrics::Counter>(
+        absl::StrCat(name, "CacheMisses"));
+    role_counters_.push_back(std::move(counters));
+  }
+  PublishCuts();
+}
+
+absl::optional<GraphPartitioner::Role> GraphPartitioner::FindCut(
+    const xla::hash_t& hash) {
+  std::shared_ptr<const CutSnapshot> snapshot =
+      std::atomic_load(&cuts_snapshot_);
+  auto it = snapshot->cuts.find(hash);
+  if (it == snapshot->cuts.end()) {
+    return absl::nullopt;
+  }
+  Cut* cut = it->second.get();
+  cut->last_step = snapshot->step;
+  if (cut->role == Role::kPrefix) {
+    prefix_cut_in_step_ = true;
+  } else {
+    suffix_cut_in_step_ = true;
+  }
+  return cut->role;
+}
+
+void GraphPartitioner::SetCutRole(absl::optional<Role> role) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cut_role_ = role;
+}
+
+void GraphPartitioner::MarkStep() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  prefix_cut_in_step_ = false;
+  suffix_cut_in_step_ = false;
+  step_ += 1;
+  // Drop the cut points which no graph of the recent steps went through, like
+  // the graphs dropped out of the history, so that models whose graphs keep
+  // changing do not accumulate them.
+  int64_t history = GetHistory();
+  for (auto it = cuts_.begin(); it != cuts_.end();) {
+    if (step_ - it->second->last_step > history) {
+      XLA_COUNTER("PartitionCutPointsPruned", 1);
+      cuts_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  PublishCuts();
+}
+
+void GraphPartitioner::PublishCuts() {
+  auto snapshot = std::make_shared<CutSnapshot>();
+  snapshot->step = step_;
+  snapshot->cuts = cuts_;
+  std::atomic_store(&cuts_snapshot_,
+                    std::shared_ptr<const CutSnapshot>(std::move(snapshot)));
+}
+
+GraphPartitioner::Role GraphPartitioner::CurrentRole() const {
+  if (cut_role_) {
+    return *cut_role_;
+  }
+  if (suffix_cut_in_step_) {
+    return Role::kSuffix;
+  }
+  return prefix_cut_in_step_ ? Role::kVolatile : Role::kWhole;
+}
+
+void GraphPartitioner::RecordSync(absl::Span<const ir::Node* const> post_order,
+                                  bool cache_hit) {
+  static const int64_t warmup_steps =
+      xla::sys_util::GetEnvInt("XLA_GRAPH_PARTITION_WARMUP_STEPS", 2);
+  static const size_t min_nodes =
+      xla::sys_util::GetEnvInt("XLA_GRAPH_PARTITION_MIN_NODES", 32);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Role role = CurrentRole();
+  const RoleCounters& counters = role_counters_[static_cast<size_t>(role)];
+  (cache_hit ? counters.hits : counters.misses)->AddValue(1);
+  TF_VLOG(3) << "Partition " << RoleName(role) << " cache "
+             << (cache_hit ? "hit" : "miss") << ", hit rate "
+             << counters.hits->Value() << "/"
+             << counters.hits->Value() + counters.misses->Value();
+
+  xla::metrics::CounterData* mark_step = xla::metrics::GetCounter("MarkStep");
+  int64_t steps = mark_step != nullptr ? mark_step->Value() : 0;
+  if (cache_hit || steps < warmup_steps || post_order.empty()) {
+    return;
+  }
+  Trace trace;
+  for (const ir::Node* node : post_order) {
+    trace.local_hashes.push_back(
+        xla::util::MHash(node->node_hash(), xla::util::ShapeHash(node->shape()),
+                         node->operands().size()));
+    trace.hashes.push_back(node->hash());
+    trace.leaves.push_back(node->operands().empty());
+  }
+  size_t size = trace.hashes.size();
+  size_t num_cuts = cuts_.size();
+
+  absl::optional<size_t> prefix = Insert(trace, /*reversed=*/false,
+                                         &prefix_trie_);
+  if (prefix && *prefix >= min_nodes) {
+    // The prefix is closed by its last node, which needs to be the value of a
+    // tensor (leaves never are). The graphs this one diverges from share the
+    // structure of the prefix, but not necessarily the full hash of that node.
+    size_t position = *prefix - 1;
+    while (position > 0 && trace.leaves[position]) {
+      --position;
+    }
+    if (!trace.leaves[position]) {
+      AddCut(trace.hashes[position], Role::kPrefix);
+      AddCut(Find(trace, /*reversed=*/false, position + 1, &prefix_trie_)
+                 ->node_hash,
+             Role::kPrefix);
+    }
+  }
+
+  absl::optional<size_t> suffix = Insert(trace, /*reversed=*/true,
+                                         &suffix_trie_);
+  if (suffix && *suffix >= min_nodes) {
+    // The suffix is opened by closing the volatile region at the node right
+    // before it, in this graph and in the graphs this one diverges from.
+    if (*suffix < size) {
+      AddCut(trace, size - *suffix - 1, Role::kVolatile);
+    }
+    const TrieNode* node =
+        Find(trace, /*reversed=*/true, *suffix, &suffix_trie_);
+    for (auto& local_hash_child : node->children) {
+      const TrieNode* child = local_hash_child.second.get();
+      if (!child->leaf) {
+        AddCut(child->node_hash, Role::kVolatile);
+      }
+    }
+  }
+
+  if (cuts_.size() != num_cuts) {
+    PublishCuts();
+  }
+  traces_.push_back(std::move(trace));
+  if (traces_.size() > GetHistory()) {
+    Remove(traces_.front(), /*reversed=*/false, &prefix_trie_);
+    Remove(traces_.front(), /*reversed=*/true, &suffix_trie_);
+    traces_.pop_front();
+  }
+}
+
+absl::optional<size_t> GraphPartitioner::Insert(const Trace& trace,
+                                                bool reversed, TrieNode* root) {
+  size_t size = trace.local_hashes.size();
+  absl::optional<size_t> divergence;
+  TrieNode* node = root;
+  for (size_t depth = 0; depth < size; ++depth) {
+    size_t index = TraceIndex(size, depth, reversed);
+    bool seen = node->count > 0;
+    node->count += 1;
+    auto it = node->children.find(trace.local_hashes[index]);
+    if (!divergence && seen && (node->ends > 0 || it == node->children.end())) {
+      divergence = depth;
+    }
+    if (it == node->children.end()) {
+      auto child = std::make_unique<TrieNode>();
+      child->node_hash = trace.hashes[index];
+      child->leaf = trace.leaves[index];
+      it = node->children.emplace(trace.local_hashes[index], std::move(child))
+               .first;
+    }
+    node = it->second.get();
+  }
+  // This graph ending where the other ones continue is a divergence as well.
+  if (!divergence && node->count > 0 && !node->children.empty()) {
+    divergence = size;
+  }
+  node->count += 1;
+  node->ends += 1;
+  return divergence;
+}
+
+void GraphPartitioner::Remove(const Trace& trace, bool reversed,
+                              TrieNode* root) {
+  size_t size = trace.local_hashes.size();
+  TrieNode* node = root;
+  node->count -= 1;
+  for (size_t depth = 0; depth < size; ++depth) {
+    auto it = node->children.find(
+        trace.local_hashes[TraceIndex(size, depth, reversed)]);
+    XLA_CHECK(it != node->children.end());
+    TrieNode* child = it->second.get();
+    child->count -= 1;
+    if (child->count == 0) {
+      // The rest of the path only belonged to the removed graph.
+      node->children.erase(it);
+      return;
+    }
+    node = child;
+  }
+  node->ends -= 1;
+}
+
+const GraphPartitioner::TrieNode* GraphPartitioner::Find(
+    const Trace& trace, bool reversed, size_t length, const TrieNode* root) {
+  size_t size = trace.local_hashes.size();
+  const TrieNode* node = root;
+  for (size_t depth = 0; depth < length; ++depth) {
+    auto it = node->children.find(
+        trace.local_hashes[TraceIndex(size, depth, reversed)]);
+    XLA_CHECK(it != node->children.end());
+    node = it->second.get();
+  }
+  return node;
+}
+
+void GraphPartitioner::AddCut(const Trace& trace, size_t position, Role role) {
+  while (position > 0 && trace.leaves[position]) {
+    --position;
+  }
+  if (!trace.leaves[position]) {
+    AddCut(trace.hashes[position], role);
+  }
+}
+
+void GraphPartitioner::AddCut(const xla::hash_t& hash, Role role) {
+  auto it_inserted = cuts_.emplace(hash, nullptr);
+  if (it_inserted.second) {
+    it_inserted.first->second = std::make_shared<Cut>(role, step_);
+    XLA_COUNTER("PartitionCutPoints", 1);
+    TF_VLOG(3) << "New " << RoleName(role) << " partition cut point "
+               << xla::util::HexHash(hash);
+  } else {
+    it_inserted.first->second->last_step = step_;
+  }
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+// Splits the step graphs of models with data dependent control flow, so that
+// the regions shared by all the variants of the graph get compiled (and
+// cached) once, and only the regions which change from step to step get
+// recompiled.
+//
+// The post-orders of the recently compiled graphs are kept in two tries of
+// structural node hashes, one walked from the first node and one from the last
+// one. When a new graph diverges from a known one after a long enough common
+// prefix, or before a long enough common suffix, the nodes at the boundary
+// become cut points. During tracing, the assignment of a cut point node to a
+// tensor syncs the live tensors, which closes the current partition of the
+// step graph.
+//
+// Enabled by XLA_GRAPH_PARTITION (or the legacy XLA_TRACELETS). Boundaries are
+// only considered for common regions of at least XLA_GRAPH_PARTITION_MIN_NODES
+// nodes (32 by default), among the last XLA_GRAPH_PARTITION_HISTORY compiled
+// graphs (16 by default), and after the first XLA_GRAPH_PARTITION_WARMUP_STEPS
+// steps (2 by default). The cut points which were not hit during the last
+// XLA_GRAPH_PARTITION_HISTORY steps are dropped. The per-partition cache hits
+// and misses are reported by the Partition*CacheHits and
+// Partition*CacheMisses counters.
+//
+// The cut points are looked up at every assignment of an IR value to a tensor,
+// so the lookups read an immutable snapshot of them, republished whenever cut
+// points are found or dropped, and do not take the partitioner lock.
+class GraphPartitioner {
+ public:
+  // The role of a partition within a step graph.
+  enum class Role {
+    // A step graph which has not been partitioned.
+    kWhole,
+    // The stable region at the start of a step graph.
+    kPrefix,
+    // The region between the prefix and the suffix, which changes between the
+    // variants of the step graph.
+    kVolatile,
+    // The stable region at the end of a step graph.
+    kSuffix,
+  };
+
+  // Returns the partitioner, or nullptr if the partitioning is disabled.
+  static GraphPartitioner* Get();
+
+  // Enables or disables the partitioning, overriding XLA_GRAPH_PARTITION.
+  static void SetEnabled(bool enabled);
+
+  // If assigning the node with the given hash to a tensor should cut the step
+  // graph, returns the role of the partition which the cut closes.
+  absl::optional<Role> FindCut(const xla::hash_t& hash);
+
+  // Overrides the role of the partitions synced until the next call, which
+  // resets it with nullopt.
+  void SetCutRole(absl::optional<Role> role);
+
+  // Records the sync of the graph with the given post-order. The graphs which
+  // were not found in the computation cache are added to the tries, and looked
+  // for new cut points.
+  void RecordSync(absl::Span<const ir::Node* const> post_order, bool cache_hit);
+
+  // Resets the per-step state, and drops the stale cut points, at the end of a
+  // step.
+  void MarkStep();
+
+ private:
+  struct TrieNode {
+    size_t count = 0;
+    // Number of graphs ending at this node.
+    size_t ends = 0;
+    // The full hash of the graph node at this position, in the first graph
+    // which went through it, and whether that is a leaf.
+    xla::hash_t node_hash;
+    bool leaf = false;
+    absl::flat_hash_map<xla::hash_t, std::unique_ptr<TrieNode>,
+                        xla::util::HashReducer>
+        children;
+  };
+
+  struct Trace {
+    std::vector<xla::hash_t> local_hashes;
+    std::vector<xla::hash_t> hashes;
+    std::vector<bool> leaves;
+  };
+
+  struct Cut {
+    Cut(Role role, int64_t last_step) : role(role), last_step(last_step) {}
+
+    const Role role;
+    // The last step in which the cut point was hit or found again.
+    std::atomic<int64_t> last_step;
+  };
+
+  using CutMap =
+      absl::flat_hash_map<xla::hash_t, std::shared_ptr<Cut>,
+                          xla::util::HashReducer>;
+
+  struct CutSnapshot {
+    int64_t step = 0;
+    CutMap cuts;
+  };
+
+  struct RoleCounters {
+    std::unique_ptr<xla::metrics::Counter> hits;
+    std::unique_ptr<xla::metrics::Counter> misses;
+  };
+
+  GraphPartitioner();
+
+  // Adds the trace to the trie, walked in reverse order if reversed is true,
+  // and returns the length of the region the trace shares with the other ones
+  // before diverging (if it does).
+  static absl::optional<size_t> Insert(const Trace& trace, bool reversed,
+                                       TrieNode* root);
+
+  static void Remove(const Trace& trace, bool reversed, TrieNode* root);
+
+  static const TrieNode* Find(const Trace& trace, bool reversed, size_t length,
+                              const TrieNode* root);
+
+  // Adds the cut point at the given position of the trace, moving backward to
+  // the first non leaf node.
+  void AddCut(const Trace& trace, size_t position, Role role);
+
+  void AddCut(const xla::hash_t& hash, Role role);
+
+  Role CurrentRole() const;
+
+  // Publishes the current cut points to FindCut(). Called with the lock held.
+  void PublishCuts();
+
+  std::mutex mutex_;
+  TrieNode prefix_trie_;
+  TrieNode suffix_trie_;
+  std::deque<Trace> traces_;
+  CutMap cuts_;
+  // Read with std::atomic_load() by FindCut(), which does not take the lock.
+  std::shared_ptr<const CutSnapshot> cuts_snapshot_;
+  absl::optional<Role> cut_role_;
+  std::atomic<bool> prefix_cut_in_step_{false};
+  std::atomic<bool> suffix_cut_in_step_{false};
+  int64_t step_ = 0;
+  std::vector<RoleCounters> role_counters_;
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,177 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+std::atomic<bool>* GraphProfilingEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_GRAPH_PROFILE", false));
+  return enabled;
+}
+
+// Returns the distinct origins of the root nodes, in the format of the device
+// memory origins.
+std::string GetRootsOrigin(absl::Span<const ir::Value> roots) {
+  std::vector<std::string> origins;
+  absl::flat_hash_set<std::string> seen;
+  for (auto& root : roots) {
+    const ir::MetaData& metadata = root.node->metadata();
+    std::string origin = metadata.scope;
+    if (!metadata.frame_info.empty()) {
+      absl::StrAppend(&origin, "@", metadata.frame_info.front().function);
+    }
+    if (!origin.empty() && seen.insert(origin).second) {
+      origins.push_back(std::move(origin));
+    }
+  }
+  return absl::StrJoin(origins, ", ");
+}
+
+}  // namespace
+
+GraphProfiler* GraphProfiler::Get() {
+  static GraphProfiler* profiler = new GraphProfiler();
+  return GraphProfilingEnabled()->load() ? profiler : nullptr;
+}
+
+void GraphProfiler::SetEnabled(bool enabled) {
+  GraphProfilingEnabled()->store(enabled);
+}
+
+void GraphProfiler::RecordCompile(const xla::hash_t& hash,
+                                  absl::Span<const ir::Value> roots,
+                                  size_t nodes, int64_t compile_time) {
+  std::string origin = GetRootsOrigin(roots);
+  std::lock_guard<std::mutex> lock(mutex_);
+  GraphProfile* profile = GetProfile(hash);
+  if (profile != nullptr) {
+    profile->origin = std::move(origin);
+    profile->nodes = nodes;
+    profile->compilations += 1;
+    profile->compile_time += compile_time;
+  }
+}
+
+void GraphProfiler::RecordExecute(const xla::hash_t& hash,
+                                  int64_t execute_time, int64_t input_bytes,
+                                  int64_t output_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  total_execute_time_ += execute_time;
+  GraphProfile* profile = GetProfile(hash);
+  if (profile != nullptr) {
+    profile->executions += 1;
+    profile->execute_time += execute_time;
+    profile->max_execute_time =
+        std::max(profile->max_execute_time, execute_time);
+    profile->input_bytes = input_bytes;
+    profile->output_bytes = output_bytes;
+  }
+}
+
+std::vector<GraphProfile> GraphProfiler::GetTopProfiles(size_t k) {
+  std::vector<GraphProfile> profiles;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    profiles.reserve(profiles_.size());
+    for (auto& hash_profile : profiles_) {
+      profiles.push_back(hash_profile.second);
+    }
+  }
+  auto by_execute_time = [](const GraphProfile& a, const GraphProfile& b) {
+    return a.execute_time > b.execute_time;
+  };
+  if (k > 0 && k < profiles.size()) {
+    std::partial_sort(profiles.begin(), profiles.begin() + k, profiles.end(),
+                      by_execute_time);
+    profiles.resize(k);
+  } else {
+    std::sort(profiles.begin(), profiles.end(), by_execute_time);
+  }
+  return profiles;
+}
+
+std::string GraphProfiler::CreateReport(size_t k) {
+  int64_t total_execute_time = 0;
+  size_t num_graphs = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_execute_time = total_execute_time_;
+    num_graphs = profiles_.size();
+  }
+  std::vector<GraphProfile> profiles = GetTopProfiles(k);
+  std::stringstream ss;
+  ss << "Graphs: " << num_graphs << ", total execution time "
+     << xla::metrics::MetricFnTime(total_execute_time) << "\n";
+  for (auto& profile : profiles) {
+    double share = total_execute_time > 0
+                       ? 100.0 * profile.execute_time / total_execute_time
+                       : 0.0;
+    int64_t mean_execute_time =
+        profile.executions > 0 ? profile.execute_time / profile.executions : 0;
+    ss << "Graph " << xla::util::HexHash(profile.hash) << ": "
+       << absl::StrFormat("%.1f", share) << "% of the execution time\n"
+       << "  executions=" << profile.executions
+       << " total=" << xla::metrics::MetricFnTime(profile.execute_time)
+       << " mean=" << xla::metrics::MetricFnTime(mean_execute_time)
+       << " max=" << xla::metrics::MetricFnTime(profile.max_execute_time)
+       << "\n"
+       << "  compilations=" << profile.compilations
+       << " compile_time=" << xla::metrics::MetricFnTime(profile.compile_time)
+       << " nodes=" << profile.nodes
+       << " inputs=" << xla::metrics::MetricFnBytes(profile.input_bytes)
+       << " outputs=" << xla::metrics::MetricFnBytes(profile.output_bytes)
+       << "\n"
+       << "  origin: "
+       << (profile.origin.empty() ? "(no scope)" : profile.origin) << "\n";
+  }
+  return ss.str();
+}
+
+void GraphProfiler::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  profiles_.clear();
+  total_execute_time_ = 0;
+}
+
+GraphProfile* GraphProfiler::GetProfile(const xla::hash_t& hash) {
+  static const size_t max_graphs =
+      xla::sys_util::GetEnvInt("XLA_GRAPH_PROFILE_MAX_GRAPHS", 4096);
+  auto it = profiles_.find(hash);
+  if (it != profiles_.end()) {
+    return &it->second;
+  }
+  if (profiles_.size() >= max_graphs) {
+    XLA_COUNTER("GraphProfileDropped", 1);
+    return nullptr;
+  }
+  GraphProfile* profile = &profiles_[hash];
+  profile->hash = hash;
+  return profile;
+}
+
+}  // namespace swift_xla
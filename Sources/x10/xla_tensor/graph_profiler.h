@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+
+// The statistics of the executions of a cached computation, keyed by the hash
+// of the graph it was compiled from. The times are in nanoseconds.
+struct GraphProfile {
+  xla::hash_t hash;
+  // The IR scopes (and Swift frames, with XLA_LOG_GRAPH_CHANGES) of the roots
+  // of the graph, when it was compiled.
+  std::string origin;
+  size_t nodes = 0;
+  size_t compilations = 0;
+  int64_t compile_time = 0;
+  size_t executions = 0;
+  int64_t execute_time = 0;
+  int64_t max_execute_time = 0;
+  // The bytes of the parameters and of the results of the last execution.
+  int64_t input_bytes = 0;
+  int64_t output_bytes = 0;
+};
+
+// Records per-graph statistics of the computations, so that the graphs which
+// dominate the device time (and the model code they come from) can be found,
+// where the ExecuteTime metric aggregates all of them. The execution times are
+// the wall times of the computations on the IO thread pool, from launch to the
+// results being available.
+//
+// Enabled by XLA_GRAPH_PROFILE. At most XLA_GRAPH_PROFILE_MAX_GRAPHS graphs
+// (4096 by default) are tracked, the later ones being ignored.
+class GraphProfiler {
+ public:
+  // Returns the profiler, or nullptr if the profiling is disabled.
+  static GraphProfiler* Get();
+
+  // Enables or disables the profiling, overriding XLA_GRAPH_PROFILE. The
+  // statistics recorded so far are kept.
+  static void SetEnabled(bool enabled);
+
+  // Records the compilation of the graph with the given roots.
+  void RecordCompile(const xla::hash_t& hash, absl::Span<const ir::Value> roots,
+                     size_t nodes, int64_t compile_time);
+
+  void RecordExecute(const xla::hash_t& hash, int64_t execute_time,
+                     int64_t input_bytes, int64_t output_bytes);
+
+  // Returns the profiles of the k graphs which took the most execution time
+  // (all of them if k is zero), sorted by decreasing execution time.
+  std::vector<GraphProfile> GetTopProfiles(size_t k);
+
+  // Returns a report of the k graphs which took the most execution time, with
+  // their share of the total execution time of all the graphs.
+  std::string CreateReport(size_t k);
+
+  void Reset();
+
+ private:
+  GraphProfile* GetProfile(const xla::hash_t& hash);
+
+  std::mutex mutex_;
+  absl::flat_hash_map<xla::hash_t, GraphProfile, xla::util::HashReducer>
+      profiles_;
+  int64_t total_execute_time_ = 0;
+};
+
+}  // namespace swift_xla
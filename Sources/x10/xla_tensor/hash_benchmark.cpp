@@ -0,0 +1,129 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures the throughput of the data hash used for the tensor contents, and
+// the cost of hashing the same host tensor again once its hash is memoized.
+// Usage: hash_benchmark [ITERATIONS]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// The word at a time loop used by xla::util::HashBlock() before the striped
+// version, kept as the baseline.
+xla::hash_t ReferenceHash(const void* data, size_t n, const xla::hash_t& seed) {
+  const xla::hash_t m = 0xc6a4a7935bd1e995;
+  const int r = 47;
+
+  const uint8_t* u8_data = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* top = u8_data + n;
+  xla::hash_t h = seed ^ (n * m);
+  while (u8_data < top) {
+    size_t size = std::min<size_t>(top - u8_data, sizeof(xla::hash_t));
+    xla::hash_t k = 0;
+    std::memcpy(&k, u8_data, size);
+    u8_data += size;
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+
+    h ^= k;
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+template <typename F>
+double MeasureGBps(size_t size, int iterations, const F& fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return static_cast<double>(size) * iterations / elapsed.count() / 1e9;
+}
+
+void RunBenchmarks(int iterations) {
+  // Keeps the hashes alive, so that the loops cannot be optimized away.
+  xla::hash_t sink = 0;
+  std::printf("%12s %14s %14s\n", "bytes", "reference GB/s", "DataHash GB/s");
+  for (size_t size : {64, 256, 4096, 65536, 1 << 20, 64 << 20}) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    // Scales the iterations down for the big sizes, to keep the runtime sane.
+    double scale = 4096.0 / std::max<size_t>(size, 4096);
+    int size_iterations =
+        std::max<int>(1, static_cast<int>(iterations * scale));
+    double reference = MeasureGBps(size, size_iterations, [&]() {
+      sink ^= ReferenceHash(data.data(), data.size(), sink);
+    });
+    double striped = MeasureGBps(size, size_iterations, [&]() {
+      sink ^= xla::util::HashBlock(data.data(), data.size(), sink);
+    });
+    std::printf("%12zu %14.2f %14.2f\n", size, reference, striped);
+  }
+
+  size_t num_elements = 16 << 20;
+  std::unique_ptr<float[]> values(new float[num_elements]);
+  for (size_t i = 0; i < num_elements; ++i) {
+    values[i] = static_cast<float>(i);
+  }
+  at::Tensor tensor(std::move(values),
+                    {static_cast<int64_t>(num_elements)});
+  auto start = std::chrono::steady_clock::now();
+  sink ^= TensorHash(tensor);
+  std::chrono::duration<double> first =
+      std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    sink ^= TensorHash(tensor);
+  }
+  std::chrono::duration<double> memoized =
+      std::chrono::steady_clock::now() - start;
+  std::printf("TensorHash of %zu floats: %.3f ms, then %.3f us memoized\n",
+              num_elements, first.count() * 1e3,
+              memoized.count() * 1e6 / iterations);
+  std::printf("(checksum %s)\n", xla::util::HexHash(sink).c_str());
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  int iterations = 1000;
+  if (argc > 1 && (!absl::SimpleAtoi(argv[1], &iterations) || iterations < 1)) {
+    std::fprintf(stderr, "Usage: %s [ITERATIONS]\n", argv[0]);
+    return 1;
+  }
+  swift_xla::RunBenchmarks(iterations);
+  return 0;
+}
@@ -0,0 +1,930 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_evaluator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/layout_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// The element types supported by the host evaluation, with their C++ types.
+#define HOST_EVAL_TYPES(_) \
+  _(PRED, bool)            \
+  _(S8, int8_t)            \
+  _(S16, int16_t)          \
+  _(S32, int32_t)          \
+  _(S64, int64_t)          \
+  _(U8, uint8_t)           \
+  _(U16, uint16_t)         \
+  _(U32, uint32_t)         \
+  _(F32, float)            \
+  _(F64, double)
+
+size_t GetMaxNodes() {
+  static const size_t max_nodes =
+      xla::sys_util::GetEnvInt("XLA_HOST_EVAL_MAX_NODES", 32);
+  return max_nodes;
+}
+
+int64_t GetMaxElements() {
+  static const int64_t max_elements =
+      xla::sys_util::GetEnvInt("XLA_HOST_EVAL_MAX_ELEMENTS", 64);
+  return max_elements;
+}
+
+bool IsSupportedType(xla::PrimitiveType type) {
+  switch (type) {
+#define SUPPORTED_TYPE_CASE(name, ctype) case xla::PrimitiveType::name:
+    HOST_EVAL_TYPES(SUPPORTED_TYPE_CASE)
+#undef SUPPORTED_TYPE_CASE
+    return true;
+    default:
+      return false;
+  }
+}
+
+bool IsReal(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::F32 || type == xla::PrimitiveType::F64;
+}
+
+// Wraps an integer to the range of the given integral type, the way the
+// integer arithmetic on the device does.
+int64_t WrapInt(xla::PrimitiveType type, int64_t value) {
+  switch (type) {
+    case xla::PrimitiveType::PRED:
+      return value != 0;
+    case xla::PrimitiveType::S8:
+      return static_cast<int8_t>(value);
+    case xla::PrimitiveType::S16:
+      return static_cast<int16_t>(value);
+    case xla::PrimitiveType::S32:
+      return static_cast<int32_t>(value);
+    case xla::PrimitiveType::U8:
+      return static_cast<uint8_t>(value);
+    case xla::PrimitiveType::U16:
+      return static_cast<uint16_t>(value);
+    case xla::PrimitiveType::U32:
+      return static_cast<uint32_t>(value);
+    default:
+      return value;
+  }
+}
+
+int64_t WrappingNeg(int64_t value) {
+  return static_cast<int64_t>(0 - static_cast<uint64_t>(value));
+}
+
+template <typename T>
+bool FitsIn(double value) {
+  return value >= std::numeric_limits<T>::lowest() &&
+         value <= std::numeric_limits<T>::max();
+}
+
+// Whether the (already truncated) value can be converted to the given integral
+// type. The device behavior is implementation defined otherwise.
+bool FitsInIntegral(xla::PrimitiveType type, double value) {
+  switch (type) {
+    case xla::PrimitiveType::S8:
+      return FitsIn<int8_t>(value);
+    case xla::PrimitiveType::S16:
+      return FitsIn<int16_t>(value);
+    case xla::PrimitiveType::S32:
+      return FitsIn<int32_t>(value);
+    case xla::PrimitiveType::S64:
+      return value >= -0x1p63 && value < 0x1p63;
+    case xla::PrimitiveType::U8:
+      return FitsIn<uint8_t>(value);
+    case xla::PrimitiveType::U16:
+      return FitsIn<uint16_t>(value);
+    case xla::PrimitiveType::U32:
+      return FitsIn<uint32_t>(value);
+    default:
+      return false;
+  }
+}
+
+// The value of a node, with the elements in row-major order. Floating point
+// values are held as double and the other ones as int64, and both get rounded
+// or wrapped to the node type after each operation.
+struct HostArray {
+  HostArray(xla::PrimitiveType type, int64_t size) : type(type) {
+    if (IsReal(type)) {
+      reals.resize(size);
+    } else {
+      ints.resize(size);
+    }
+  }
+
+  int64_t size() const { return IsReal(type) ? reals.size() : ints.size(); }
+
+  double real(int64_t i) const {
+    return IsReal(type) ? reals[i] : static_cast<double>(ints[i]);
+  }
+
+  void set_real(int64_t i, double value) {
+    reals[i] = type == xla::PrimitiveType::F32 ? static_cast<float>(value)
+                                               : value;
+  }
+
+  void set_int(int64_t i, int64_t value) { ints[i] = WrapInt(type, value); }
+
+  xla::PrimitiveType type;
+  std::vector<double> reals;
+  std::vector<int64_t> ints;
+};
+
+template <typename T>
+void ReadElements(const xla::Literal& literal, HostArray* array) {
+  absl::Span<const T> data = literal.data<T>();
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (IsReal(array->type)) {
+      array->reals[i] = static_cast<double>(data[i]);
+    } else {
+      array->ints[i] = static_cast<int64_t>(data[i]);
+    }
+  }
+}
+
+template <typename T>
+void WriteElements(const HostArray& array, xla::Literal* literal) {
+  absl::Span<T> data = literal->data<T>();
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = IsReal(array.type) ? static_cast<T>(array.reals[i])
+                                 : static_cast<T>(array.ints[i]);
+  }
+}
+
+// Reads a literal with a row-major layout.
+HostArray ReadLiteral(const xla::Literal& literal) {
+  const xla::Shape& shape = literal.shape();
+  HostArray array(shape.element_type(), xla::ShapeUtil::ElementsIn(shape));
+  switch (shape.element_type()) {
+#define READ_TYPE_CASE(name, ctype)        \
+  case xla::PrimitiveType::name:           \
+    ReadElements<ctype>(literal, &array);  \
+    break;
+    HOST_EVAL_TYPES(READ_TYPE_CASE)
+#undef READ_TYPE_CASE
+    default:
+      XLA_ERROR() << "Unsupported host evaluation type: " << shape;
+  }
+  return array;
+}
+
+xla::Literal WriteLiteral(const HostArray& array,
+                          absl::Span<const int64_t> dimensions) {
+  xla::Literal literal(
+      xla::ShapeUtil::MakeShapeWithDescendingLayout(array.type, dimensions));
+  switch (array.type) {
+#define WRITE_TYPE_CASE(name, ctype)        \
+  case xla::PrimitiveType::name:            \
+    WriteElements<ctype>(array, &literal);  \
+    break;
+    HOST_EVAL_TYPES(WRITE_TYPE_CASE)
+#undef WRITE_TYPE_CASE
+    default:
+      XLA_ERROR() << "Unsupported host evaluation type: " << array.type;
+  }
+  return literal;
+}
+
+absl::optional<HostArray> Convert(const HostArray& input,
+                                  xla::PrimitiveType type) {
+  if (input.type == type) {
+    return input;
+  }
+  HostArray result(type, input.size());
+  for (int64_t i = 0; i < input.size(); ++i) {
+    if (IsReal(type)) {
+      result.set_real(i, input.real(i));
+    } else if (type == xla::PrimitiveType::PRED) {
+      result.ints[i] = input.real(i) != 0;
+    } else if (IsReal(input.type)) {
+      double value = std::trunc(input.reals[i]);
+      if (!FitsInIntegral(type, value)) {
+        return absl::nullopt;
+      }
+      result.set_int(i, static_cast<int64_t>(value));
+    } else {
+      result.set_int(i, input.ints[i]);
+    }
+  }
+  return result;
+}
+
+// Maps every element of a row-major array of dimensions to, to the element of
+// the array of dimensions from it gets broadcast from, following the implicit
+// (right aligned) broadcasting rules.
+absl::optional<std::vector<int64_t>> BroadcastIndices(
+    absl::Span<const int64_t> from, absl::Span<const int64_t> to) {
+  if (from.size() > to.size()) {
+    return absl::nullopt;
+  }
+  size_t offset = to.size() - from.size();
+  std::vector<int64_t> strides(to.size(), 0);
+  int64_t stride = 1;
+  for (size_t i = from.size(); i > 0; --i) {
+    if (from[i - 1] == to[offset + i - 1]) {
+      strides[offset + i - 1] = stride;
+    } else if (from[i - 1] != 1) {
+      return absl::nullopt;
+    }
+    stride *= from[i - 1];
+  }
+  int64_t count = 1;
+  for (int64_t size : to) {
+    count *= size;
+  }
+  std::vector<int64_t> indices(count);
+  std::vector<int64_t> index(to.size(), 0);
+  for (int64_t i = 0; i < count; ++i) {
+    int64_t source = 0;
+    for (size_t dim = 0; dim < to.size(); ++dim) {
+      source += index[dim] * strides[dim];
+    }
+    indices[i] = source;
+    for (size_t dim = to.size(); dim > 0; --dim) {
+      if (++index[dim - 1] < to[dim - 1]) {
+        break;
+      }
+      index[dim - 1] = 0;
+    }
+  }
+  return indices;
+}
+
+enum class BinaryOp { kAdd, kSub, kMul, kDiv, kRem, kPow, kMax, kMin };
+
+enum class CompareOp { kEq, kNe, kLt, kLe, kGt, kGe };
+
+double ApplyReal(BinaryOp op, double lhs, double rhs) {
+  switch (op) {
+    case BinaryOp::kAdd:
+      return lhs + rhs;
+    case BinaryOp::kSub:
+      return lhs - rhs;
+    case BinaryOp::kMul:
+      return lhs * rhs;
+    case BinaryOp::kDiv:
+      return lhs / rhs;
+    case BinaryOp::kRem:
+      return std::fmod(lhs, rhs);
+    case BinaryOp::kPow:
+      return std::pow(lhs, rhs);
+    case BinaryOp::kMax:
+    case BinaryOp::kMin:
+      // Like on the device, NaNs propagate.
+      if (std::isnan(lhs) || std::isnan(rhs)) {
+        return std::numeric_limits<double>::quiet_NaN();
+      }
+      return op == BinaryOp::kMax ? std::max(lhs, rhs) : std::min(lhs, rhs);
+  }
+  XLA_ERROR() << "Invalid op: " << xla::util::GetEnumValue(op);
+}
+
+// Applies op in 64 bits wrapping arithmetic, leaving the wrapping to the
+// narrower types to the caller. Returns nullopt where the device behavior is
+// undefined.
+absl::optional<int64_t> ApplyInt(BinaryOp op, int64_t lhs, int64_t rhs) {
+  uint64_t ulhs = static_cast<uint64_t>(lhs);
+  uint64_t urhs = static_cast<uint64_t>(rhs);
+  switch (op) {
+    case BinaryOp::kAdd:
+      return static_cast<int64_t>(ulhs + urhs);
+    case BinaryOp::kSub:
+      return static_cast<int64_t>(ulhs - urhs);
+    case BinaryOp::kMul:
+      return static_cast<int64_t>(ulhs * urhs);
+    case BinaryOp::kDiv:
+    case BinaryOp::kRem:
+      if (rhs == 0 ||
+          (rhs == -1 && lhs == std::numeric_limits<int64_t>::min())) {
+        return absl::nullopt;
+      }
+      return op == BinaryOp::kDiv ? lhs / rhs : lhs % rhs;
+    case BinaryOp::kPow: {
+      if (rhs < 0) {
+        return absl::nullopt;
+      }
+      uint64_t result = 1;
+      for (; urhs != 0; urhs >>= 1) {
+        if (urhs & 1) {
+          result *= ulhs;
+        }
+        ulhs *= ulhs;
+      }
+      return static_cast<int64_t>(result);
+    }
+    case BinaryOp::kMax:
+      return std::max(lhs, rhs);
+    case BinaryOp::kMin:
+      return std::min(lhs, rhs);
+  }
+  XLA_ERROR() << "Invalid op: " << xla::util::GetEnumValue(op);
+}
+
+template <typename T>
+bool ApplyCompare(CompareOp op, T lhs, T rhs) {
+  switch (op) {
+    case CompareOp::kEq:
+      return lhs == rhs;
+    case CompareOp::kNe:
+      return lhs != rhs;
+    case CompareOp::kLt:
+      return lhs < rhs;
+    case CompareOp::kLe:
+      return lhs <= rhs;
+    case CompareOp::kGt:
+      return lhs > rhs;
+    case CompareOp::kGe:
+      return lhs >= rhs;
+  }
+  XLA_ERROR() << "Invalid op: " << xla::util::GetEnumValue(op);
+}
+
+bool IsFullReduction(const ir::Node* node) {
+  // When the output holds a single element, all the dimensions which are not
+  // reduced have size one, so the reduction can be done over all the elements,
+  // whatever the reduced dimensions are.
+  return xla::ShapeUtil::ElementsIn(node->shape()) == 1;
+}
+
+// Collects the nodes of the graph rooted at root in post-order. Returns false
+// (and stops the walk early) if the graph has too many nodes.
+bool CollectNodes(const ir::Node* root,
+                  std::vector<const ir::Node*>* post_order) {
+  absl::flat_hash_set<const ir::Node*> visited({root});
+  std::vector<std::pair<const ir::Node*, size_t>> stack({{root, 0}});
+  while (!stack.empty()) {
+    const ir::Node* node = stack.back().first;
+    size_t operand_index = stack.back().second++;
+    if (operand_index < node->operands().size()) {
+      const ir::Node* operand = node->operand(operand_index).node;
+      if (visited.insert(operand).second) {
+        if (visited.size() > GetMaxNodes()) {
+          return false;
+        }
+        stack.emplace_back(operand, 0);
+      }
+    } else {
+      post_order->push_back(node);
+      stack.pop_back();
+    }
+  }
+  return true;
+}
+
+class HostEvaluator {
+ public:
+  HostEvaluator(const Device& device, const HostDataFn& host_data_fn)
+      : device_(device), host_data_fn_(host_data_fn) {}
+
+  absl::optional<HostArray> Run(const ir::Node* root) {
+    std::vector<const ir::Node*> post_order;
+    if (!CollectNodes(root, &post_order)) {
+      return absl::nullopt;
+    }
+    for (auto node : post_order) {
+      absl::optional<HostArray> value = Evaluate(node);
+      if (!value) {
+        return absl::nullopt;
+      }
+      values_.emplace(node, std::move(*value));
+    }
+    return std::move(values_.at(root));
+  }
+
+ private:
+  absl::optional<HostArray> Evaluate(const ir::Node* node) {
+    const xla::Shape& shape = node->shape();
+    if (node->num_outputs() != 1 || !shape.IsArray() || !shape.is_static() ||
+        !IsSupportedType(shape.element_type()) ||
+        xla::ShapeUtil::ElementsIn(shape) > GetMaxElements()) {
+      return absl::nullopt;
+    }
+    if (node->operands().empty()) {
+      return EvaluateLeaf(node);
+    }
+    switch (static_cast<c10::unique_t>(node->op().op)) {
+      case at::aten::abs:
+        return Unary(
+            node, [](double x) { return std::fabs(x); },
+            [](int64_t x) { return x < 0 ? WrappingNeg(x) : x; });
+      case at::aten::neg:
+        return Unary(node, [](double x) { return -x; }, WrappingNeg);
+      case at::aten::sign:
+        return Unary(
+            node,
+            [](double x) -> double {
+              return std::isnan(x) ? x : (x > 0) - (x < 0);
+            },
+            [](int64_t x) -> int64_t { return (x > 0) - (x < 0); });
+      case at::aten::exp:
+        return UnaryReal(node, [](double x) { return std::exp(x); });
+      case at::aten::expm1:
+        return UnaryReal(node, [](double x) { return std::expm1(x); });
+      case at::aten::log:
+        return UnaryReal(node, [](double x) { return std::log(x); });
+      case at::aten::log1p:
+        return UnaryReal(node, [](double x) { return std::log1p(x); });
+      case at::aten::sqrt:
+        return UnaryReal(node, [](double x) { return std::sqrt(x); });
+      case at::aten::rsqrt:
+        return UnaryReal(node, [](double x) { return 1 / std::sqrt(x); });
+      case at::aten::sin:
+        return UnaryReal(node, [](double x) { return std::sin(x); });
+      case at::aten::cos:
+        return UnaryReal(node, [](double x) { return std::cos(x); });
+      case at::aten::tan:
+        return UnaryReal(node, [](double x) { return std::tan(x); });
+      case at::aten::tanh:
+        return UnaryReal(node, [](double x) { return std::tanh(x); });
+      case at::aten::sigmoid:
+        return UnaryReal(node,
+                         [](double x) { return 1 / (1 + std::exp(-x)); });
+      case at::aten::floor:
+        return UnaryReal(node, [](double x) { return std::floor(x); });
+      case at::aten::ceil:
+        return UnaryReal(node, [](double x) { return std::ceil(x); });
+      case at::aten::round_to_even:
+        return UnaryReal(node, [](double x) { return std::nearbyint(x); });
+      case at::aten::relu:
+        return Unary(
+            node, [](double x) { return ApplyReal(BinaryOp::kMax, x, 0); },
+            [](int64_t x) { return std::max<int64_t>(x, 0); });
+      case at::aten::xla_is_nan:
+        return Predicate(node, [](double x) { return std::isnan(x); });
+      case at::aten::xla_is_inf:
+        return Predicate(node, [](double x) { return std::isinf(x); });
+      case at::aten::xla_is_finite:
+        return Predicate(node, [](double x) { return std::isfinite(x); });
+      case at::aten::add:
+        return Binary(node, BinaryOp::kAdd);
+      case at::aten::sub:
+        return Binary(node, BinaryOp::kSub);
+      case at::aten::mul:
+        return Binary(node, BinaryOp::kMul);
+      case at::aten::div:
+        return Binary(node, BinaryOp::kDiv);
+      case at::aten::xla_rem:
+        return Binary(node, BinaryOp::kRem);
+      case at::aten::pow:
+        return Binary(node, BinaryOp::kPow);
+      case at::aten::max:
+        return node->operands().size() == 1 ? Reduce(node)
+                                            : Binary(node, BinaryOp::kMax);
+      case at::aten::min:
+        return node->operands().size() == 1 ? Reduce(node)
+                                            : Binary(node, BinaryOp::kMin);
+      case at::aten::eq:
+        return Compare(node, CompareOp::kEq);
+      case at::aten::ne:
+        return Compare(node, CompareOp::kNe);
+      case at::aten::lt:
+        return Compare(node, CompareOp::kLt);
+      case at::aten::le:
+        return Compare(node, CompareOp::kLe);
+      case at::aten::gt:
+        return Compare(node, CompareOp::kGt);
+      case at::aten::ge:
+        return Compare(node, CompareOp::kGe);
+      case at::aten::logical_and:
+      case at::aten::logical_or:
+        return Logical(node);
+      case at::aten::where:
+        return Where(node);
+      case at::aten::clamp:
+        return Clamp(node);
+      case at::aten::sum:
+      case at::aten::mean:
+      case at::aten::prod:
+      case at::aten::all:
+      case at::aten::any:
+        return Reduce(node);
+      case at::aten::view:
+      case at::aten::squeeze:
+        return Reshape(node);
+      case at::aten::expand:
+        return Expand(node);
+      case xla_symbols::cast:
+        return Cast(node);
+      default:
+        return absl::nullopt;
+    }
+  }
+
+  absl::optional<HostArray> EvaluateLeaf(const ir::Node* node) {
+    const xla::Shape& shape = node->shape();
+    if (const auto* scalar = dynamic_cast<const ir::ops::Scalar*>(node)) {
+      const at::Scalar& value = scalar->value();
+      HostArray array(value.isFloatingPoint() ? xla::PrimitiveType::F64
+                                              : xla::PrimitiveType::S64,
+                      1);
+      if (value.isFloatingPoint()) {
+        array.reals[0] = value.toDouble();
+      } else {
+        array.ints[0] = value.toLong();
+      }
+      absl::optional<HostArray> element = Convert(array, shape.element_type());
+      if (!element) {
+        return absl::nullopt;
+      }
+      return Broadcast(*element, {}, shape.dimensions());
+    }
+    if (const auto* constant = dynamic_cast<const ir::ops::Constant*>(node)) {
+      const xla::Shape& literal_shape = constant->value().shape();
+      if (literal_shape.element_type() != shape.element_type() ||
+          !xla::LayoutUtil::IsMonotonicWithDim0Major(literal_shape.layout())) {
+        return absl::nullopt;
+      }
+      return ReadLiteral(constant->value());
+    }
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data == nullptr) {
+      return absl::nullopt;
+    }
+    c10::optional<at::Tensor> tensor = host_data_fn_(*device_data);
+    if (!tensor || tensor->shape().size() != shape.rank() ||
+        !xla::util::Equal(tensor->shape(), shape.dimensions())) {
+      return absl::nullopt;
+    }
+    xla::Shape host_shape = xla::ShapeUtil::MakeShapeWithDescendingLayout(
+        shape.element_type(), shape.dimensions());
+    return ReadLiteral(GetTensorLiteral(*tensor, &host_shape, &device_));
+  }
+
+  const HostArray& Operand(const ir::Node* node, size_t index) const {
+    return values_.at(node->operand(index).node);
+  }
+
+  // Returns the given array, laid out with the given dimensions, broadcast to
+  // the dimensions of the node output.
+  absl::optional<HostArray> Broadcast(const HostArray& array,
+                                      absl::Span<const int64_t> dimensions,
+                                      absl::Span<const int64_t> to) const {
+    absl::optional<std::vector<int64_t>> indices =
+        BroadcastIndices(dimensions, to);
+    if (!indices) {
+      return absl::nullopt;
+    }
+    HostArray result(array.type, indices->size());
+    for (size_t i = 0; i < indices->size(); ++i) {
+      if (IsReal(array.type)) {
+        result.reals[i] = array.reals[(*indices)[i]];
+      } else {
+        result.ints[i] = array.ints[(*indices)[i]];
+      }
+    }
+    return result;
+  }
+
+  // Returns the operand at index, converted to the given type and broadcast
+  // to the dimensions of the node output.
+  absl::optional<HostArray> PromotedOperand(const ir::Node* node, size_t index,
+                                            xla::PrimitiveType type) const {
+    absl::optional<HostArray> operand = Convert(Operand(node, index), type);
+    if (!operand) {
+      return absl::nullopt;
+    }
+    return Broadcast(*operand, node->operand(index).shape().dimensions(),
+                     node->shape().dimensions());
+  }
+
+  template <typename RealFn, typename IntFn>
+  absl::optional<HostArray> Unary(const ir::Node* node, const RealFn& real_fn,
+                                  const IntFn& int_fn) const {
+    const HostArray& input = Operand(node, 0);
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 1 || input.type != type ||
+        type == xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    HostArray result(type, input.size());
+    for (int64_t i = 0; i < input.size(); ++i) {
+      if (IsReal(type)) {
+        result.set_real(i, real_fn(input.reals[i]));
+      } else {
+        result.set_int(i, int_fn(input.ints[i]));
+      }
+    }
+    return result;
+  }
+
+  template <typename RealFn>
+  absl::optional<HostArray> UnaryReal(const ir::Node* node,
+                                      const RealFn& real_fn) const {
+    if (!IsReal(node->shape().element_type())) {
+      return absl::nullopt;
+    }
+    return Unary(node, real_fn, [](int64_t x) { return x; });
+  }
+
+  template <typename PredicateFn>
+  absl::optional<HostArray> Predicate(const ir::Node* node,
+                                      const PredicateFn& predicate_fn) const {
+    const HostArray& input = Operand(node, 0);
+    if (node->operands().size() != 1 || !IsReal(input.type) ||
+        node->shape().element_type() != xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    HostArray result(xla::PrimitiveType::PRED, input.size());
+    for (int64_t i = 0; i < input.size(); ++i) {
+      result.ints[i] = predicate_fn(input.reals[i]);
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Binary(const ir::Node* node, BinaryOp op) const {
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 2 || type == xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    absl::optional<HostArray> lhs = PromotedOperand(node, 0, type);
+    absl::optional<HostArray> rhs = PromotedOperand(node, 1, type);
+    if (!lhs || !rhs) {
+      return absl::nullopt;
+    }
+    HostArray result(type, lhs->size());
+    for (int64_t i = 0; i < lhs->size(); ++i) {
+      if (IsReal(type)) {
+        result.set_real(i, ApplyReal(op, lhs->reals[i], rhs->reals[i]));
+        continue;
+      }
+      absl::optional<int64_t> value = ApplyInt(op, lhs->ints[i], rhs->ints[i]);
+      // The quotient of the most negative value by -1 does not fit either.
+      if (!value || (op == BinaryOp::kDiv && WrapInt(type, *value) != *value)) {
+        return absl::nullopt;
+      }
+      result.set_int(i, *value);
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Compare(const ir::Node* node, CompareOp op) const {
+    if (node->operands().size() != 2 ||
+        node->shape().element_type() != xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    xla::PrimitiveType type = XlaHelpers::PromoteType(Operand(node, 0).type,
+                                                      Operand(node, 1).type);
+    absl::optional<HostArray> lhs = PromotedOperand(node, 0, type);
+    absl::optional<HostArray> rhs = PromotedOperand(node, 1, type);
+    if (!lhs || !rhs) {
+      return absl::nullopt;
+    }
+    HostArray result(xla::PrimitiveType::PRED, lhs->size());
+    for (int64_t i = 0; i < lhs->size(); ++i) {
+      result.ints[i] =
+          IsReal(type) ? ApplyCompare(op, lhs->reals[i], rhs->reals[i])
+                       : ApplyCompare(op, lhs->ints[i], rhs->ints[i]);
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Logical(const ir::Node* node) const {
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 2 || type != xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    absl::optional<HostArray> lhs = PromotedOperand(node, 0, type);
+    absl::optional<HostArray> rhs = PromotedOperand(node, 1, type);
+    if (!lhs || !rhs) {
+      return absl::nullopt;
+    }
+    bool is_and = node->op() == ir::OpKind(at::aten::logical_and);
+    HostArray result(type, lhs->size());
+    for (int64_t i = 0; i < lhs->size(); ++i) {
+      result.ints[i] = is_and ? lhs->ints[i] && rhs->ints[i]
+                              : lhs->ints[i] || rhs->ints[i];
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Where(const ir::Node* node) const {
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 3) {
+      return absl::nullopt;
+    }
+    absl::optional<HostArray> condition =
+        PromotedOperand(node, 0, xla::PrimitiveType::PRED);
+    absl::optional<HostArray> input = PromotedOperand(node, 1, type);
+    absl::optional<HostArray> other = PromotedOperand(node, 2, type);
+    if (!condition || !input || !other) {
+      return absl::nullopt;
+    }
+    return Select(*condition, std::move(*input), *other);
+  }
+
+  static HostArray Select(const HostArray& condition, HostArray input,
+                          const HostArray& other) {
+    for (int64_t i = 0; i < input.size(); ++i) {
+      if (condition.ints[i]) {
+        continue;
+      }
+      if (IsReal(input.type)) {
+        input.reals[i] = other.reals[i];
+      } else {
+        input.ints[i] = other.ints[i];
+      }
+    }
+    return input;
+  }
+
+  absl::optional<HostArray> Clamp(const ir::Node* node) const {
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 3 || type == xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    absl::optional<HostArray> input = PromotedOperand(node, 0, type);
+    absl::optional<HostArray> min = PromotedOperand(node, 1, type);
+    absl::optional<HostArray> max = PromotedOperand(node, 2, type);
+    if (!input || !min || !max) {
+      return absl::nullopt;
+    }
+    HostArray result(type, input->size());
+    for (int64_t i = 0; i < input->size(); ++i) {
+      if (IsReal(type)) {
+        result.set_real(
+            i, ApplyReal(BinaryOp::kMin,
+                         ApplyReal(BinaryOp::kMax, input->reals[i],
+                                   min->reals[i]),
+                         max->reals[i]));
+      } else {
+        result.set_int(i, std::min(std::max(input->ints[i], min->ints[i]),
+                                   max->ints[i]));
+      }
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Reduce(const ir::Node* node) const {
+    xla::PrimitiveType type = node->shape().element_type();
+    if (node->operands().size() != 1 || !IsFullReduction(node)) {
+      return absl::nullopt;
+    }
+    const HostArray& input = Operand(node, 0);
+    HostArray result(type, 1);
+    if (node->op() == ir::OpKind(at::aten::all) ||
+        node->op() == ir::OpKind(at::aten::any)) {
+      bool is_all = node->op() == ir::OpKind(at::aten::all);
+      if (type != xla::PrimitiveType::PRED) {
+        return absl::nullopt;
+      }
+      result.ints[0] = is_all;
+      for (int64_t i = 0; i < input.size(); ++i) {
+        if ((input.real(i) != 0) != is_all) {
+          result.ints[0] = !is_all;
+          break;
+        }
+      }
+      return result;
+    }
+    absl::optional<HostArray> values = Convert(input, type);
+    if (!values || type == xla::PrimitiveType::PRED) {
+      return absl::nullopt;
+    }
+    if (node->op() == ir::OpKind(at::aten::max) ||
+        node->op() == ir::OpKind(at::aten::min)) {
+      if (input.type != type || values->size() == 0) {
+        return absl::nullopt;
+      }
+      double infinity = std::numeric_limits<double>::infinity();
+      return node->op() == ir::OpKind(at::aten::max)
+                 ? Accumulate(*values, BinaryOp::kMax, -infinity,
+                              std::numeric_limits<int64_t>::min())
+                 : Accumulate(*values, BinaryOp::kMin, infinity,
+                              std::numeric_limits<int64_t>::max());
+    }
+    if (node->op() == ir::OpKind(at::aten::mean)) {
+      if (!IsReal(type)) {
+        return absl::nullopt;
+      }
+      HostArray sum = Accumulate(*values, BinaryOp::kAdd, 0, 0);
+      sum.set_real(0, sum.reals[0] / values->size());
+      return sum;
+    }
+    return node->op() == ir::OpKind(at::aten::prod)
+               ? Accumulate(*values, BinaryOp::kMul, 1, 1)
+               : Accumulate(*values, BinaryOp::kAdd, 0, 0);
+  }
+
+  // Reduces all the elements of values, starting from the given initial
+  // value. Floating point values get accumulated in double precision.
+  static HostArray Accumulate(const HostArray& values, BinaryOp op,
+                              double real_init, int64_t int_init) {
+    HostArray result(values.type, 1);
+    if (IsReal(values.type)) {
+      double accumulator = real_init;
+      for (double value : values.reals) {
+        accumulator = ApplyReal(op, accumulator, value);
+      }
+      result.set_real(0, accumulator);
+    } else {
+      int64_t accumulator = int_init;
+      for (int64_t value : values.ints) {
+        accumulator = *ApplyInt(op, accumulator, value);
+      }
+      result.set_int(0, accumulator);
+    }
+    return result;
+  }
+
+  absl::optional<HostArray> Reshape(const ir::Node* node) const {
+    const HostArray& input = Operand(node, 0);
+    if (node->operands().size() != 1 ||
+        input.type != node->shape().element_type() ||
+        input.size() != xla::ShapeUtil::ElementsIn(node->shape())) {
+      return absl::nullopt;
+    }
+    return input;
+  }
+
+  absl::optional<HostArray> Expand(const ir::Node* node) const {
+    const HostArray& input = Operand(node, 0);
+    if (node->operands().size() != 1 ||
+        input.type != node->shape().element_type()) {
+      return absl::nullopt;
+    }
+    return Broadcast(input, node->operand(0).shape().dimensions(),
+                     node->shape().dimensions());
+  }
+
+  absl::optional<HostArray> Cast(const ir::Node* node) const {
+    if (node->operands().size() != 1) {
+      return absl::nullopt;
+    }
+    // The casts to the types without a native XLA counterpart mask the result
+    // to the raw type width. The logical casts only know about this on the
+    // device types where they happen, and which are filtered out here.
+    const ir::ops::Cast* cast = dynamic_cast<const ir::ops::Cast*>(node);
+    if (cast != nullptr
+            ? cast->dtype() &&
+                  TensorTypeToRawXlaType(*cast->dtype()) != cast->type()
+            : device_.hw_type == DeviceType::TPU) {
+      return absl::nullopt;
+    }
+    return Convert(Operand(node, 0), node->shape().element_type());
+  }
+
+  const Device& device_;
+  const HostDataFn& host_data_fn_;
+  absl::flat_hash_map<const ir::Node*, HostArray> values_;
+};
+
+}  // namespace
+
+bool IsHostEvaluable(const at::Tensor& tensor) {
+  return GetMaxNodes() > 0 && at::GetLenFromShape(tensor.shape()) <=
+                                  static_cast<size_t>(GetMaxElements());
+}
+
+c10::optional<at::Tensor> EvaluateOnHost(const ir::Value& root,
+                                         at::ScalarType dest_element_type,
+                                         const Device& device,
+                                         const HostDataFn& host_data_fn) {
+  if (GetMaxNodes() == 0 || root->num_outputs() != 1) {
+    return absl::nullopt;
+  }
+  absl::optional<HostArray> value =
+      HostEvaluator(device, host_data_fn).Run(root.node.get());
+  if (!value) {
+    return absl::nullopt;
+  }
+  XLA_COUNTER("HostEvaluations", 1);
+  return MakeTensorFromXlaLiteral(
+      WriteLiteral(*value, root.shape().dimensions()), dest_element_type);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Evaluation of tiny IR graphs on the host, without going through an XLA
+// compilation and a device round trip. This targets the scalars driving the
+// control flow of the training loops (learning rate schedules, step counters,
+// loss scales, ...), which are read back right after being computed.
+//
+// Only graphs of elementwise operations, casts, reshapes, broadcasts and full
+// reductions qualify, with no more than XLA_HOST_EVAL_MAX_NODES nodes (32 by
+// default, 0 disables the host evaluation) of up to XLA_HOST_EVAL_MAX_ELEMENTS
+// elements (64 by default), and whose leaves are constants or device data with
+// a host copy. Transcendental functions and floating point reductions can
+// differ from the device results in the last bits.
+
+// Returns the host copy of the content of the given device data node, if one is
+// available.
+using HostDataFn =
+    std::function<c10::optional<at::Tensor>(const ir::ops::DeviceData&)>;
+
+// Whether the tensor is small enough for its host copy to be worth keeping
+// around its device data, for EvaluateOnHost() to use.
+bool IsHostEvaluable(const at::Tensor& tensor);
+
+// Evaluates the graph rooted at root on the host, and returns its value as a
+// tensor of the given element type. Returns nullopt if the graph does not
+// qualify for host evaluation.
+c10::optional<at::Tensor> EvaluateOnHost(const ir::Value& root,
+                                         at::ScalarType dest_element_type,
+                                         const Device& device,
+                                         const HostDataFn& host_data_fn);
+
+}  // namespace swift_xla
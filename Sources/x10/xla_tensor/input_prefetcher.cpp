@@ -0,0 +1,248 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/input_prefetcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace swift_xla {
+namespace {
+
+// Host buffers are page aligned, which is what DMA engines prefer when the
+// transfer manager copies out of them.
+constexpr size_t kStagingAlignment = 4096;
+
+// Caches host staging buffers by (page rounded) size, so that the same-shaped
+// batches fed by an input pipeline do not pay the allocation and page fault
+// cost at every step.
+class StagingBufferPool {
+ public:
+  static StagingBufferPool* Get() {
+    static size_t max_size = xla::sys_util::GetEnvInt(
+        "XLA_PREFETCH_STAGING_POOL_MAXSIZE", 512 * 1024 * 1024);
+    static StagingBufferPool* pool = new StagingBufferPool(max_size);
+    return pool;
+  }
+
+  static size_t RoundSize(size_t num_bytes) {
+    return xla::RoundUpTo<size_t>(std::max<size_t>(num_bytes, 1),
+                                  kStagingAlignment);
+  }
+
+  void* Allocate(size_t num_bytes) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = free_blocks_.find(num_bytes);
+      if (it != free_blocks_.end() && !it->second.empty()) {
+        void* block = it->second.back();
+        it->second.pop_back();
+        size_ -= num_bytes;
+        XLA_COUNTER("PrefetchStagingHit", 1);
+        return block;
+      }
+    }
+    XLA_COUNTER("PrefetchStagingMiss", 1);
+    void* block = tensorflow::port::AlignedMalloc(num_bytes, kStagingAlignment);
+    XLA_CHECK(block != nullptr) << "Failed to allocate " << num_bytes
+                                << " bytes of staging memory";
+    return block;
+  }
+
+  void Release(void* block, size_t num_bytes) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (size_ + num_bytes <= max_size_) {
+        free_blocks_[num_bytes].push_back(block);
+        size_ += num_bytes;
+        return;
+      }
+    }
+    tensorflow::port::AlignedFree(block);
+  }
+
+ private:
+  explicit StagingBufferPool(size_t max_size) : max_size_(max_size) {}
+
+  size_t max_size_ = 0;
+  std::mutex mutex_;
+  // Total size of the blocks sitting in the free lists.
+  size_t size_ = 0;
+  std::unordered_map<size_t, std::vector<void*>> free_blocks_;
+};
+
+// Implementation of Scalar buffer backed by a pooled staging block.
+class StagingScalarBuffer : public at::AnyScalarBuffer {
+ public:
+  StagingScalarBuffer(at::ScalarType type, size_t len, size_t num_bytes)
+      : at::AnyScalarBuffer(type),
+        num_bytes_(StagingBufferPool::RoundSize(num_bytes)),
+        block_(StagingBufferPool::Get()->Allocate(num_bytes_)) {
+    set_base(block_);
+    set_size(len);
+  }
+
+  ~StagingScalarBuffer() override {
+    StagingBufferPool::Get()->Release(block_, num_bytes_);
+  }
+
+  void* mutable_data() {
+    invalidate_content_hash();
+    return block_;
+  }
+
+ private:
+  size_t num_bytes_;
+  void* block_;
+};
+
+}  // namespace
+
+class InputPrefetcher::CallerScope {
+ public:
+  explicit CallerScope(InputPrefetcher* prefetcher) : prefetcher_(prefetcher) {
+    ++prefetcher_->num_callers_;
+  }
+
+  ~CallerScope() {
+    // Notifying with the lock held is what keeps the destructor from releasing
+    // the condition variable while it is being signaled.
+    --prefetcher_->num_callers_;
+    prefetcher_->cv_.notify_all();
+  }
+
+ private:
+  InputPrefetcher* prefetcher_;
+};
+
+InputPrefetcher::InputPrefetcher(const Device& device, size_t depth)
+    : device_(device), depth_(depth) {
+  XLA_CHECK_GT(depth_, 0);
+  thread_ = std::thread([this]() { Runner(); });
+}
+
+InputPrefetcher::~InputPrefetcher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return num_callers_ == 0; });
+  }
+  thread_.join();
+}
+
+at::Tensor InputPrefetcher::Stage(at::ScalarType type, const void* data,
+                                  size_t num_entries,
+                                  std::vector<int64_t> shape) {
+  size_t num_bytes = num_entries * at::internal::GetSizeof(type);
+  auto buffer =
+      std::make_unique<StagingScalarBuffer>(type, num_entries, num_bytes);
+  std::memcpy(buffer->mutable_data(), data, num_bytes);
+  return at::Tensor(std::move(buffer), std::move(shape));
+}
+
+void InputPrefetcher::Enqueue(std::vector<at::Tensor> tensors) {
+  auto slot = std::make_shared<Slot>();
+  slot->logical_types.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    slot->logical_types.push_back(tensor.scalar_type());
+  }
+  slot->tensors = std::move(tensors);
+  std::unique_lock<std::mutex> lock(mutex_);
+  CallerScope caller(this);
+  // The prefetcher being stopped wakes up the producers blocked on a full ring.
+  cv_.wait(lock, [this] { return stopped_ || ring_.size() < depth_; });
+  XLA_CHECK(!stopped_) << "The input prefetcher has been stopped";
+  ring_.push_back(std::move(slot));
+}
+
+std::vector<XLATensor> InputPrefetcher::Dequeue() {
+  std::shared_ptr<Slot> slot;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    CallerScope caller(this);
+    XLA_CHECK(!ring_.empty()) << "No batch has been queued for prefetching";
+    size_t num_ready = 0;
+    for (auto& queued_slot : ring_) {
+      num_ready += queued_slot->ready ? 1 : 0;
+    }
+    XLA_VALUE_METRIC("PrefetchQueueOccupancy", num_ready);
+    if (!ring_.front()->ready) {
+      // The consumer is running ahead of the uploads, so the transfer time is
+      // not being hidden.
+      XLA_COUNTER("PrefetchStall", 1);
+      XLA_TIMED("PrefetchStallTime");
+      cv_.wait(lock, [this] { return stopped_ || ring_.front()->ready; });
+      XLA_CHECK(ring_.front()->ready)
+          << "The input prefetcher has been stopped";
+    }
+    slot = std::move(ring_.front());
+    ring_.pop_front();
+    --num_dispatched_;
+  }
+  if (slot->exptr != nullptr) {
+    std::rethrow_exception(slot->exptr);
+  }
+  std::vector<XLATensor> xla_tensors;
+  xla_tensors.reserve(slot->handles.size());
+  for (size_t i = 0; i < slot->handles.size(); ++i) {
+    xla_tensors.push_back(XLATensor::Create(std::move(slot->handles[i]),
+                                            slot->logical_types[i]));
+  }
+  return xla_tensors;
+}
+
+void InputPrefetcher::Runner() {
+  std::string device = device_.ToString();
+  while (true) {
+    std::shared_ptr<Slot> slot;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock,
+               [this] { return stopped_ || num_dispatched_ < ring_.size(); });
+      if (stopped_) {
+        break;
+      }
+      slot = ring_[num_dispatched_];
+      ++num_dispatched_;
+    }
+    std::vector<xla::ComputationClient::DataPtr> handles;
+    std::exception_ptr exptr;
+    try {
+      handles = CreateTensorsData(slot->tensors, device);
+    } catch (...) {
+      exptr = std::current_exception();
+    }
+    // The host data has been copied into the transfer buffers at this point,
+    // so the staging buffers can go back to the pool.
+    slot->tensors.clear();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      slot->handles = std::move(handles);
+      slot->exptr = std::move(exptr);
+      slot->ready = true;
+    }
+    cv_.notify_all();
+  }
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Uploads batches of host tensors to a device ahead of their use, so that the
+// transfer of the inputs of step N+1 overlaps with the execution of step N.
+// Batches are submitted with Enqueue() from the producer (input pipeline) side,
+// transferred by a dedicated thread, and handed back as XLA tensors, in
+// submission order, by Dequeue(). At most `depth` batches can be in flight at
+// any time; Enqueue() blocks once the ring is full.
+class InputPrefetcher {
+ public:
+  InputPrefetcher(const Device& device, size_t depth);
+
+  // Stops the upload thread, after the upload in progress (if any) completes.
+  // Batches which have not been picked up by the upload thread are dropped, and
+  // the callers blocked in Enqueue() or Dequeue() get an error. Waits for those
+  // callers to have left the prefetcher before returning.
+  ~InputPrefetcher();
+
+  // Copies `num_entries` elements of the given type out of `data` into a pooled
+  // host staging buffer, and returns a tensor backed by it. The staging buffer
+  // goes back to the pool once the returned tensor (and all its copies) are
+  // destroyed, which for prefetched batches happens right after the upload.
+  static at::Tensor Stage(at::ScalarType type, const void* data,
+                          size_t num_entries, std::vector<int64_t> shape);
+
+  // Queues a batch of host tensors for upload. Blocks while the ring is full.
+  void Enqueue(std::vector<at::Tensor> tensors);
+
+  // Returns the device tensors of the oldest batch submitted with Enqueue(),
+  // blocking until its upload has completed. Errors hit while uploading the
+  // batch are rethrown here.
+  std::vector<XLATensor> Dequeue();
+
+  const Device& device() const { return device_; }
+
+ private:
+  struct Slot {
+    std::vector<at::Tensor> tensors;
+    std::vector<at::ScalarType> logical_types;
+    std::vector<xla::ComputationClient::DataPtr> handles;
+    std::exception_ptr exptr;
+    bool ready = false;
+  };
+
+  // Registers a caller of Enqueue() or Dequeue() for its lifetime, during which
+  // the destructor does not tear down the prefetcher. Must be created and
+  // destroyed with mutex_ held.
+  class CallerScope;
+
+  // Main loop of the upload thread.
+  void Runner();
+
+  Device device_;
+  size_t depth_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Slots in submission order. The ones at the front are either uploaded or
+  // being uploaded, while the remaining ones (starting at index
+  // num_dispatched_) are still waiting for the upload thread.
+  std::deque<std::shared_ptr<Slot>> ring_;
+  size_t num_dispatched_ = 0;
+  // Number of live CallerScope instances.
+  size_t num_callers_ = 0;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+}  // namespace swift_xla
@@ -21,6 +21,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 
@@ -76,10 +77,32 @@ std::string GetCurrentScope() {
 ShapeCache* GetShapeCache() {
   static int64_t shape_cache_size =
       xla::sys_util::GetEnvInt("XLA_IR_SHAPE_CACHE_SIZE", 131072);
-  thread_local ShapeCache* cache = new ShapeCache(shape_cache_size);
+  static ShapeCache* cache = new ShapeCache(shape_cache_size);
   return cache;
 }
 
+xla::hash_t ShapeHash(const xla::Shape& shape) {
+  xla::hash_t h = xla::util::Hash(static_cast<int>(shape.element_type()));
+  if (shape.IsTuple()) {
+    for (auto& element_shape : shape.tuple_shapes()) {
+      h = xla::util::HashCombine(h, ShapeHash(element_shape));
+    }
+    return h;
+  }
+  h = xla::util::HashCombine(
+      h, xla::util::DataHash(shape.dimensions().data(),
+                             shape.dimensions().size() * sizeof(int64_t)));
+  if (!shape.is_static()) {
+    h = xla::util::HashCombine(h,
+                               xla::util::Hash(shape.dynamic_dimensions()));
+  }
+  if (shape.has_layout()) {
+    h = xla::util::HashCombine(
+        h, xla::util::Hash(shape.layout().minor_to_major()));
+  }
+  return h;
+}
+
 }  // namespace
 
 size_t Output::Hasher::operator()(const Output& output) const {
@@ -216,10 +239,19 @@ xla::hash_t Node::GetOpHash(OpKind op, const xla::Shape& shape,
 }
 
 xla::Shape Node::GetOpShape(const std::function<xla::Shape()>& shape_fn) const {
+  // The output shape only depends on the op (and its attributes, which are part
+  // of the node hash) and on the operand shapes. Keying the cache on those,
+  // instead of on the full graph hash, lets the same op applied to different
+  // data hit the cache, from any thread.
+  xla::hash_t key = xla::util::HashCombine(node_hash(), num_outputs());
+  for (auto& operand : operands_as_outputs_) {
+    key = xla::util::HashCombine(key, ShapeHash(operand.shape()));
+  }
   ShapeCache* shape_cache = GetShapeCache();
-  auto shape = shape_cache->Get(hash());
+  auto shape = shape_cache->Get(key);
   if (shape == nullptr) {
-    shape = shape_cache->Add(hash(), std::make_shared<xla::Shape>(shape_fn()));
+    XLA_COUNTER("IrShapeCacheMiss", 1);
+    shape = shape_cache->Add(key, std::make_shared<xla::Shape>(shape_fn()));
   }
   return *shape;
 }
@@ -0,0 +1,309 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_optimizer.h"
+
+#include <atomic>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/view.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+std::atomic<bool>* GraphOptimizationEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_IR_OPTIMIZE", false));
+  return enabled;
+}
+
+bool IsScalarValue(const Output& output, double value) {
+  const ops::Scalar* scalar = dynamic_cast<const ops::Scalar*>(output.node);
+  if (scalar == nullptr) {
+    return false;
+  }
+  const at::Scalar& scalar_value = scalar->value();
+  if (scalar_value.isFloatingPoint()) {
+    return scalar_value.toDouble() == value;
+  }
+  return scalar_value.isIntegral() &&
+         scalar_value.toLong() == static_cast<int64_t>(value);
+}
+
+// Returns the type the given cast node really converts to, which differs from
+// its logical type for the tensor types without a native XLA counterpart.
+xla::PrimitiveType CastRawType(const ops::Cast* cast) {
+  return cast->dtype() ? TensorTypeToRawXlaType(*cast->dtype()) : cast->type();
+}
+
+// Whether converting from type to wider_type and back is the identity.
+bool IsLosslessWidening(xla::PrimitiveType type,
+                        xla::PrimitiveType wider_type) {
+  if (type == wider_type) {
+    return true;
+  }
+  int bit_width = xla::primitive_util::BitWidth(type);
+  int wider_bit_width = xla::primitive_util::BitWidth(wider_type);
+  if (xla::primitive_util::IsFloatingPointType(type)) {
+    // BF16 and F16 have the same width, but neither of them contains the
+    // other, so the wider type must be strictly wider.
+    return xla::primitive_util::IsFloatingPointType(wider_type) &&
+           wider_bit_width > bit_width;
+  }
+  if (xla::primitive_util::IsSignedIntegralType(type)) {
+    return xla::primitive_util::IsSignedIntegralType(wider_type) &&
+           wider_bit_width > bit_width;
+  }
+  if (xla::primitive_util::IsUnsignedIntegralType(type)) {
+    return xla::primitive_util::IsIntegralType(wider_type) &&
+           (xla::primitive_util::IsUnsignedIntegralType(wider_type)
+                ? wider_bit_width > bit_width
+                : wider_bit_width > bit_width + 1);
+  }
+  return false;
+}
+
+bool IsCseCandidate(const Node* node) {
+  if (node->operands().empty()) {
+    // Leaves like device data hash by shape only, so they cannot be merged.
+    return dynamic_cast<const ops::Scalar*>(node) != nullptr;
+  }
+  return node->op() != ops::xla_cross_replica_sum &&
+         node->op() != ops::xla_all_to_all &&
+         node->op() != ops::xla_collective_permute &&
+         node->op() != ops::xla_token;
+}
+
+bool IsSameNode(const Node* node1, const Node* node2) {
+  return node1->op() == node2->op() &&
+         node1->node_hash() == node2->node_hash() &&
+         node1->num_outputs() == node2->num_outputs() &&
+         node1->operands() == node2->operands() &&
+         xla::ShapeUtil::Equal(node1->shape(), node2->shape());
+}
+
+class GraphOptimizer {
+ public:
+  std::vector<Value> Run(absl::Span<const Value> roots) {
+    std::vector<const Node*> root_nodes;
+    for (auto& root : roots) {
+      root_nodes.push_back(root.node.get());
+    }
+    std::vector<const Node*> post_order = Util::ComputePostOrder(root_nodes);
+    // The post-order only holds raw pointers, while cloning needs the owning
+    // references, which are held by the users of each node.
+    absl::flat_hash_map<const Node*, NodePtr> node_ptrs;
+    for (auto& root : roots) {
+      node_ptrs.emplace(root.node.get(), root.node);
+    }
+    for (auto node : post_order) {
+      for (auto& operand : node->operand_nodes()) {
+        node_ptrs.emplace(operand.get(), operand);
+      }
+    }
+    for (auto node : post_order) {
+      Process(node, node_ptrs.at(node));
+    }
+
+    std::vector<Value> optimized_roots;
+    std::vector<const Node*> optimized_root_nodes;
+    for (auto& root : roots) {
+      optimized_roots.push_back(MapOutput(root));
+      optimized_root_nodes.push_back(optimized_roots.back().node.get());
+    }
+    size_t optimized_size = Util::GetGraphSize(optimized_root_nodes);
+    if (optimized_size < post_order.size()) {
+      size_t removed = post_order.size() - optimized_size;
+      XLA_COUNTER("IrOptimizerNodesRemoved", removed);
+      XLA_VALUE_METRIC("IrOptimizerNodeReduction",
+                       static_cast<double>(removed) / post_order.size());
+    }
+    return optimized_roots;
+  }
+
+ private:
+  // Maps an output of the original graph to the value replacing it.
+  // The multi-output nodes are never simplified, so they map to themselves or
+  // to a clone, which keeps the output indices. The single output nodes can be
+  // simplified to any output of another node.
+  Value MapOutput(const Output& output) const {
+    const Value& value = node_map_.at(output.node);
+    if (output.node->num_outputs() > 1) {
+      return Value(value.node, output.index);
+    }
+    XLA_CHECK_EQ(output.index, 0);
+    return value;
+  }
+
+  void Process(const Node* node, const NodePtr& node_ptr) {
+    std::vector<Value> operands;
+    bool changed = false;
+    for (auto& operand : node->operands()) {
+      operands.push_back(MapOutput(operand));
+      changed = changed || operands.back().node.get() != operand.node ||
+                operands.back().index != operand.index;
+    }
+    NodePtr current = changed ? node->Clone(operands) : node_ptr;
+    Value replacement;
+    if (current->num_outputs() == 1) {
+      replacement = Simplify(current);
+    }
+    if (replacement) {
+      XLA_COUNTER("IrOptimizerSimplified", 1);
+      node_map_.emplace(node, std::move(replacement));
+    } else {
+      node_map_.emplace(node, Value(Deduplicate(std::move(current))));
+    }
+  }
+
+  NodePtr Deduplicate(NodePtr node) {
+    if (!IsCseCandidate(node.get())) {
+      return node;
+    }
+    std::vector<NodePtr>& candidates = cse_map_[node->hash()];
+    for (auto& candidate : candidates) {
+      if (IsSameNode(candidate.get(), node.get())) {
+        XLA_COUNTER("IrOptimizerCse", 1);
+        return candidate;
+      }
+    }
+    candidates.push_back(node);
+    return node;
+  }
+
+  // Returns the value the single output node can be replaced with, or an empty
+  // value if no rewrite applies.
+  Value Simplify(const NodePtr& node) const {
+    const xla::Shape& shape = node->shape();
+    auto same_shape = [&](const Output& output) {
+      return xla::ShapeUtil::Equal(output.shape(), shape);
+    };
+    if (node->op() == OpKind(at::aten::mul) ||
+        node->op() == OpKind(at::aten::add)) {
+      double identity = node->op() == OpKind(at::aten::mul) ? 1 : 0;
+      for (size_t i = 0; i < 2; ++i) {
+        const Output& other = node->operand(1 - i);
+        if (IsScalarValue(node->operand(i), identity) && same_shape(other)) {
+          return Value(node->operand_nodes().at(1 - i), other.index);
+        }
+      }
+    } else if (node->op() == OpKind(at::aten::div) ||
+               node->op() == OpKind(at::aten::sub)) {
+      double identity = node->op() == OpKind(at::aten::div) ? 1 : 0;
+      if (IsScalarValue(node->operand(1), identity) &&
+          same_shape(node->operand(0))) {
+        return Value(node->operand_nodes().at(0), node->operand(0).index);
+      }
+    } else if (node->op() == OpKind(at::aten::view)) {
+      return SimplifyChain<ops::View>(node, [](const ops::View* view) {
+        return view->output_size();
+      });
+    } else if (node->op() == OpKind(at::aten::expand)) {
+      return SimplifyChain<ops::Expand>(
+          node, [](const ops::Expand* expand) { return expand->size(); });
+    } else if (node->op() == ops::xla_cast) {
+      return SimplifyCast(node);
+    }
+    return Value();
+  }
+
+  // Removes the identity views and expands, and folds the chains of them into
+  // a single node over the input of the chain.
+  template <typename T, typename F>
+  Value SimplifyChain(const NodePtr& node, const F& get_size) const {
+    const Value input(node->operand_nodes().at(0), node->operand(0).index);
+    if (xla::ShapeUtil::Equal(input.shape(), node->shape())) {
+      return input;
+    }
+    if (input->op() != node->op() || !node->shape().is_static()) {
+      return Value();
+    }
+    const Value chain_input(input->operand_nodes().at(0),
+                            input->operand(0).index);
+    if (!chain_input.shape().is_static()) {
+      return Value();
+    }
+    NodePtr folded = MakeNode<T>(
+        chain_input, get_size(NodeCast<T>(node.get(), node->op())));
+    if (!xla::ShapeUtil::Equal(folded->shape(), node->shape())) {
+      return Value();
+    }
+    return Value(folded);
+  }
+
+  Value SimplifyCast(const NodePtr& node) const {
+    const ops::Cast* cast = NodeCast<ops::Cast>(node.get(), ops::xla_cast);
+    const Value input(node->operand_nodes().at(0), node->operand(0).index);
+    xla::PrimitiveType input_type = input.shape().element_type();
+    if (CastRawType(cast) != cast->type()) {
+      return Value();
+    }
+    if (input_type == cast->type()) {
+      return input;
+    }
+    const ops::Cast* input_cast =
+        NodeCast<ops::Cast>(input.node.get(), ops::xla_cast);
+    if (input_cast == nullptr ||
+        CastRawType(input_cast) != input_cast->type()) {
+      return Value();
+    }
+    const Value chain_input(input->operand_nodes().at(0),
+                            input->operand(0).index);
+    xla::PrimitiveType chain_input_type = chain_input.shape().element_type();
+    if (!IsLosslessWidening(chain_input_type, input_cast->type())) {
+      return Value();
+    }
+    if (chain_input_type == cast->type()) {
+      return chain_input;
+    }
+    return Value(cast->dtype()
+                     ? MakeNode<ops::Cast>(chain_input, *cast->dtype())
+                     : MakeNode<ops::Cast>(chain_input, cast->type()));
+  }
+
+  absl::flat_hash_map<const Node*, Value> node_map_;
+  absl::flat_hash_map<xla::hash_t, std::vector<NodePtr>,
+                      xla::util::HashReducer>
+      cse_map_;
+};
+
+}  // namespace
+
+bool IsGraphOptimizationEnabled() {
+  return GraphOptimizationEnabled()->load();
+}
+
+void SetGraphOptimizationEnabled(bool enabled) {
+  GraphOptimizationEnabled()->store(enabled);
+}
+
+std::vector<Value> OptimizeGraph(absl::Span<const Value> roots) {
+  return GraphOptimizer().Run(roots);
+}
+
+}  // namespace ir
+}  // namespace swift_xla
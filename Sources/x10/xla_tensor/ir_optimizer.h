@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Rewrites the IR graph rooted at the given values, and returns the new roots
+// (one per input root, with the same shapes). The pass performs:
+//  - Common subexpression elimination, merging the nodes with the same op,
+//    attributes and operands.
+//  - Removal of the multiplications/divisions by one and the additions/
+//    subtractions of zero, when they do not change the shape of the result.
+//  - Removal of identity views, expands and casts, and folding of chains of
+//    views, of expands, and of losslessly widening casts.
+// Nodes are never modified in place: the parts of the graph which are affected
+// by a rewrite are cloned, while the rest is shared with the input graph.
+std::vector<Value> OptimizeGraph(absl::Span<const Value> roots);
+
+// Whether the step graphs get optimized before being compiled. Defaults to the
+// XLA_IR_OPTIMIZE environment variable.
+bool IsGraphOptimizationEnabled();
+
+void SetGraphOptimizationEnabled(bool enabled);
+
+}  // namespace ir
+}  // namespace swift_xla
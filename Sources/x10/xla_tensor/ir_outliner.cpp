@@ -0,0 +1,484 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_outliner.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/outlined_call.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+// The depth of the operand trees whose structure must match for two nodes to
+// be considered as the seeds of two copies of the same subgraph.
+constexpr int kSeedHashDepth = 3;
+
+std::atomic<bool>* GraphOutliningEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_IR_OUTLINE", false));
+  return enabled;
+}
+
+bool IsOutlinable(const Node* node) {
+  if (node->operands().empty()) {
+    // Device data must be passed to the outlined computation as an input,
+    // while constants can be embedded within it.
+    return node->op() == OpKind(at::prim::Constant);
+  }
+  return node->op() != ops::xla_cross_replica_sum &&
+         node->op() != ops::xla_all_to_all &&
+         node->op() != ops::xla_collective_permute &&
+         node->op() != ops::xla_token;
+}
+
+// One copy of a repeated subgraph.
+struct Instance {
+  // The nodes of the copy. Nodes at the same position within the copies of a
+  // group are structurally identical, and wired in the same way.
+  std::vector<const Node*> nodes;
+  // The outputs of other nodes used by the copy.
+  std::vector<Output> inputs;
+};
+
+struct Group {
+  std::vector<Instance> instances;
+  // The (position, output index) pairs of the outputs used outside of any of
+  // the copies, which become the outputs of the calls.
+  std::vector<std::pair<size_t, size_t>> exports;
+  xla::hash_t hash = 0;
+  bool dropped = false;
+};
+
+struct RegionRef {
+  size_t group = 0;
+  size_t instance = 0;
+};
+
+// Maps the nodes claimed while growing the copies of a group to their
+// (instance, position) pair.
+using ClaimMap = absl::flat_hash_map<const Node*, std::pair<size_t, size_t>>;
+
+class SubgraphOutliner {
+ public:
+  SubgraphOutliner(absl::Span<const Value> roots, size_t min_nodes)
+      : roots_(roots), min_nodes_(min_nodes) {}
+
+  std::vector<Value> Run() {
+    std::vector<const Node*> root_nodes;
+    for (auto& root : roots_) {
+      root_nodes.push_back(root.node.get());
+      root_nodes_.insert(root.node.get());
+      node_ptrs_.emplace(root.node.get(), root.node);
+    }
+    post_order_ = Util::ComputePostOrder(root_nodes);
+    for (auto node : post_order_) {
+      for (size_t i = 0; i < node->operands().size(); ++i) {
+        const Node* operand = node->operand(i).node;
+        node_ptrs_.emplace(operand, node->operand_nodes()[i]);
+        users_[operand].push_back(node);
+      }
+    }
+    ComputeHashes();
+    FindGroups();
+    if (groups_.empty()) {
+      return std::vector<Value>(roots_.begin(), roots_.end());
+    }
+    std::vector<const Node*> order;
+    while (!ComputeUnitOrder(&order)) {
+    }
+    return Rewrite(order);
+  }
+
+ private:
+  void ComputeHashes() {
+    for (auto node : post_order_) {
+      xla::hash_t hash = xla::util::MHash(node->node_hash(),
+                                          node->num_outputs(),
+                                          node->operands().size());
+      for (auto& operand : node->operands()) {
+        hash = xla::util::HashCombine(hash, xla::util::Hash(operand.index));
+      }
+      local_hashes_[node] = hash;
+    }
+    absl::flat_hash_map<const Node*, xla::hash_t> hashes = local_hashes_;
+    for (int depth = 0; depth < kSeedHashDepth; ++depth) {
+      absl::flat_hash_map<const Node*, xla::hash_t> deeper_hashes;
+      for (auto node : post_order_) {
+        xla::hash_t hash = local_hashes_.at(node);
+        for (auto& operand : node->operands()) {
+          hash = xla::util::HashCombine(hash, hashes.at(operand.node));
+        }
+        deeper_hashes[node] = hash;
+      }
+      hashes = std::move(deeper_hashes);
+    }
+    seed_hashes_ = std::move(hashes);
+  }
+
+  void FindGroups() {
+    absl::flat_hash_map<xla::hash_t, std::vector<const Node*>,
+                        xla::util::HashReducer>
+        candidates;
+    for (auto node : post_order_) {
+      if (!node->operands().empty() && IsOutlinable(node)) {
+        candidates[seed_hashes_.at(node)].push_back(node);
+      }
+    }
+    // Seeding from the nodes closest to the roots first, the copies grow
+    // backwards over whole repeated blocks, rather than over their tails only.
+    for (auto it = post_order_.rbegin(); it != post_order_.rend(); ++it) {
+      auto cit = candidates.find(seed_hashes_.at(*it));
+      if (cit == candidates.end()) {
+        continue;
+      }
+      std::vector<const Node*> seeds;
+      for (auto node : cit->second) {
+        if (regions_.count(node) == 0) {
+          seeds.push_back(node);
+        }
+      }
+      candidates.erase(cit);
+      if (seeds.size() > 1) {
+        GrowGroup(seeds);
+      }
+    }
+  }
+
+  // Grows the copies from the seeds towards their operands, in lockstep: an
+  // operand is added to the copies only if it can be added to all of them.
+  void GrowGroup(const std::vector<const Node*>& seeds) {
+    Group group;
+    group.instances.resize(seeds.size());
+    ClaimMap claims;
+    for (size_t j = 0; j < seeds.size(); ++j) {
+      group.instances[j].nodes.push_back(seeds[j]);
+      claims.emplace(seeds[j], std::make_pair(j, 0));
+    }
+    std::vector<const Node*> candidates(seeds.size());
+    absl::flat_hash_set<const Node*> unique_candidates;
+    for (size_t p = 0; p < group.instances[0].nodes.size(); ++p) {
+      size_t num_operands = group.instances[0].nodes[p]->operands().size();
+      for (size_t i = 0; i < num_operands; ++i) {
+        unique_candidates.clear();
+        bool matched = true;
+        for (size_t j = 0; j < seeds.size() && matched; ++j) {
+          candidates[j] = group.instances[j].nodes[p]->operand(i).node;
+          matched = IsOutlinable(candidates[j]) &&
+                    regions_.count(candidates[j]) == 0 &&
+                    claims.count(candidates[j]) == 0 &&
+                    unique_candidates.insert(candidates[j]).second &&
+                    local_hashes_.at(candidates[j]) ==
+                        local_hashes_.at(candidates[0]);
+        }
+        if (matched) {
+          size_t position = group.instances[0].nodes.size();
+          for (size_t j = 0; j < seeds.size(); ++j) {
+            group.instances[j].nodes.push_back(candidates[j]);
+            claims.emplace(candidates[j], std::make_pair(j, position));
+          }
+        }
+      }
+    }
+    if (group.instances[0].nodes.size() < min_nodes_ ||
+        !FinalizeGroup(claims, &group)) {
+      return;
+    }
+    for (size_t j = 0; j < group.instances.size(); ++j) {
+      for (auto node : group.instances[j].nodes) {
+        regions_.emplace(node, RegionRef{groups_.size(), j});
+      }
+    }
+    groups_.push_back(std::move(group));
+  }
+
+  // Computes the inputs and the outputs of the copies, and verifies that all
+  // the copies are wired in the same way, so that they can share one body.
+  bool FinalizeGroup(const ClaimMap& claims, Group* group) const {
+    std::vector<int64_t> base_wiring;
+    std::set<std::pair<size_t, size_t>> exports;
+    for (size_t j = 0; j < group->instances.size(); ++j) {
+      Instance& instance = group->instances[j];
+      absl::flat_hash_map<Output, size_t, Output::Hasher> input_ids;
+      // Internal operands are recorded by position, inputs by negative ID.
+      std::vector<int64_t> wiring;
+      for (size_t p = 0; p < instance.nodes.size(); ++p) {
+        const Node* node = instance.nodes[p];
+        for (auto& operand : node->operands()) {
+          auto it = claims.find(operand.node);
+          if (it != claims.end() && it->second.first == j) {
+            wiring.push_back(static_cast<int64_t>(it->second.second));
+            continue;
+          }
+          auto id = input_ids.emplace(operand, instance.inputs.size());
+          if (id.second) {
+            instance.inputs.push_back(operand);
+          }
+          wiring.push_back(-1 - static_cast<int64_t>(id.first->second));
+        }
+        if (IsUsedOutside(node, j, claims)) {
+          for (size_t k = 0; k < node->num_outputs(); ++k) {
+            exports.emplace(p, k);
+          }
+        }
+      }
+      if (j == 0) {
+        base_wiring = std::move(wiring);
+        continue;
+      }
+      if (wiring != base_wiring) {
+        return false;
+      }
+      for (size_t k = 0; k < instance.inputs.size(); ++k) {
+        if (!xla::ShapeUtil::Equal(instance.inputs[k].shape(),
+                                   group->instances[0].inputs[k].shape())) {
+          return false;
+        }
+      }
+    }
+    group->exports.assign(exports.begin(), exports.end());
+
+    const Instance& base = group->instances[0];
+    xla::hash_t hash = xla::util::MHash(base_wiring, group->exports);
+    for (auto node : base.nodes) {
+      hash = xla::util::HashCombine(hash, local_hashes_.at(node));
+    }
+    for (auto& input : base.inputs) {
+      hash = xla::util::HashCombine(hash, xla::util::ShapeHash(input.shape()));
+    }
+    group->hash = hash;
+    return true;
+  }
+
+  bool IsUsedOutside(const Node* node, size_t instance,
+                     const ClaimMap& claims) const {
+    if (root_nodes_.count(node) > 0) {
+      return true;
+    }
+    auto it = users_.find(node);
+    if (it == users_.end()) {
+      return false;
+    }
+    for (auto user : it->second) {
+      auto cit = claims.find(user);
+      if (cit == claims.end() || cit->second.first != instance) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const Instance* InstanceOf(const Node* node) const {
+    auto it = regions_.find(node);
+    if (it == regions_.end() || groups_[it->second.group].dropped) {
+      return nullptr;
+    }
+    return &groups_[it->second.group].instances[it->second.instance];
+  }
+
+  // Returns the unit of scheduling of the given node, which is the seed of its
+  // copy for outlined nodes, and the node itself otherwise.
+  const Node* UnitOf(const Node* node) const {
+    const Instance* instance = InstanceOf(node);
+    return instance != nullptr ? instance->nodes.front() : node;
+  }
+
+  std::vector<const Node*> UnitOperands(const Node* unit) const {
+    std::vector<const Node*> operands;
+    const Instance* instance = InstanceOf(unit);
+    if (instance != nullptr) {
+      for (auto& input : instance->inputs) {
+        operands.push_back(UnitOf(input.node));
+      }
+    } else {
+      for (auto& operand : unit->operands()) {
+        operands.push_back(UnitOf(operand.node));
+      }
+    }
+    return operands;
+  }
+
+  // Computes the post-order of the graph where every copy is collapsed into a
+  // single unit. Collapsing can introduce loops, in which case the group of
+  // one of the copies within the loop is dropped, and false is returned.
+  bool ComputeUnitOrder(std::vector<const Node*>* order) {
+    struct Frame {
+      const Node* unit;
+      std::vector<const Node*> operands;
+      size_t next;
+    };
+    order->clear();
+    absl::flat_hash_map<const Node*, size_t> emitting;
+    absl::flat_hash_set<const Node*> emitted;
+    std::vector<Frame> stack;
+    for (auto& root : roots_) {
+      const Node* root_unit = UnitOf(root.node.get());
+      if (emitted.count(root_unit) > 0) {
+        continue;
+      }
+      emitting.emplace(root_unit, stack.size());
+      stack.push_back({root_unit, UnitOperands(root_unit), 0});
+      while (!stack.empty()) {
+        Frame& frame = stack.back();
+        if (frame.next == frame.operands.size()) {
+          emitting.erase(frame.unit);
+          emitted.insert(frame.unit);
+          order->push_back(frame.unit);
+          stack.pop_back();
+          continue;
+        }
+        const Node* operand = frame.operands[frame.next++];
+        if (emitted.count(operand) > 0) {
+          continue;
+        }
+        auto it = emitting.find(operand);
+        if (it != emitting.end()) {
+          DropGroupInLoop(stack, it->second);
+          return false;
+        }
+        emitting.emplace(operand, stack.size());
+        stack.push_back({operand, UnitOperands(operand), 0});
+      }
+    }
+    return true;
+  }
+
+  template <typename T>
+  void DropGroupInLoop(const std::vector<T>& stack, size_t loop_start) {
+    for (size_t i = loop_start; i < stack.size(); ++i) {
+      auto it = regions_.find(stack[i].unit);
+      if (it != regions_.end() && !groups_[it->second.group].dropped) {
+        XLA_COUNTER("IrOutlineDroppedGroups", 1);
+        groups_[it->second.group].dropped = true;
+        return;
+      }
+    }
+    XLA_ERROR() << "Graph loop found at " << *stack[loop_start].unit;
+  }
+
+  std::shared_ptr<ops::OutlinedBody> MakeBody(const Group& group) const {
+    auto body = std::make_shared<ops::OutlinedBody>();
+    const Instance& base = group.instances[0];
+    body->hash = group.hash;
+    for (auto& input : base.inputs) {
+      body->inputs.emplace_back(node_ptrs_.at(input.node), input.index);
+    }
+    for (auto& output : group.exports) {
+      body->outputs.emplace_back(node_ptrs_.at(base.nodes[output.first]),
+                                 output.second);
+    }
+    body->num_nodes = base.nodes.size();
+    return body;
+  }
+
+  Value MapOutput(const Output& output) const {
+    if (InstanceOf(output.node) != nullptr) {
+      return exported_outputs_.at(output);
+    }
+    return Value(node_map_.at(output.node), output.index);
+  }
+
+  std::vector<Value> Rewrite(absl::Span<const Node* const> order) {
+    std::vector<std::shared_ptr<ops::OutlinedBody>> bodies(groups_.size());
+    for (size_t g = 0; g < groups_.size(); ++g) {
+      if (!groups_[g].dropped) {
+        bodies[g] = MakeBody(groups_[g]);
+      }
+    }
+    size_t num_calls = 0;
+    size_t num_outlined_nodes = 0;
+    for (auto unit : order) {
+      std::vector<Value> operands;
+      const Instance* instance = InstanceOf(unit);
+      if (instance != nullptr) {
+        const RegionRef& region = regions_.at(unit);
+        const Group& group = groups_[region.group];
+        for (auto& input : instance->inputs) {
+          operands.push_back(MapOutput(input));
+        }
+        NodePtr call =
+            MakeNode<ops::OutlinedCall>(operands, bodies[region.group]);
+        for (size_t k = 0; k < group.exports.size(); ++k) {
+          const Node* node = instance->nodes[group.exports[k].first];
+          exported_outputs_.emplace(Output(node, group.exports[k].second),
+                                    Value(call, k));
+        }
+        num_calls += 1;
+        num_outlined_nodes += instance->nodes.size();
+        continue;
+      }
+      bool changed = false;
+      for (auto& operand : unit->operands()) {
+        operands.push_back(MapOutput(operand));
+        changed = changed || operands.back().node.get() != operand.node ||
+                  operands.back().index != operand.index;
+      }
+      node_map_.emplace(unit,
+                        changed ? unit->Clone(operands) : node_ptrs_.at(unit));
+    }
+    if (num_calls > 0) {
+      XLA_COUNTER("IrOutlinedCalls", num_calls);
+      XLA_COUNTER("IrOutlinedNodes", num_outlined_nodes);
+    }
+
+    std::vector<Value> outlined_roots;
+    for (auto& root : roots_) {
+      outlined_roots.push_back(MapOutput(root));
+    }
+    return outlined_roots;
+  }
+
+  absl::Span<const Value> roots_;
+  size_t min_nodes_;
+  std::vector<const Node*> post_order_;
+  absl::flat_hash_set<const Node*> root_nodes_;
+  absl::flat_hash_map<const Node*, NodePtr> node_ptrs_;
+  absl::flat_hash_map<const Node*, std::vector<const Node*>> users_;
+  absl::flat_hash_map<const Node*, xla::hash_t> local_hashes_;
+  absl::flat_hash_map<const Node*, xla::hash_t> seed_hashes_;
+  absl::flat_hash_map<const Node*, RegionRef> regions_;
+  std::vector<Group> groups_;
+  absl::flat_hash_map<const Node*, NodePtr> node_map_;
+  OutputMap<Value> exported_outputs_;
+};
+
+}  // namespace
+
+bool IsGraphOutliningEnabled() { return GraphOutliningEnabled()->load(); }
+
+void SetGraphOutliningEnabled(bool enabled) {
+  GraphOutliningEnabled()->store(enabled);
+}
+
+std::vector<Value> OutlineRepeatedSubgraphs(absl::Span<const Value> roots,
+                                            size_t min_nodes) {
+  return SubgraphOutliner(roots, min_nodes).Run();
+}
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Finds the subgraphs which are repeated within the graph rooted at the given
+// values (like the layers of a deep model), and replaces each copy with an
+// ops::OutlinedCall node, so that the subgraph gets lowered only once. Copies
+// are matched structurally, so they can differ in their inputs (typically the
+// device data holding the weights). Only subgraphs with at least min_nodes
+// nodes are outlined. Returns the new roots, one per input root.
+std::vector<Value> OutlineRepeatedSubgraphs(absl::Span<const Value> roots,
+                                            size_t min_nodes);
+
+// Whether the step graphs get outlined before being compiled. Defaults to the
+// XLA_IR_OUTLINE environment variable.
+bool IsGraphOutliningEnabled();
+
+void SetGraphOutliningEnabled(bool enabled);
+
+}  // namespace ir
+}  // namespace swift_xla
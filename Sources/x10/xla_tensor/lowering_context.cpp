@@ -165,6 +165,16 @@ XlaOpVector LoweringContext::LowerNode(const Node* node) {
   return result_ops;
 }
 
+const xla::XlaComputation& LoweringContext::GetSubComputation(
+    const xla::hash_t& hash,
+    const std::function<xla::XlaComputation()>& build_fn) {
+  auto it = sub_computations_.find(hash);
+  if (it == sub_computations_.end()) {
+    it = sub_computations_.emplace(hash, build_fn()).first;
+  }
+  return it->second;
+}
+
 void LoweringContext::ReportBuilderError(const Node* node,
                                          const char* error_msg) {
   std::stringstream ss;
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -25,6 +26,7 @@
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
@@ -88,6 +90,13 @@ class LoweringContext {
   // before calling this API. Returns the generated XLA operations.
   XlaOpVector LowerNode(const Node* node);
 
+  // Returns the computation registered with the given hash, building it with
+  // build_fn the first time. This allows structurally identical subgraphs to
+  // be emitted once, and then invoked multiple times.
+  const xla::XlaComputation& GetSubComputation(
+      const xla::hash_t& hash,
+      const std::function<xla::XlaComputation()>& build_fn);
+
   size_t GetEmittedNodeCount() const { return emit_status_.size(); }
 
  private:
@@ -109,6 +118,8 @@ class LoweringContext {
   std::vector<xla::XlaOp> root_tuple_;
   OutputMap<xla::XlaOp> emitted_outputs_;
   Util::EmissionMap emit_status_;
+  std::unordered_map<xla::hash_t, xla::XlaComputation, xla::util::HashReducer>
+      sub_computations_;
 };
 
 class RootLoweringContext : public LoweringContext {
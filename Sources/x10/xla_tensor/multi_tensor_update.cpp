@@ -0,0 +1,164 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/multi_tensor_update.h"
+
+#include <functional>
+#include <map>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+// Computes the updated tensors (the outputs) of a single tensor, out of its
+// weight, gradient and states (the operands).
+using UpdateFn =
+    std::function<std::vector<xla::XlaOp>(absl::Span<const xla::XlaOp>)>;
+
+void UpdateInPlace(absl::Span<const std::vector<xla::XlaOp>> inputs,
+                   size_t index, const UpdateFn& update_fn,
+                   std::vector<xla::XlaOp>* results) {
+  size_t num_tensors = inputs.front().size();
+  std::vector<xla::XlaOp> operands;
+  operands.reserve(inputs.size());
+  for (auto& input : inputs) {
+    operands.push_back(input[index]);
+  }
+  std::vector<xla::XlaOp> outputs = update_fn(operands);
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    (*results)[i * num_tensors + index] = outputs[i];
+  }
+}
+
+void UpdateConcatenated(absl::Span<const std::vector<xla::XlaOp>> inputs,
+                        absl::Span<const size_t> indices,
+                        const UpdateFn& update_fn,
+                        std::vector<xla::XlaOp>* results) {
+  size_t num_tensors = inputs.front().size();
+  xla::XlaBuilder* builder = inputs.front()[indices.front()].builder();
+  std::vector<xla::XlaOp> operands;
+  operands.reserve(inputs.size());
+  for (auto& input : inputs) {
+    std::vector<xla::XlaOp> parts;
+    parts.reserve(indices.size());
+    for (auto index : indices) {
+      parts.push_back(XlaHelpers::Flatten(input[index]));
+    }
+    operands.push_back(xla::ConcatInDim(builder, parts, 0));
+  }
+  std::vector<xla::XlaOp> outputs = update_fn(operands);
+  int64_t offset = 0;
+  for (auto index : indices) {
+    const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(inputs[0][index]);
+    int64_t num_elements = xla::ShapeUtil::ElementsIn(shape);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      (*results)[i * num_tensors + index] = xla::Reshape(
+          xla::SliceInDim(outputs[i], offset, offset + num_elements,
+                          /*stride=*/1, /*dimno=*/0),
+          shape.dimensions());
+    }
+    offset += num_elements;
+  }
+}
+
+// Applies update_fn to the tensors of the inputs lists, and returns its
+// outputs for all the tensors, grouped by output.
+std::vector<xla::XlaOp> BuildMultiTensorUpdate(
+    absl::Span<const std::vector<xla::XlaOp>> inputs, size_t num_outputs,
+    const UpdateFn& update_fn) {
+  static const int64_t kConcatMaxElements = xla::sys_util::GetEnvInt(
+      "XLA_MULTI_TENSOR_CONCAT_ELEMENTS", 65536);
+  size_t num_tensors = inputs.front().size();
+  std::vector<xla::XlaOp> results(num_outputs * num_tensors);
+  std::map<xla::PrimitiveType, std::vector<size_t>> concat_groups;
+  for (size_t i = 0; i < num_tensors; ++i) {
+    const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(inputs[0][i]);
+    if (shape.is_static() &&
+        xla::ShapeUtil::ElementsIn(shape) <= kConcatMaxElements) {
+      concat_groups[shape.element_type()].push_back(i);
+    } else {
+      UpdateInPlace(inputs, i, update_fn, &results);
+    }
+  }
+  for (auto& type_indices : concat_groups) {
+    if (type_indices.second.size() == 1) {
+      UpdateInPlace(inputs, type_indices.second.front(), update_fn, &results);
+    } else {
+      UpdateConcatenated(inputs, type_indices.second, update_fn, &results);
+    }
+  }
+  return results;
+}
+
+}  // namespace
+
+std::vector<xla::XlaOp> BuildMultiTensorSgd(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> velocities, xla::XlaOp learning_rate,
+    xla::XlaOp momentum, xla::XlaOp weight_decay, bool nesterov) {
+  auto update_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> std::vector<xla::XlaOp> {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(operands[0]);
+    xla::XlaOp lr = xla::ConvertElementType(learning_rate, type);
+    xla::XlaOp mom = xla::ConvertElementType(momentum, type);
+    xla::XlaOp wd = xla::ConvertElementType(weight_decay, type);
+    xla::XlaOp grad = operands[1] + wd * operands[0];
+    xla::XlaOp velocity = mom * operands[2] - lr * grad;
+    xla::XlaOp step = nesterov ? mom * velocity - lr * grad : velocity;
+    return {operands[0] + step, velocity};
+  };
+  std::vector<std::vector<xla::XlaOp>> inputs = {
+      {weights.begin(), weights.end()},
+      {grads.begin(), grads.end()},
+      {velocities.begin(), velocities.end()}};
+  return BuildMultiTensorUpdate(inputs, /*num_outputs=*/2, update_fn);
+}
+
+std::vector<xla::XlaOp> BuildMultiTensorAdam(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> first_moments,
+    absl::Span<const xla::XlaOp> second_moments, xla::XlaOp learning_rate,
+    xla::XlaOp beta1, xla::XlaOp beta2, xla::XlaOp weight_decay,
+    double epsilon) {
+  auto update_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> std::vector<xla::XlaOp> {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(operands[0]);
+    xla::XlaBuilder* builder = operands[0].builder();
+    xla::XlaOp one = XlaHelpers::ScalarValue<float>(1, type, builder);
+    xla::XlaOp eps = XlaHelpers::ScalarValue(epsilon, type, builder);
+    xla::XlaOp lr = xla::ConvertElementType(learning_rate, type);
+    xla::XlaOp b1 = xla::ConvertElementType(beta1, type);
+    xla::XlaOp b2 = xla::ConvertElementType(beta2, type);
+    xla::XlaOp wd = xla::ConvertElementType(weight_decay, type);
+    const xla::XlaOp& weight = operands[0];
+    const xla::XlaOp& grad = operands[1];
+    xla::XlaOp first_moment = b1 * operands[2] + (one - b1) * grad;
+    xla::XlaOp second_moment = b2 * operands[3] + (one - b2) * grad * grad;
+    xla::XlaOp update =
+        first_moment / (xla::Sqrt(second_moment) + eps) + wd * weight;
+    return {weight - lr * update, first_moment, second_moment};
+  };
+  std::vector<std::vector<xla::XlaOp>> inputs = {
+      {weights.begin(), weights.end()},
+      {grads.begin(), grads.end()},
+      {first_moments.begin(), first_moments.end()},
+      {second_moments.begin(), second_moments.end()}};
+  return BuildMultiTensorUpdate(inputs, /*num_outputs=*/3, update_fn);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// Fused optimizer updates over groups of weights, in the formulation of the
+// x10 optimizers. The weights, gradients and optimizer states lists hold
+// tensors of the same shapes, and the hyperparameters are scalars. The small
+// tensors are updated together, as a single concatenated vector per element
+// type (XLA_MULTI_TENSOR_CONCAT_ELEMENTS elements at most per tensor, 65536 by
+// default), and the others in place.
+
+// SGD with momentum:
+//   grad = grad + weight_decay * weight
+//   velocity = momentum * velocity - learning_rate * grad
+//   step = nesterov ? momentum * velocity - learning_rate * grad : velocity
+//   weight = weight + step
+// Returns the updated weights, followed by the updated velocities.
+std::vector<xla::XlaOp> BuildMultiTensorSgd(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> velocities, xla::XlaOp learning_rate,
+    xla::XlaOp momentum, xla::XlaOp weight_decay, bool nesterov);
+
+// Adam with decoupled weight decay:
+//   first_moment = beta1 * first_moment + (1 - beta1) * grad
+//   second_moment = beta2 * second_moment + (1 - beta2) * grad * grad
+//   update = first_moment / (sqrt(second_moment) + epsilon)
+//   weight = weight - learning_rate * (update + weight_decay * weight)
+// Returns the updated weights, followed by the updated first moments and the
+// updated second moments.
+std::vector<xla::XlaOp> BuildMultiTensorAdam(
+    absl::Span<const xla::XlaOp> weights, absl::Span<const xla::XlaOp> grads,
+    absl::Span<const xla::XlaOp> first_moments,
+    absl::Span<const xla::XlaOp> second_moments, xla::XlaOp learning_rate,
+    xla::XlaOp beta1, xla::XlaOp beta2, xla::XlaOp weight_decay,
+    double epsilon);
+
+}  // namespace swift_xla
@@ -0,0 +1,127 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/object_pool.h"
+
+#include <array>
+#include <new>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+constexpr size_t kSizeClassBytes = 16;
+constexpr size_t kNumSizeClasses = ObjectPool::kMaxSize / kSizeClassBytes;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head = nullptr;
+  size_t size = 0;
+};
+
+struct ThreadCache {
+  ~ThreadCache() {
+    for (auto& free_list : free_lists) {
+      while (free_list.head != nullptr) {
+        FreeBlock* block = free_list.head;
+        free_list.head = block->next;
+        ::operator delete(block);
+      }
+    }
+  }
+
+  std::array<FreeList, kNumSizeClasses> free_lists;
+};
+
+// The cache pointer and the destroyed flag are trivially destructible, so they
+// can still be checked by the objects released after the thread cache has been
+// destroyed, during the thread exit. Those go straight to the heap.
+thread_local ThreadCache* g_tls_cache = nullptr;
+thread_local bool g_tls_cache_destroyed = false;
+
+struct ThreadCacheOwner {
+  ~ThreadCacheOwner() {
+    delete g_tls_cache;
+    g_tls_cache = nullptr;
+    g_tls_cache_destroyed = true;
+  }
+};
+
+bool IsPoolEnabled() {
+  static const bool enabled =
+      xla::sys_util::GetEnvBool("XLA_TENSOR_POOL", true);
+  return enabled;
+}
+
+ThreadCache* GetThreadCache() {
+  if (g_tls_cache == nullptr && !g_tls_cache_destroyed) {
+    thread_local ThreadCacheOwner owner;
+    g_tls_cache = new ThreadCache();
+  }
+  return g_tls_cache;
+}
+
+size_t SizeClass(size_t size) {
+  return (size + kSizeClassBytes - 1) / kSizeClassBytes - 1;
+}
+
+}  // namespace
+
+void* ObjectPool::Allocate(size_t size) {
+  if (!IsPoolEnabled() || size == 0 || size > kMaxSize) {
+    return ::operator new(size);
+  }
+  size_t size_class = SizeClass(size);
+  ThreadCache* cache = GetThreadCache();
+  if (cache != nullptr) {
+    FreeList& free_list = cache->free_lists[size_class];
+    if (free_list.head != nullptr) {
+      FreeBlock* block = free_list.head;
+      free_list.head = block->next;
+      free_list.size -= 1;
+      return block;
+    }
+  }
+  XLA_COUNTER("PoolHeapAllocations", 1);
+  return ::operator new((size_class + 1) * kSizeClassBytes);
+}
+
+void ObjectPool::Deallocate(void* ptr, size_t size) {
+  static const size_t kMaxCachedBlocks =
+      xla::sys_util::GetEnvInt("XLA_TENSOR_POOL_CACHE", 4096);
+  if (ptr == nullptr) {
+    return;
+  }
+  if (IsPoolEnabled() && size > 0 && size <= kMaxSize) {
+    ThreadCache* cache = GetThreadCache();
+    if (cache != nullptr) {
+      FreeList& free_list = cache->free_lists[SizeClass(size)];
+      if (free_list.size < kMaxCachedBlocks) {
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = free_list.head;
+        free_list.head = block;
+        free_list.size += 1;
+        return;
+      }
+    }
+  }
+  ::operator delete(ptr);
+}
+
+}  // namespace swift_xla
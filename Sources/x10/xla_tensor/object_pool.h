@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace swift_xla {
+
+// Size-class allocator for the small objects created for every traced
+// operation (the tensor handles returned by the C API, and the tensor data
+// along with its shared pointer control block). Freed blocks are kept in
+// thread-local free lists, one per 16 bytes size class, so that the steady
+// state of a training loop does not hit the heap for them.
+//
+// The blocks freed by a thread go to its own free lists, whichever thread
+// allocated them. At most XLA_TENSOR_POOL_CACHE blocks (4096 by default) are
+// kept per size class and thread, and the pool can be disabled by setting
+// XLA_TENSOR_POOL to false. The PoolHeapAllocations counter reports the
+// allocations which had to fall back to the heap, the ones served from the
+// free lists are not counted to keep them cheap.
+class ObjectPool {
+ public:
+  // The largest object size served by the pool. Larger ones are allocated on
+  // the heap.
+  static constexpr size_t kMaxSize = 512;
+
+  static void* Allocate(size_t size);
+
+  // Releases a block returned by Allocate(), with the same size.
+  static void Deallocate(void* ptr, size_t size);
+};
+
+// Standard allocator over the ObjectPool, for std::allocate_shared().
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(ObjectPool::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    ObjectPool::Deallocate(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,62 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/flat_pack.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> operands) {
+  XLA_CHECK(!operands.empty());
+  xla::PrimitiveType type = operands.front().shape().element_type();
+  int64_t num_elements = 0;
+  for (auto& operand : operands) {
+    const xla::Shape& shape = operand.shape();
+    XLA_CHECK_EQ(shape.element_type(), type) << shape;
+    XLA_CHECK(shape.is_static()) << shape;
+    num_elements += xla::ShapeUtil::ElementsIn(shape);
+  }
+  return xla::ShapeUtil::MakeShape(type, {num_elements});
+}
+
+}  // namespace
+
+FlatPack::FlatPack(absl::Span<const Value> operands)
+    : Node(xla_flat_pack, operands,
+           [&]() { return NodeOutputShape(operands); }) {}
+
+NodePtr FlatPack::Clone(OpList operands) const {
+  return MakeNode<FlatPack>(operands);
+}
+
+XlaOpVector FlatPack::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> parts;
+  parts.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    parts.push_back(XlaHelpers::Flatten(loctx->GetOutputOp(operand)));
+  }
+  return ReturnOp(xla::ConcatInDim(loctx->builder(), parts, 0), loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
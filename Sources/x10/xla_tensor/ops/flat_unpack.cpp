@@ -0,0 +1,88 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/flat_unpack.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(
+    const Value& operand,
+    absl::Span<const std::vector<int64_t>> dimensions) {
+  const xla::Shape& shape = operand.shape();
+  XLA_CHECK_EQ(shape.rank(), 1) << shape;
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(dimensions.size());
+  int64_t num_elements = 0;
+  for (auto& tensor_dimensions : dimensions) {
+    tuple_shapes.push_back(
+        xla::ShapeUtil::MakeShape(shape.element_type(), tensor_dimensions));
+    num_elements += xla::ShapeUtil::ElementsIn(tuple_shapes.back());
+  }
+  XLA_CHECK_EQ(num_elements, shape.dimensions(0)) << shape;
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+}  // namespace
+
+FlatUnpack::FlatUnpack(const Value& operand,
+                       std::vector<std::vector<int64_t>> dimensions)
+    : Node(xla_flat_unpack, {operand},
+           [&]() { return NodeOutputShape(operand, dimensions); },
+           /*num_outputs=*/dimensions.size(), xla::util::MHash(dimensions)),
+      dimensions_(std::move(dimensions)) {}
+
+NodePtr FlatUnpack::Clone(OpList operands) const {
+  return MakeNode<FlatUnpack>(operands.at(0), dimensions_);
+}
+
+XlaOpVector FlatUnpack::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  std::vector<xla::XlaOp> outputs;
+  outputs.reserve(dimensions_.size());
+  int64_t offset = 0;
+  for (auto& tensor_dimensions : dimensions_) {
+    int64_t num_elements = xla::util::Multiply<int64_t>(tensor_dimensions);
+    outputs.push_back(xla::Reshape(
+        xla::SliceInDim(input, offset, offset + num_elements, /*stride=*/1,
+                        /*dimno=*/0),
+        tensor_dimensions));
+    offset += num_elements;
+  }
+  return ReturnOps(outputs, loctx);
+}
+
+std::string FlatUnpack::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", dimensions=(";
+  for (size_t i = 0; i < dimensions_.size(); ++i) {
+    ss << (i == 0 ? "[" : ", [") << absl::StrJoin(dimensions_[i], ", ")
+       << "]";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Unpacks a flat vector built by FlatPack into tensors of the given
+// dimensions, as views (slice and reshape) of consecutive ranges of elements.
+class FlatUnpack : public Node {
+ public:
+  FlatUnpack(const Value& operand,
+             std::vector<std::vector<int64_t>> dimensions);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  const std::vector<std::vector<int64_t>>& dimensions() const {
+    return dimensions_;
+  }
+
+ private:
+  std::vector<std::vector<int64_t>> dimensions_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,128 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/multi_tensor_adam.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/multi_tensor_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+// The number of scalar operands following the tensor lists.
+constexpr size_t kNumScalars = 4;
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           absl::Span<const Value> first_moments,
+                           absl::Span<const Value> second_moments) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(3 * weights.size());
+  for (auto& weight : weights) {
+    tuple_shapes.push_back(weight.shape());
+  }
+  for (auto& first_moment : first_moments) {
+    tuple_shapes.push_back(first_moment.shape());
+  }
+  for (auto& second_moment : second_moments) {
+    tuple_shapes.push_back(second_moment.shape());
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> weights,
+                                  absl::Span<const Value> grads,
+                                  absl::Span<const Value> first_moments,
+                                  absl::Span<const Value> second_moments,
+                                  const Value& learning_rate,
+                                  const Value& beta1, const Value& beta2,
+                                  const Value& weight_decay) {
+  XLA_CHECK_EQ(weights.size(), grads.size());
+  XLA_CHECK_EQ(weights.size(), first_moments.size());
+  XLA_CHECK_EQ(weights.size(), second_moments.size());
+  std::vector<Value> operand_list(weights.begin(), weights.end());
+  operand_list.insert(operand_list.end(), grads.begin(), grads.end());
+  operand_list.insert(operand_list.end(), first_moments.begin(),
+                      first_moments.end());
+  operand_list.insert(operand_list.end(), second_moments.begin(),
+                      second_moments.end());
+  operand_list.push_back(learning_rate);
+  operand_list.push_back(beta1);
+  operand_list.push_back(beta2);
+  operand_list.push_back(weight_decay);
+  return operand_list;
+}
+
+}  // namespace
+
+MultiTensorAdam::MultiTensorAdam(absl::Span<const Value> weights,
+                                 absl::Span<const Value> grads,
+                                 absl::Span<const Value> first_moments,
+                                 absl::Span<const Value> second_moments,
+                                 const Value& learning_rate,
+                                 const Value& beta1, const Value& beta2,
+                                 const Value& weight_decay, double epsilon)
+    : Node(xla_multi_tensor_adam,
+           GetOperandList(weights, grads, first_moments, second_moments,
+                          learning_rate, beta1, beta2, weight_decay),
+           [&]() {
+             return NodeOutputShape(weights, first_moments, second_moments);
+           },
+           /*num_outputs=*/3 * weights.size(), xla::util::MHash(epsilon)),
+      epsilon_(epsilon) {}
+
+NodePtr MultiTensorAdam::Clone(OpList operands) const {
+  size_t num_tensors = (operands.size() - kNumScalars) / 4;
+  const Value* scalars = operands.data() + 4 * num_tensors;
+  return MakeNode<MultiTensorAdam>(
+      operands.subspan(0, num_tensors),
+      operands.subspan(num_tensors, num_tensors),
+      operands.subspan(2 * num_tensors, num_tensors),
+      operands.subspan(3 * num_tensors, num_tensors), scalars[0], scalars[1],
+      scalars[2], scalars[3], epsilon_);
+}
+
+XlaOpVector MultiTensorAdam::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  size_t num_tensors = (inputs.size() - kNumScalars) / 4;
+  absl::Span<const xla::XlaOp> tensors(inputs);
+  const xla::XlaOp* scalars = inputs.data() + 4 * num_tensors;
+  return ReturnOps(
+      BuildMultiTensorAdam(tensors.subspan(0, num_tensors),
+                           tensors.subspan(num_tensors, num_tensors),
+                           tensors.subspan(2 * num_tensors, num_tensors),
+                           tensors.subspan(3 * num_tensors, num_tensors),
+                           scalars[0], scalars[1], scalars[2], scalars[3],
+                           epsilon_),
+      loctx);
+}
+
+std::string MultiTensorAdam::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", epsilon=" << epsilon_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,113 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/multi_tensor_sgd.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/multi_tensor_update.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+// The number of scalar operands following the tensor lists.
+constexpr size_t kNumScalars = 3;
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           absl::Span<const Value> velocities) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(weights.size() + velocities.size());
+  for (auto& weight : weights) {
+    tuple_shapes.push_back(weight.shape());
+  }
+  for (auto& velocity : velocities) {
+    tuple_shapes.push_back(velocity.shape());
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> weights,
+                                  absl::Span<const Value> grads,
+                                  absl::Span<const Value> velocities,
+                                  const Value& learning_rate,
+                                  const Value& momentum,
+                                  const Value& weight_decay) {
+  XLA_CHECK_EQ(weights.size(), grads.size());
+  XLA_CHECK_EQ(weights.size(), velocities.size());
+  std::vector<Value> operand_list(weights.begin(), weights.end());
+  operand_list.insert(operand_list.end(), grads.begin(), grads.end());
+  operand_list.insert(operand_list.end(), velocities.begin(),
+                      velocities.end());
+  operand_list.push_back(learning_rate);
+  operand_list.push_back(momentum);
+  operand_list.push_back(weight_decay);
+  return operand_list;
+}
+
+}  // namespace
+
+MultiTensorSgd::MultiTensorSgd(absl::Span<const Value> weights,
+                               absl::Span<const Value> grads,
+                               absl::Span<const Value> velocities,
+                               const Value& learning_rate,
+                               const Value& momentum,
+                               const Value& weight_decay, bool nesterov)
+    : Node(xla_multi_tensor_sgd,
+           GetOperandList(weights, grads, velocities, learning_rate, momentum,
+                          weight_decay),
+           [&]() { return NodeOutputShape(weights, velocities); },
+           /*num_outputs=*/2 * weights.size(), xla::util::MHash(nesterov)),
+      nesterov_(nesterov) {}
+
+NodePtr MultiTensorSgd::Clone(OpList operands) const {
+  size_t num_tensors = (operands.size() - kNumScalars) / 3;
+  const Value* scalars = operands.data() + 3 * num_tensors;
+  return MakeNode<MultiTensorSgd>(
+      operands.subspan(0, num_tensors),
+      operands.subspan(num_tensors, num_tensors),
+      operands.subspan(2 * num_tensors, num_tensors), scalars[0], scalars[1],
+      scalars[2], nesterov_);
+}
+
+XlaOpVector MultiTensorSgd::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  size_t num_tensors = (inputs.size() - kNumScalars) / 3;
+  absl::Span<const xla::XlaOp> tensors(inputs);
+  const xla::XlaOp* scalars = inputs.data() + 3 * num_tensors;
+  return ReturnOps(
+      BuildMultiTensorSgd(tensors.subspan(0, num_tensors),
+                          tensors.subspan(num_tensors, num_tensors),
+                          tensors.subspan(2 * num_tensors, num_tensors),
+                          scalars[0], scalars[1], scalars[2], nesterov_),
+      loctx);
+}
+
+std::string MultiTensorSgd::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", nesterov=" << nesterov_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,105 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/outlined_call.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const OutlinedBody& body) {
+  if (body.outputs.size() == 1) {
+    return body.outputs.front().shape();
+  }
+  std::vector<xla::Shape> shapes;
+  for (auto& output : body.outputs) {
+    shapes.push_back(output.shape());
+  }
+  return xla::ShapeUtil::MakeTupleShape(shapes);
+}
+
+}  // namespace
+
+OutlinedCall::OutlinedCall(absl::Span<const Value> operands,
+                           std::shared_ptr<const OutlinedBody> body)
+    : Node(xla_call, operands, NodeOutputShape(*body),
+           /*num_outputs=*/body->outputs.size(), body->hash),
+      body_(std::move(body)) {}
+
+NodePtr OutlinedCall::Clone(OpList operands) const {
+  return MakeNode<OutlinedCall>(operands, body_);
+}
+
+XlaOpVector OutlinedCall::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  for (auto& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  const xla::XlaComputation& computation =
+      loctx->GetSubComputation(body_->hash, [&]() {
+        XLA_COUNTER("IrOutlinedBodies", 1);
+        return BuildBody(loctx, inputs);
+      });
+  xla::XlaOp call = xla::Call(loctx->builder(), computation, inputs);
+  std::vector<xla::XlaOp> results;
+  for (size_t i = 0; i < body_->outputs.size(); ++i) {
+    results.push_back(xla::GetTupleElement(call, i));
+  }
+  return ReturnOps(results, loctx);
+}
+
+xla::XlaComputation OutlinedCall::BuildBody(
+    LoweringContext* loctx, absl::Span<const xla::XlaOp> inputs) const {
+  XLA_CHECK_EQ(inputs.size(), body_->inputs.size());
+  auto builder = loctx->builder()->CreateSubBuilder("outlined_body");
+  // The body inputs are bound to the parameters of the sub-computation, so
+  // the lowering must not walk past them.
+  Util::EmissionMap emap;
+  for (auto& input : body_->inputs) {
+    emap[input.node.get()] = Util::kEmitted;
+  }
+  LoweringContext body_loctx(builder.get(), loctx->device(), std::move(emap));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    body_loctx.AssignOutputOp(
+        body_->inputs[i],
+        xla::Parameter(builder.get(), i, XlaHelpers::ShapeOfXlaOp(inputs[i]),
+                       absl::StrCat("p", i)));
+  }
+  std::vector<xla::XlaOp> outputs;
+  for (auto& output : body_->outputs) {
+    outputs.push_back(body_loctx.GetOutputOp(output));
+  }
+  return ConsumeValue(body_loctx.Build(xla::Tuple(builder.get(), outputs)));
+}
+
+std::string OutlinedCall::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", body=" << xla::util::HexHash(body_->hash)
+     << ", body_nodes=" << body_->num_nodes;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
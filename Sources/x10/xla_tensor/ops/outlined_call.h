@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// A subgraph shared by multiple OutlinedCall nodes. The nodes between inputs
+// and outputs are the ones of one of the outlined copies, and are only used to
+// lower the body of the called computation.
+struct OutlinedBody {
+  xla::hash_t hash = 0;
+  std::vector<Value> inputs;
+  std::vector<Value> outputs;
+  size_t num_nodes = 0;
+};
+
+// Invokes the computation lowered from body, with the operands bound to the
+// body inputs, and returns the body outputs. All the calls sharing a body hash
+// within a computation reuse the same XLA sub-computation.
+class OutlinedCall : public Node {
+ public:
+  OutlinedCall(absl::Span<const Value> operands,
+               std::shared_ptr<const OutlinedBody> body);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  const OutlinedBody& body() const { return *body_; }
+
+ private:
+  xla::XlaComputation BuildBody(LoweringContext* loctx,
+                                absl::Span<const xla::XlaOp> inputs) const;
+
+  std::shared_ptr<const OutlinedBody> body_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -47,6 +47,10 @@ View::View(const Value& input, std::vector<int64_t> output_size)
            /*num_outputs=*/1, xla::util::MHash(output_size)),
       output_size_(std::move(output_size)) {}
 
+NodePtr View::Clone(OpList operands) const {
+  return MakeNode<View>(operands.at(0), output_size_);
+}
+
 XlaOpVector View::Lower(LoweringContext* loctx) const {
   xla::XlaOp input = loctx->GetOutputOp(operand(0));
   xla::XlaOp output = BuildView(input, output_size_);
@@ -28,6 +28,8 @@ class View : public Node {
  public:
   View(const Value& input, std::vector<int64_t> output_size);
 
+  NodePtr Clone(OpList operands) const override;
+
   XlaOpVector Lower(LoweringContext* loctx) const override;
 
   std::string ToString() const override;
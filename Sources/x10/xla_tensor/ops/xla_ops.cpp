@@ -23,20 +23,26 @@ namespace ops {
 const OpKindWrapper xla_all_to_all(xla_symbols::all_to_all);
 const OpKindWrapper xla_as_strided_view_update(
     xla_symbols::as_strided_view_update);
+const OpKindWrapper xla_call(xla_symbols::call);
 const OpKindWrapper xla_cast(xla_symbols::cast);
 const OpKindWrapper xla_collective_permute(xla_symbols::collective_permute);
 const OpKindWrapper xla_cross_replica_sum(xla_symbols::cross_replica_sum);
 const OpKindWrapper xla_device_data(xla_symbols::device_data);
 const OpKindWrapper xla_diagonal_view_update(xla_symbols::diagonal_view_update);
+const OpKindWrapper xla_flat_pack(xla_symbols::flat_pack);
+const OpKindWrapper xla_flat_unpack(xla_symbols::flat_unpack);
 const OpKindWrapper xla_generic_slice(xla_symbols::generic_slice);
 const OpKindWrapper xla_get_dimensions_size(xla_symbols::get_dimensions_size);
 const OpKindWrapper xla_moving_average(xla_symbols::moving_average);
+const OpKindWrapper xla_multi_tensor_adam(xla_symbols::multi_tensor_adam);
+const OpKindWrapper xla_multi_tensor_sgd(xla_symbols::multi_tensor_sgd);
 const OpKindWrapper xla_nms(xla_symbols::nms);
 const OpKindWrapper xla_not_supported(xla_symbols::not_supported);
 const OpKindWrapper xla_replication_pad(xla_symbols::replication_pad);
 const OpKindWrapper xla_replication_pad_backward(
     xla_symbols::replication_pad_backward);
 const OpKindWrapper xla_select(xla_symbols::select);
+const OpKindWrapper xla_set_dimension_size(xla_symbols::set_dimension_size);
 const OpKindWrapper xla_tensor_data(xla_symbols::tensor_data);
 const OpKindWrapper xla_token(xla_symbols::token);
 const OpKindWrapper xla_unselect(xla_symbols::unselect);
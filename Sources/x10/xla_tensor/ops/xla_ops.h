@@ -39,19 +39,25 @@ class OpKindWrapper {
 
 extern const OpKindWrapper xla_all_to_all;
 extern const OpKindWrapper xla_as_strided_view_update;
+extern const OpKindWrapper xla_call;
 extern const OpKindWrapper xla_cast;
 extern const OpKindWrapper xla_collective_permute;
 extern const OpKindWrapper xla_cross_replica_sum;
 extern const OpKindWrapper xla_device_data;
 extern const OpKindWrapper xla_diagonal_view_update;
+extern const OpKindWrapper xla_flat_pack;
+extern const OpKindWrapper xla_flat_unpack;
 extern const OpKindWrapper xla_generic_slice;
 extern const OpKindWrapper xla_get_dimensions_size;
 extern const OpKindWrapper xla_moving_average;
+extern const OpKindWrapper xla_multi_tensor_adam;
+extern const OpKindWrapper xla_multi_tensor_sgd;
 extern const OpKindWrapper xla_nms;
 extern const OpKindWrapper xla_not_supported;
 extern const OpKindWrapper xla_replication_pad;
 extern const OpKindWrapper xla_replication_pad_backward;
 extern const OpKindWrapper xla_select;
+extern const OpKindWrapper xla_set_dimension_size;
 extern const OpKindWrapper xla_tensor_data;
 extern const OpKindWrapper xla_token;
 extern const OpKindWrapper xla_unselect;
@@ -0,0 +1,189 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/parallel_lowering.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+struct LoweredGroup {
+  std::vector<size_t> root_indices;
+  size_t num_nodes = 0;
+  xla::XlaComputation computation;
+  std::vector<xla::ComputationClient::DataPtr> parameters_data;
+  size_t emitted_nodes = 0;
+};
+
+size_t FindSet(std::vector<size_t>* parents, size_t index) {
+  while ((*parents)[index] != index) {
+    (*parents)[index] = (*parents)[(*parents)[index]];
+    index = (*parents)[index];
+  }
+  return index;
+}
+
+// Leaves are lowered again by every group using them, so they do not tie the
+// groups together.
+bool IsSharedLeaf(const Node* node) { return node->operands().empty(); }
+
+// Splits the roots into sets which share no inner node, and packs them into at
+// most max_groups groups of similar node counts.
+std::vector<LoweredGroup> SplitRoots(absl::Span<const Node* const> post_order,
+                                     absl::Span<const Value> roots,
+                                     size_t max_groups) {
+  absl::flat_hash_map<const Node*, size_t> owners;
+  std::vector<size_t> parents(roots.size());
+  std::iota(parents.begin(), parents.end(), 0);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    auto it = owners.emplace(roots[i].node.get(), i).first;
+    parents[FindSet(&parents, i)] = FindSet(&parents, it->second);
+  }
+  // In reverse post-order all the users of a node come before it, so its
+  // owner is known by the time it is reached.
+  std::vector<size_t> set_nodes(roots.size(), 0);
+  for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+    const Node* node = *it;
+    auto owner_it = owners.find(node);
+    if (owner_it == owners.end()) {
+      XLA_CHECK(IsSharedLeaf(node)) << node->ToString();
+      continue;
+    }
+    size_t owner = owner_it->second;
+    set_nodes[owner] += 1;
+    for (auto& operand : node->operands()) {
+      if (IsSharedLeaf(operand.node)) {
+        continue;
+      }
+      auto operand_it = owners.emplace(operand.node, owner).first;
+      parents[FindSet(&parents, operand_it->second)] =
+          FindSet(&parents, owner);
+    }
+  }
+
+  absl::flat_hash_map<size_t, size_t> set_index;
+  std::vector<LoweredGroup> sets;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    size_t set = FindSet(&parents, i);
+    auto it = set_index.emplace(set, sets.size()).first;
+    if (it->second == sets.size()) {
+      sets.emplace_back();
+    }
+    sets[it->second].root_indices.push_back(i);
+  }
+  for (size_t i = 0; i < parents.size(); ++i) {
+    sets[set_index.at(FindSet(&parents, i))].num_nodes += set_nodes[i];
+  }
+  if (sets.size() < 2 || max_groups < 2) {
+    return {};
+  }
+
+  // Largest sets first, each going to the group with the fewest nodes.
+  std::sort(sets.begin(), sets.end(),
+            [](const LoweredGroup& a, const LoweredGroup& b) {
+              return a.num_nodes > b.num_nodes;
+            });
+  std::vector<LoweredGroup> groups(std::min(max_groups, sets.size()));
+  for (auto& set : sets) {
+    auto group = std::min_element(
+        groups.begin(), groups.end(),
+        [](const LoweredGroup& a, const LoweredGroup& b) {
+          return a.num_nodes < b.num_nodes;
+        });
+    group->num_nodes += set.num_nodes;
+    group->root_indices.insert(group->root_indices.end(),
+                               set.root_indices.begin(),
+                               set.root_indices.end());
+  }
+  return groups;
+}
+
+void LowerGroup(absl::Span<const Value> roots, const Device& device,
+                size_t group_index, LoweredGroup* group) {
+  xla::XlaBuilder builder(absl::StrCat("SyncTensorsGraph.", group_index));
+  LoweringContext loctx(&builder, device);
+  for (size_t root_index : group->root_indices) {
+    loctx.AddResult(loctx.GetOutputOp(roots[root_index]));
+  }
+  group->computation = ConsumeValue(loctx.Build());
+  group->parameters_data = loctx.GetParametersData();
+  group->emitted_nodes = loctx.GetEmittedNodeCount();
+}
+
+}  // namespace
+
+absl::optional<size_t> LowerInParallel(
+    absl::Span<const Node* const> post_order, absl::Span<const Value> roots,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data,
+    size_t max_groups, LoweringContext* loctx) {
+  std::vector<LoweredGroup> groups = SplitRoots(post_order, roots, max_groups);
+  if (groups.empty()) {
+    return absl::nullopt;
+  }
+  XLA_COUNTER("ParallelLowerings", 1);
+  XLA_VALUE_METRIC("ParallelLoweringGroups", groups.size());
+  {
+    XLA_TIMED("ParallelLoweringGroupsTime");
+    xla::util::MultiWait mwait(groups.size());
+    for (size_t i = 0; i < groups.size(); ++i) {
+      auto lower_fn = [&, i]() {
+        LowerGroup(roots, loctx->device(), i, &groups[i]);
+      };
+      xla::env::ScheduleClosure(mwait.Completer(std::move(lower_fn)));
+    }
+    mwait.Wait();
+  }
+
+  XLA_TIMED("ParallelLoweringStitchTime");
+  // Declares the parameters in the order the serial lowering would have, which
+  // is the one the computation gets executed with.
+  for (auto& data : parameters_data) {
+    loctx->GetParameter(data);
+  }
+  std::vector<xla::XlaOp> results(roots.size());
+  size_t emitted_nodes = 0;
+  for (auto& group : groups) {
+    std::vector<xla::XlaOp> arguments;
+    arguments.reserve(group.parameters_data.size());
+    for (auto& data : group.parameters_data) {
+      arguments.push_back(loctx->GetParameter(data));
+    }
+    xla::XlaOp call = xla::Call(loctx->builder(), group.computation, arguments);
+    for (size_t i = 0; i < group.root_indices.size(); ++i) {
+      results[group.root_indices[i]] = xla::GetTupleElement(call, i);
+    }
+    emitted_nodes += group.emitted_nodes;
+  }
+  for (auto& result : results) {
+    loctx->AddResult(result);
+  }
+  XLA_CHECK_EQ(loctx->GetParametersData().size(), parameters_data.size());
+  return emitted_nodes;
+}
+
+}  // namespace ir
+}  // namespace swift_xla
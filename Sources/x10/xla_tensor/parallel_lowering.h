@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Lowers the graph with the given post-order into loctx, whose builder must be
+// empty, by splitting the roots into groups which share no computation (only
+// device data and other leaves), lowering each group into its own builder on a
+// separate thread, and calling the resulting computations from the loctx
+// builder. The parameters of loctx are created in the parameters_data order,
+// and the roots are added as results in their order. Returns the number of
+// lowered nodes, or nullopt (leaving loctx untouched) if the roots cannot be
+// split in at least two groups.
+absl::optional<size_t> LowerInParallel(
+    absl::Span<const Node* const> post_order, absl::Span<const Value> roots,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data,
+    size_t max_groups, LoweringContext* loctx);
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,225 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_buckets.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+struct BucketConfig {
+  std::mutex mutex;
+  std::map<int64_t, std::vector<int64_t>> boundaries;
+};
+
+int64_t ParseBucketInt(absl::string_view text, const std::string& spec) {
+  int64_t value;
+  XLA_CHECK(absl::SimpleAtoi(text, &value) && value >= 0)
+      << "Invalid shape bucket specification: " << spec;
+  return value;
+}
+
+std::vector<int64_t> NormalizeBoundaries(std::vector<int64_t> boundaries) {
+  std::sort(boundaries.begin(), boundaries.end());
+  boundaries.erase(std::unique(boundaries.begin(), boundaries.end()),
+                   boundaries.end());
+  return boundaries;
+}
+
+BucketConfig* CreateBucketConfig() {
+  BucketConfig* config = new BucketConfig();
+  std::string spec = xla::sys_util::GetEnvString("XLA_SHAPE_BUCKETS", "");
+  for (absl::string_view dim_spec :
+       absl::StrSplit(spec, ';', absl::SkipWhitespace())) {
+    std::vector<absl::string_view> parts = absl::StrSplit(dim_spec, ':');
+    XLA_CHECK_EQ(parts.size(), 2)
+        << "Invalid shape bucket specification: " << spec;
+    std::vector<int64_t> boundaries;
+    for (absl::string_view boundary :
+         absl::StrSplit(parts[1], ',', absl::SkipWhitespace())) {
+      boundaries.push_back(ParseBucketInt(boundary, spec));
+    }
+    config->boundaries[ParseBucketInt(parts[0], spec)] =
+        NormalizeBoundaries(std::move(boundaries));
+  }
+  return config;
+}
+
+BucketConfig* GetBucketConfig() {
+  static BucketConfig* config = CreateBucketConfig();
+  return config;
+}
+
+// Tracks the distinct shapes which went through bucketing, and counts the ones
+// which landed on an already seen bucket, as those would have triggered a new
+// compilation without bucketing.
+void RecordBucketedShape(at::ScalarType type,
+                         absl::Span<const int64_t> dimensions,
+                         absl::Span<const int64_t> bucketed_dimensions) {
+  static std::mutex* mutex = new std::mutex();
+  static auto* shapes = new std::set<std::vector<int64_t>>();
+  static auto* buckets = new std::set<std::vector<int64_t>>();
+  auto make_key = [type](absl::Span<const int64_t> dims) {
+    std::vector<int64_t> key(dims.begin(), dims.end());
+    key.push_back(static_cast<int64_t>(type));
+    return key;
+  };
+  std::lock_guard<std::mutex> lock(*mutex);
+  bool new_shape = shapes->insert(make_key(dimensions)).second;
+  bool new_bucket = buckets->insert(make_key(bucketed_dimensions)).second;
+  if (new_shape && !new_bucket) {
+    XLA_COUNTER("ShapeBucketCompilesSaved", 1);
+  }
+}
+
+// Implementation of Scalar buffer backed by zero-initialized owned memory, for
+// any scalar type (including the ones sharing their C++ type with others).
+class ZeroedScalarBuffer : public at::AnyScalarBuffer {
+ public:
+  ZeroedScalarBuffer(at::ScalarType type, size_t len)
+      : at::AnyScalarBuffer(type),
+        data_(new char[std::max<size_t>(len, 1) *
+                       at::internal::GetSizeof(type)]()) {
+    set_base(data_.get());
+    set_size(len);
+  }
+
+  char* mutable_data() {
+    invalidate_content_hash();
+    return data_.get();
+  }
+
+ private:
+  std::unique_ptr<char[]> data_;
+};
+
+void CopyPadded(const char* src, char* dest, absl::Span<const int64_t> sizes,
+                absl::Span<const int64_t> src_strides,
+                absl::Span<const int64_t> dest_strides, size_t dim) {
+  if (dim + 1 == sizes.size()) {
+    std::memcpy(dest, src, sizes[dim] * src_strides[dim]);
+    return;
+  }
+  for (int64_t i = 0; i < sizes[dim]; ++i) {
+    CopyPadded(src + i * src_strides[dim], dest + i * dest_strides[dim], sizes,
+               src_strides, dest_strides, dim + 1);
+  }
+}
+
+}  // namespace
+
+void SetShapeBuckets(int64_t dim, std::vector<int64_t> boundaries) {
+  XLA_CHECK_GE(dim, 0);
+  BucketConfig* config = GetBucketConfig();
+  std::lock_guard<std::mutex> lock(config->mutex);
+  if (boundaries.empty()) {
+    config->boundaries.erase(dim);
+  } else {
+    config->boundaries[dim] = NormalizeBoundaries(std::move(boundaries));
+  }
+}
+
+absl::optional<BucketedShape> GetBucketedShape(
+    absl::Span<const int64_t> dimensions) {
+  BucketConfig* config = GetBucketConfig();
+  BucketedShape bucketed;
+  {
+    std::lock_guard<std::mutex> lock(config->mutex);
+    if (config->boundaries.empty()) {
+      return absl::nullopt;
+    }
+    bucketed.dimensions.assign(dimensions.begin(), dimensions.end());
+    for (auto& dim_boundaries : config->boundaries) {
+      int64_t dim = dim_boundaries.first;
+      if (dim >= static_cast<int64_t>(dimensions.size())) {
+        break;
+      }
+      const std::vector<int64_t>& boundaries = dim_boundaries.second;
+      auto it = std::lower_bound(boundaries.begin(), boundaries.end(),
+                                 dimensions[dim]);
+      if (it == boundaries.end()) {
+        XLA_COUNTER("ShapeBucketOverflow", 1);
+        continue;
+      }
+      bucketed.dimensions[dim] = *it;
+      bucketed.dynamic_dimensions.push_back(dim);
+    }
+  }
+  if (bucketed.dynamic_dimensions.empty()) {
+    return absl::nullopt;
+  }
+  return bucketed;
+}
+
+at::Tensor PadTensor(const at::Tensor& tensor,
+                     absl::Span<const int64_t> dimensions) {
+  XLA_CHECK_EQ(tensor.rank(), dimensions.size());
+  size_t element_size = at::internal::GetSizeof(tensor.scalar_type());
+  std::vector<int64_t> src_strides = ComputeArrayStrides(tensor.shape());
+  std::vector<int64_t> dest_strides = ComputeArrayStrides(dimensions);
+  for (size_t i = 0; i < dimensions.size(); ++i) {
+    XLA_CHECK_LE(tensor.shape()[i], dimensions[i]);
+    src_strides[i] *= element_size;
+    dest_strides[i] *= element_size;
+  }
+  std::vector<int64_t> dest_dimensions(dimensions.begin(), dimensions.end());
+  auto buffer = std::make_unique<ZeroedScalarBuffer>(
+      tensor.scalar_type(), at::GetLenFromShape(dest_dimensions));
+  if (tensor.rank() == 0) {
+    std::memcpy(buffer->mutable_data(), tensor.buffer().raw_data(),
+                element_size);
+  } else if (at::GetLenFromShape(tensor.shape()) > 0) {
+    CopyPadded(static_cast<const char*>(tensor.buffer().raw_data()),
+               buffer->mutable_data(), tensor.shape(), src_strides,
+               dest_strides, /*dim=*/0);
+  }
+  return at::Tensor(std::move(buffer), std::move(dest_dimensions));
+}
+
+XLATensor CreateBucketedTensor(const at::Tensor& tensor, const Device& device) {
+  absl::optional<BucketedShape> bucketed = GetBucketedShape(tensor.shape());
+  if (!bucketed) {
+    return XLATensor::Create(tensor, device);
+  }
+  RecordBucketedShape(tensor.scalar_type(), tensor.shape(),
+                      bucketed->dimensions);
+  XLATensor result = XLATensor::Create(
+      TensorToXlaData(PadTensor(tensor, bucketed->dimensions), device),
+      tensor.scalar_type());
+  for (int64_t dim : bucketed->dynamic_dimensions) {
+    // The real size is uploaded as device data (instead of being an IR
+    // constant), so that it does not contribute to the graph hash.
+    std::unique_ptr<int32_t[]> size(new int32_t[1]);
+    size[0] = static_cast<int32_t>(tensor.shape()[dim]);
+    at::Tensor size_tensor(std::move(size), std::vector<int64_t>());
+    XLATensor xla_size = XLATensor::Create(
+        TensorToXlaData(size_tensor, device), at::ScalarType::Int);
+    result = XLATensor::set_dimension_size(result, xla_size, dim);
+  }
+  return result;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Opt-in shape bucketing, for inputs whose sizes change from step to step (like
+// the sequence length of NLP batches). Every dimension with configured bucket
+// boundaries gets padded up to the smallest boundary which fits it, and its
+// real size is carried as an XLA dynamic dimension fed by a device scalar. This
+// way all the sizes falling within a bucket share the same graph hash, and
+// hence the same compiled computation.
+//
+// Boundaries are set with SetShapeBuckets(), or with the XLA_SHAPE_BUCKETS
+// environment variable, in the "DIM:B0,B1,...;DIM:..." format (for example
+// "1:32,64,128,256").
+
+struct BucketedShape {
+  std::vector<int64_t> dimensions;
+  // The dimensions which have been bucketed, in increasing order.
+  std::vector<int64_t> dynamic_dimensions;
+};
+
+// Sets the bucket boundaries of dimension dim. An empty list disables bucketing
+// for dim.
+void SetShapeBuckets(int64_t dim, std::vector<int64_t> boundaries);
+
+// Returns the bucketed version of the given dimensions, or nullopt if none of
+// them is subject to bucketing. Sizes bigger than the last boundary of their
+// dimension are left untouched.
+absl::optional<BucketedShape> GetBucketedShape(
+    absl::Span<const int64_t> dimensions);
+
+// Returns a copy of tensor zero-padded at the end of each dimension, up to the
+// given dimensions.
+at::Tensor PadTensor(const at::Tensor& tensor,
+                     absl::Span<const int64_t> dimensions);
+
+// Uploads tensor to device, padding the dimensions subject to bucketing, and
+// returns an XLA tensor whose bucketed dimensions are dynamic with the real
+// sizes. Tensors not subject to bucketing are created as XLATensor::Create()
+// does.
+XLATensor CreateBucketedTensor(const at::Tensor& tensor, const Device& device);
+
+}  // namespace swift_xla
@@ -15,18 +15,23 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
 #include <exception>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <set>
 #include <stdexcept>
+#include <thread>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
-#include "absl/container/node_hash_set.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -35,12 +40,20 @@
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/unique.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/background_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_partitioner.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/host_evaluator.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_optimizer.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_outliner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/object_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/op_by_op_executor.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/parallel_lowering.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
@@ -78,32 +91,11 @@ struct TlsData {
 
 thread_local TlsData g_tls_data;
 
-struct TraceletState {
-  absl::node_hash_map<xla::hash_t, std::vector<xla::hash_t>> tracelet_by_prefix;
-  absl::node_hash_set<xla::hash_t> cutpoints;
-  int64_t prev_uncached_compile = 0;
-};
-
-thread_local TraceletState g_tracelet_state;
-
-c10::optional<size_t> FindTraceDivergence(
-    absl::Span<const xla::hash_t> trace1,
-    absl::Span<const xla::hash_t> trace2) {
-  if (trace2.size() > trace1.size()) {
-    std::swap(trace1, trace2);
-  }
-  auto result = std::mismatch(trace1.begin(), trace1.end(), trace2.begin());
-  if (result.first != trace1.end()) {
-    return result.first - trace1.begin();
-  }
-  return absl::nullopt;
-}
-
 // Locking:
 // We perform two kinds of operations of tensors, synchronous and asynchronous.
 // The ApplyPendingGraph() are synchronous, as we need the device data result
 // immediately. Before the synchronous operations can start, they need to wait
-// that the pending asynchronous operations have completed.
+// that the pending asynchronous operations producing their data have completed.
 // Synchronous operations do not hold device locks, since they are strictly
 // sequential, dictated by the user program execution order.
 // The SyncTensorsGraph() is asynchronous, and returns immediately after having
@@ -113,8 +105,10 @@ c10::optional<size_t> FindTraceDivergence(
 // Since asynchronous operations capture device locks, only one asynchronous
 // operation can execute at the same time, on a given device. Tensor operations
 // which send data to device do not need to hold any device locks while doing
-// so. Only operations which _use_ device data (computations, and transfer from
-// server) need to wait for asynchronous operations to complete (barrier).
+// so. Computations need to wait for asynchronous operations to complete, since
+// they can take the placeholders of the pending ones as parameters. Reading
+// device data (transfer from server) only waits for the asynchronous operation
+// producing it, if still pending (data barrier).
 
 class DeviceLocker {
  public:
@@ -132,14 +126,32 @@ class DeviceLocker {
   void Unlock(std::exception_ptr exptr) {
     std::lock_guard<std::mutex> lock(mutex_);
     locked_ = false;
+    pending_data_.clear();
     exptr_ = std::move(exptr);
     cv_.notify_all();
   }
 
-  void Barrier() {
+  // Registers the device data placeholders which the asynchronous operation
+  // holding the lock is going to fill.
+  void AddPendingData(absl::Span<const xla::ComputationClient::DataPtr> data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    XLA_CHECK(locked_);
+    for (auto& xla_data : data) {
+      if (xla_data != nullptr) {
+        pending_data_.insert(xla_data.get());
+      }
+    }
+  }
+
+  // Waits for the asynchronous operation producing any of the given device
+  // data, if still pending. The data produced by the completed operations can
+  // be read while another one is executing.
+  void DataBarrier(absl::Span<const xla::ComputationClient::DataPtr> data) {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !locked_; });
-    cv_.notify_all();
+    if (IsPending(data)) {
+      XLA_COUNTER("DataBarrierWaits", 1);
+      cv_.wait(lock, [&] { return !IsPending(data); });
+    }
     CheckResetException();
   }
 
@@ -152,10 +164,22 @@ class DeviceLocker {
     }
   }
 
+  bool IsPending(
+      absl::Span<const xla::ComputationClient::DataPtr> data) const {
+    for (auto& xla_data : data) {
+      if (pending_data_.contains(xla_data.get())) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   Device device_;
   std::mutex mutex_;
   std::condition_variable cv_;
   bool locked_ = false;
+  // Keyed by object, since the placeholders have no handle until filled.
+  absl::flat_hash_set<const xla::ComputationClient::Data*> pending_data_;
   std::exception_ptr exptr_;
 };
 
@@ -191,9 +215,11 @@ xla::util::ExceptionCleanup LockDevice(const Device& device) {
       });
 }
 
-void DeviceBarrier(const Device& device) {
+void DeviceDataBarrier(
+    const Device& device,
+    absl::Span<const xla::ComputationClient::DataPtr> data) {
   auto locker = DeviceLockerArena::Get()->GetLocker(device);
-  locker->Barrier();
+  locker->DataBarrier(data);
 }
 
 // Use a set to impose an order on the device locking sequence (ABBA
@@ -314,6 +340,123 @@ bool ShouldSyncIrValue(const ir::Value& ir_value) {
   return ir_value->op() != ir::ops::xla_not_supported;
 }
 
+// Computes the post order of the outlined graph rooted at roots, with its device
+// data nodes moved first, in the order they have within the post order of the
+// graph before outlining. This way the lowering creates the parameters in the
+// order of the parameters data collected before outlining.
+std::vector<const ir::Node*> ComputeOutlinedPostOrder(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const ir::Node* const> post_order,
+    ir::Util::EmissionMap* emission_map) {
+  std::vector<const ir::Node*> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (auto& root : roots) {
+    root_nodes.push_back(root.node.get());
+  }
+  emission_map->clear();
+  std::vector<const ir::Node*> outlined_post_order =
+      ir::Util::ComputePostOrder(root_nodes, emission_map);
+  std::vector<const ir::Node*> result;
+  result.reserve(outlined_post_order.size());
+  for (auto node : post_order) {
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      result.push_back(node);
+    }
+  }
+  for (auto node : outlined_post_order) {
+    if (ir::ops::DeviceData::Cast(node) == nullptr) {
+      result.push_back(node);
+    }
+  }
+  return result;
+}
+
+// Stands in for the device data of a graph compiled in background, which only
+// needs the shapes of its parameters, so that the compilation does not keep
+// their device buffers alive.
+class ParameterShapeData : public xla::ComputationClient::Data {
+ public:
+  ParameterShapeData(xla::Shape shape, OpaqueHandle handle)
+      : Data(/*device=*/nullptr, std::move(shape)), handle_(handle) {}
+
+  OpaqueHandle GetOpaqueHandle() override { return handle_; }
+
+  void Assign(const Data& data) override {
+    XLA_ERROR() << "Cannot assign to the shape of a parameter";
+  }
+
+  bool HasValue() const override { return false; }
+
+ private:
+  OpaqueHandle handle_;
+};
+
+// Returns the roots of a copy of the graph with the given post order, whose
+// device data nodes hold ParameterShapeData instead of the device data. The
+// device data sharing a handle get the same stand-in, so the copy lowers to
+// the same parameters.
+std::vector<ir::Value> DetachParametersData(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const ir::Node* const> post_order) {
+  absl::flat_hash_map<const ir::Node*, ir::NodePtr> clones;
+  absl::flat_hash_map<xla::ComputationClient::Data::OpaqueHandle,
+                      xla::ComputationClient::DataPtr>
+      parameters;
+  for (auto node : post_order) {
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data != nullptr) {
+      xla::ComputationClient::Data::OpaqueHandle handle =
+          device_data->data()->GetOpaqueHandle();
+      xla::ComputationClient::DataPtr& parameter = parameters[handle];
+      if (parameter == nullptr) {
+        parameter = std::make_shared<ParameterShapeData>(
+            device_data->data()->shape(), handle);
+      }
+      clones.emplace(node, ir::MakeNode<ir::ops::DeviceData>(parameter));
+      continue;
+    }
+    std::vector<ir::Value> operands;
+    bool changed = false;
+    for (size_t i = 0; i < node->operands().size(); ++i) {
+      const ir::Output& operand = node->operand(i);
+      auto it = clones.find(operand.node);
+      changed = changed || it != clones.end();
+      operands.emplace_back(
+          it != clones.end() ? it->second : node->operand_nodes()[i],
+          operand.index);
+    }
+    if (changed) {
+      clones.emplace(node, node->Clone(operands));
+    }
+  }
+  std::vector<ir::Value> detached_roots;
+  detached_roots.reserve(roots.size());
+  for (auto& root : roots) {
+    auto it = clones.find(root.node.get());
+    detached_roots.push_back(
+        it != clones.end() ? ir::Value(it->second, root.index) : root);
+  }
+  return detached_roots;
+}
+
+std::atomic<bool>* ParallelLoweringEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_PARALLEL_LOWERING", false));
+  return enabled;
+}
+
+std::atomic<size_t>* ParallelLoweringMinNodes() {
+  static std::atomic<size_t>* min_nodes = new std::atomic<size_t>(
+      xla::sys_util::GetEnvInt("XLA_PARALLEL_LOWERING_MIN_NODES", 10000));
+  return min_nodes;
+}
+
+std::atomic<bool>* SyncTensorsOpByOpEnabled() {
+  static std::atomic<bool>* enabled = new std::atomic<bool>(
+      xla::sys_util::GetEnvBool("XLA_SYNC_TENSORS_OPBYOP", false));
+  return enabled;
+}
+
 }  // namespace
 
 // The DeviceContextArena holds per device live information and statistics,
@@ -322,12 +465,57 @@ bool ShouldSyncIrValue(const ir::Value& ir_value) {
 // operations and ensure the same XLA computations are created during the
 // training loops.
 class XLATensor::DeviceContextArena {
-  struct DeviceContext {
+  // The live tensors of a device are spread over shards selected by their
+  // unique ID, each with its own lock, so that the threads creating and
+  // destroying tensors rarely contend on the registry.
+  static constexpr size_t kTensorShards = 16;
+
+  struct TensorShard {
     std::mutex lock;
     absl::flat_hash_map<int64_t, std::weak_ptr<Data>> tensors_data;
+    // The tensors which got pending IR, or host only data, since they were
+    // last collected by GetDirtyTensors().
+    absl::flat_hash_map<int64_t, std::weak_ptr<Data>> dirty_data;
+  };
+
+  struct DeviceContext {
+    std::mutex lock;
+    std::array<TensorShard, kTensorShards> shards;
     uint64_t seed = 101;
     uint64_t running_seed = 101;
     ir::Value seed_ir_value;
+    int64_t last_step_peak_bytes = 0;
+    // The device data pinned by PinData(), with their pin counts. The data
+    // can be placeholders of pending computations, so their handles are only
+    // looked up when needed.
+    absl::flat_hash_map<xla::ComputationClient::Data*, size_t> pinned_data;
+  };
+
+  // The tensors destroyed by a thread are removed from the registry in
+  // batches, which takes each shard lock once per batch instead of once per
+  // tensor. Until then, their entries hold expired weak pointers, which the
+  // readers skip.
+  struct PendingUnregistrations {
+    ~PendingUnregistrations() { Flush(); }
+
+    void Flush() {
+      std::sort(entries.begin(), entries.end(),
+                [](const std::pair<TensorShard*, int64_t>& a,
+                   const std::pair<TensorShard*, int64_t>& b) {
+                  return a.first < b.first;
+                });
+      for (size_t i = 0; i < entries.size();) {
+        TensorShard* shard = entries[i].first;
+        std::lock_guard<std::mutex> lock(shard->lock);
+        for (; i < entries.size() && entries[i].first == shard; ++i) {
+          shard->tensors_data.erase(entries[i].second);
+          shard->dirty_data.erase(entries[i].second);
+        }
+      }
+      entries.clear();
+    }
+
+    std::vector<std::pair<TensorShard*, int64_t>> entries;
   };
 
  public:
@@ -345,31 +533,85 @@ class XLATensor::DeviceContextArena {
   }
 
   void RegisterTensor(std::shared_ptr<Data> data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.emplace(data->unique_id, data);
+    TensorShard* shard = GetTensorShard(*data);
+    bool dirty = data->ir_value ||
+                 (data->xla_data == nullptr && data->tensor_data);
+    if (dirty) {
+      data->dirty = true;
+    }
+    std::lock_guard<std::mutex> lock(shard->lock);
+    if (dirty) {
+      shard->dirty_data.emplace(data->unique_id, data);
+    }
+    shard->tensors_data.emplace(data->unique_id, data);
     XLA_COUNTER("CreateXlaTensor", 1);
   }
 
   void UnregisterTensor(Data* data) {
-    DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.erase(data->unique_id);
+    static const size_t kUnregisterBatchSize =
+        xla::sys_util::GetEnvInt("XLA_TENSOR_UNREGISTER_BATCH", 64);
+    thread_local PendingUnregistrations pending;
+    pending.entries.emplace_back(GetTensorShard(*data), data->unique_id);
+    if (pending.entries.size() >= kUnregisterBatchSize) {
+      pending.Flush();
+    }
     XLA_COUNTER("DestroyXlaTensor", 1);
   }
 
+  // Records that the tensor got pending IR, or host only data, which the next
+  // live tensors sync will have to turn into device data. Only the first call
+  // since the tensor was last collected by GetDirtyTensors() takes a lock.
+  void MarkDirty(const std::shared_ptr<Data>& data) {
+    if (data->dirty.exchange(true)) {
+      return;
+    }
+    TensorShard* shard = GetTensorShard(*data);
+    std::lock_guard<std::mutex> lock(shard->lock);
+    shard->dirty_data.emplace(data->unique_id, data);
+  }
+
   std::vector<XLATensor> GetLiveTensors(const Device* device) {
     std::vector<XLATensor> tensors;
     auto fn = [&](DeviceContext* devctx) {
-      std::lock_guard<std::mutex> lock(devctx->lock);
-      for (auto& uid_wptr : devctx->tensors_data) {
-        std::shared_ptr<Data> data = uid_wptr.second.lock();
-        if (data != nullptr) {
-          tensors.push_back(XLATensor(std::move(data)));
+      for (auto& data : GetLiveTensorsData(devctx)) {
+        tensors.push_back(XLATensor(std::move(data)));
+      }
+    };
+    ForAllDeviceContexts(fn, device);
+    std::sort(tensors.begin(), tensors.end(), [](const XLATensor& a,
+                                                 const XLATensor& b) {
+      return a.GetUniqueId() < b.GetUniqueId();
+    });
+    return tensors;
+  }
+
+  // Returns the live tensors which were marked dirty since the last call, and
+  // clears their marks. The tensors which were not marked cannot hold pending
+  // IR or host only data, so a live tensors sync only needs to visit these.
+  std::vector<XLATensor> GetDirtyTensors(const Device* device) {
+    std::vector<std::weak_ptr<Data>> dirty_data;
+    auto fn = [&](DeviceContext* devctx) {
+      for (auto& shard : devctx->shards) {
+        absl::flat_hash_map<int64_t, std::weak_ptr<Data>> shard_dirty_data;
+        {
+          std::lock_guard<std::mutex> lock(shard.lock);
+          shard_dirty_data.swap(shard.dirty_data);
+        }
+        for (auto& uid_wptr : shard_dirty_data) {
+          dirty_data.push_back(std::move(uid_wptr.second));
         }
       }
     };
     ForAllDeviceContexts(fn, device);
+    std::vector<XLATensor> tensors;
+    tensors.reserve(dirty_data.size());
+    for (auto& wptr : dirty_data) {
+      std::shared_ptr<Data> data = wptr.lock();
+      if (data != nullptr) {
+        data->dirty = false;
+        tensors.push_back(XLATensor(std::move(data)));
+      }
+    }
     std::sort(tensors.begin(), tensors.end(), [](const XLATensor& a,
                                                  const XLATensor& b) {
       return a.GetUniqueId() < b.GetUniqueId();
@@ -377,6 +619,96 @@ class XLATensor::DeviceContextArena {
     return tensors;
   }
 
+  // Returns the device data referenced by the live tensors of the device which
+  // are not in synced_ids, either as their current data or within their
+  // pending IR graphs, and the pinned device data. Those buffers are not
+  // exclusively owned by a computation syncing the synced_ids tensors, and
+  // cannot be donated to it. Keyed by object, since the placeholders of the
+  // pending computations have no handle until filled.
+  absl::flat_hash_set<const xla::ComputationClient::Data*> GetReferencedData(
+      const Device& device, const absl::flat_hash_set<int64_t>& synced_ids) {
+    DeviceContext* devctx = GetDeviceContext(device);
+    std::vector<std::shared_ptr<Data>> tensors_data =
+        GetLiveTensorsData(devctx, &synced_ids);
+    absl::flat_hash_set<const xla::ComputationClient::Data*> referenced;
+    {
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      for (auto& data_count : devctx->pinned_data) {
+        referenced.insert(data_count.first);
+      }
+    }
+    std::vector<const ir::Node*> roots;
+    for (auto& data : tensors_data) {
+      if (data->xla_data != nullptr) {
+        referenced.insert(data->xla_data.get());
+      } else if (data->ir_value) {
+        roots.push_back(data->ir_value.node.get());
+      }
+    }
+    for (const ir::Node* node : ir::Util::ComputePostOrder(roots)) {
+      const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+      if (device_data != nullptr) {
+        referenced.insert(device_data->data().get());
+      }
+    }
+    return referenced;
+  }
+
+  std::vector<DeviceMemorySnapshot> GetMemorySnapshots(const Device* device) {
+    std::vector<DeviceMemorySnapshot> snapshots;
+    for (auto& device_context : device_contexts_) {
+      if (device == nullptr || device_context.first == *device) {
+        snapshots.push_back(
+            GetMemorySnapshot(device_context.first, device_context.second));
+      }
+    }
+    std::sort(snapshots.begin(), snapshots.end(),
+              [](const DeviceMemorySnapshot& a, const DeviceMemorySnapshot& b) {
+                return a.device < b.device;
+              });
+    return snapshots;
+  }
+
+  // Records the device memory high-water mark of the step which just ended,
+  // and starts tracking the one of the next step.
+  void MarkStepMemory(const Device* device) {
+    static xla::metrics::Metric* step_peak_metric = new xla::metrics::Metric(
+        "DeviceMemoryStepPeak", xla::metrics::MetricFnBytes);
+    for (auto& device_context : device_contexts_) {
+      if (device != nullptr && device_context.first != *device) {
+        continue;
+      }
+      int64_t peak_bytes =
+          xla::GetX10Device(device_context.first)->ResetPeakBytes();
+      step_peak_metric->AddSample(peak_bytes);
+      DeviceContext* devctx = device_context.second;
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      devctx->last_step_peak_bytes = peak_bytes;
+    }
+  }
+
+  void PinData(absl::Span<const xla::ComputationClient::DataPtr> data) {
+    for (auto& xla_data : data) {
+      DeviceContext* devctx =
+          GetDeviceContext(Device(xla_data->device()->device_id()));
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      devctx->pinned_data[xla_data.get()] += 1;
+    }
+  }
+
+  void UnpinData(absl::Span<const xla::ComputationClient::DataPtr> data) {
+    for (auto& xla_data : data) {
+      DeviceContext* devctx =
+          GetDeviceContext(Device(xla_data->device()->device_id()));
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      auto it = devctx->pinned_data.find(xla_data.get());
+      XLA_CHECK(it != devctx->pinned_data.end());
+      if (--it->second == 0) {
+        devctx->pinned_data.erase(it);
+      }
+    }
+  }
+
   uint64_t GetRunningSeed(const Device& device) {
     DeviceContext* devctx = GetDeviceContext(device);
     std::lock_guard<std::mutex> lock(devctx->lock);
@@ -424,6 +756,96 @@ class XLATensor::DeviceContextArena {
     }
   }
 
+  DeviceMemorySnapshot GetMemorySnapshot(const Device& device,
+                                         DeviceContext* devctx) {
+    xla::ComputationClient::Device* xla_device = xla::GetX10Device(device);
+    DeviceMemorySnapshot snapshot;
+    snapshot.device = device;
+    {
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      snapshot.last_step_peak_bytes = devctx->last_step_peak_bytes;
+    }
+    std::vector<std::shared_ptr<Data>> tensors_data =
+        GetLiveTensorsData(devctx);
+    snapshot.live_bytes = xla_device->live_bytes();
+    snapshot.peak_bytes = xla_device->peak_bytes();
+
+    // Buffers shared by multiple tensors are accounted once, to the first
+    // tensor found holding them. The placeholders of the computations in
+    // flight hold no buffer yet.
+    std::map<std::string, DeviceMemoryUsage> usages;
+    absl::flat_hash_set<const xla::ComputationClient::Data*> seen;
+    auto account = [&](const std::string& origin,
+                       const xla::ComputationClient::Data* data) {
+      if (data->HasValue() && seen.insert(data).second) {
+        DeviceMemoryUsage& usage = usages[origin];
+        usage.bytes += data->bytes();
+        usage.buffers += 1;
+      }
+    };
+    std::vector<const ir::Node*> roots;
+    for (auto& data : tensors_data) {
+      if (data->xla_data != nullptr) {
+        account(data->origin.empty() ? kHostDataOrigin : data->origin,
+                data->xla_data.get());
+      } else if (data->ir_value) {
+        roots.push_back(data->ir_value.node.get());
+      }
+    }
+    for (const ir::Node* node : ir::Util::ComputePostOrder(roots)) {
+      const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+      if (device_data != nullptr) {
+        account(kPendingGraphOrigin, device_data->data().get());
+      }
+    }
+    int64_t tracked_bytes = 0;
+    for (auto& origin_usage : usages) {
+      origin_usage.second.origin = origin_usage.first;
+      tracked_bytes += origin_usage.second.bytes;
+      snapshot.usages.push_back(std::move(origin_usage.second));
+    }
+    if (snapshot.live_bytes > tracked_bytes) {
+      DeviceMemoryUsage untracked;
+      untracked.origin = kUntrackedOrigin;
+      untracked.bytes = snapshot.live_bytes - tracked_bytes;
+      snapshot.usages.push_back(std::move(untracked));
+    }
+    std::sort(snapshot.usages.begin(), snapshot.usages.end(),
+              [](const DeviceMemoryUsage& a, const DeviceMemoryUsage& b) {
+                return a.bytes > b.bytes;
+              });
+    return snapshot;
+  }
+
+  // Returns the data of the live tensors of the device, but the ones whose
+  // unique IDs are in skip_ids. The returned references are only dropped once
+  // the shard locks are released, since the destruction of a tensor data
+  // could flush the pending unregistrations.
+  std::vector<std::shared_ptr<Data>> GetLiveTensorsData(
+      DeviceContext* devctx,
+      const absl::flat_hash_set<int64_t>* skip_ids = nullptr) {
+    std::vector<std::shared_ptr<Data>> tensors_data;
+    for (auto& shard : devctx->shards) {
+      std::lock_guard<std::mutex> lock(shard.lock);
+      for (auto& uid_wptr : shard.tensors_data) {
+        if (skip_ids != nullptr && skip_ids->contains(uid_wptr.first)) {
+          continue;
+        }
+        std::shared_ptr<Data> data = uid_wptr.second.lock();
+        if (data != nullptr) {
+          tensors_data.push_back(std::move(data));
+        }
+      }
+    }
+    return tensors_data;
+  }
+
+  TensorShard* GetTensorShard(const Data& data) {
+    DeviceContext* devctx = GetDeviceContext(data.device);
+    return &devctx->shards[static_cast<uint64_t>(data.unique_id) %
+                           kTensorShards];
+  }
+
   DeviceContext* GetDeviceContext(const Device& device) {
     auto it = device_contexts_.find(device);
     XLA_CHECK(it != device_contexts_.end())
@@ -435,11 +857,17 @@ class XLATensor::DeviceContextArena {
 };
 
 struct DeviceDataInfo : public xla::ComputationClient::Data::Info {
-  DeviceDataInfo(int64_t tensor_id, bool read_only)
-      : tensor_id(tensor_id), read_only(read_only) {}
+  DeviceDataInfo(int64_t tensor_id, bool read_only,
+                 c10::optional<at::Tensor> host_tensor = absl::nullopt)
+      : tensor_id(tensor_id),
+        read_only(read_only),
+        host_tensor(std::move(host_tensor)) {}
 
   int64_t tensor_id = 0;
   bool read_only = false;
+  // The host tensor the data was uploaded from, kept for the small ones only,
+  // so that EvaluateOnHost() can use it.
+  c10::optional<at::Tensor> host_tensor;
 };
 
 XLATensor::Data::~Data() { DeviceContextArena::Get()->UnregisterTensor(this); }
@@ -508,18 +936,20 @@ XLATensor XLATensor::Create(
 }
 
 XLATensor::XLATensor(const at::Tensor& tensor, const Device& device)
-    : data_(std::make_shared<Data>(tensor, device)) {}
+    : data_(std::allocate_shared<Data>(PoolAllocator<Data>(), tensor,
+                                       device)) {}
 
 XLATensor::XLATensor(xla::ComputationClient::DataPtr xla_data,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(xla_data,
-                                   Device(xla_data->device()->device_id()),
-                                   logical_element_type)) {}
+    : data_(std::allocate_shared<Data>(
+          PoolAllocator<Data>(), xla_data,
+          Device(xla_data->device()->device_id()), logical_element_type)) {}
 
 XLATensor::XLATensor(ir::Value ir_value, const Device& device,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(std::move(ir_value), device,
-                                   logical_element_type)) {
+    : data_(std::allocate_shared<Data>(PoolAllocator<Data>(),
+                                       std::move(ir_value), device,
+                                       logical_element_type)) {
   TryLimitGraphSize();
 }
 
@@ -618,6 +1048,16 @@ void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data) {
 
 void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data,
                            bool sync) {
+  if (data()->ir_value) {
+    const ir::MetaData& metadata = data()->ir_value.node->metadata();
+    data()->origin = metadata.scope;
+    if (!metadata.frame_info.empty()) {
+      absl::StrAppend(&data()->origin, "@",
+                      metadata.frame_info.front().function);
+    }
+  } else {
+    data()->origin.clear();
+  }
   data()->xla_data = std::move(xla_data);
   // Assigning a device data should always clear the IR node, to allow graph
   // trimming.
@@ -631,6 +1071,7 @@ void XLATensor::SetIrValue(ir::Value ir_value) {
   data()->xla_data = nullptr;
   data()->tensor_data = absl::nullopt;
   AssignIrValue(std::move(ir_value));
+  MarkDirty();
   TryLimitGraphSize();
 }
 
@@ -648,8 +1089,29 @@ void XLATensor::AssignIrValue(ir::Value ir_value) const {
   data()->generation += 1;
 }
 
+void* XLATensor::operator new(size_t size) {
+  return ObjectPool::Allocate(size);
+}
+
+void XLATensor::operator delete(void* ptr, size_t size) {
+  ObjectPool::Deallocate(ptr, size);
+}
+
+void XLATensor::MarkDirty() const {
+  DeviceContextArena::Get()->MarkDirty(data_ptr());
+}
+
+void XLATensor::MarkDirtyIfPending(absl::Span<const XLATensor> tensors) {
+  for (auto& tensor : tensors) {
+    Data* data = tensor.data();
+    if (data->ir_value || (data->xla_data == nullptr && data->tensor_data)) {
+      tensor.MarkDirty();
+    }
+  }
+}
+
 void XLATensor::TryLimitGraphSize() {
-  if (ApplyTraceletCutpoint()) {
+  if (ApplyPartitionCutpoint()) {
     return;
   }
   static const size_t kCheckFrequency =
@@ -716,7 +1178,10 @@ ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
     XLA_TIMED("IrValueTensorToXlaData");
     data = TensorToXlaData(tensor, device);
   }
-  return CreateTensorNode(std::move(data), read_only);
+  return CreateTensorNode(std::move(data), read_only,
+                          IsHostEvaluable(tensor)
+                              ? c10::optional<at::Tensor>(tensor)
+                              : absl::nullopt);
 }
 
 ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
@@ -725,10 +1190,10 @@ ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
   if (IsSpecialScalar(value)) {
     return ir::ops::ScalarOp(std::move(value), type);
   }
-  xla::ComputationClient::DataPtr data =
-      GetDeviceData(value, TensorTypeFromXlaType(type), device);
-  data->SetInfo(
-      std::make_shared<DeviceDataInfo>(/*tensor_id=*/-1, /*read_only=*/true));
+  at::Tensor tensor = swift_xla::ToTensor(value, TensorTypeFromXlaType(type));
+  xla::ComputationClient::DataPtr data = GetDeviceData(tensor, device);
+  data->SetInfo(std::make_shared<DeviceDataInfo>(
+      /*tensor_id=*/-1, /*read_only=*/true, std::move(tensor)));
   return ir::MakeNode<ir::ops::DeviceData>(std::move(data));
 }
 
@@ -766,14 +1231,46 @@ ir::Value XLATensor::GetIrValueForScalar(
   return GetIrValueForScalar(value, type, shape.dimensions(), device);
 }
 
+bool XLATensor::TryEvaluateOnHost() {
+  ir::Value ir_value = CurrentIrValue();
+  if (!ir_value || CurrentTensorData()) {
+    return false;
+  }
+  c10::optional<at::Tensor> tensor = EvaluateOnHost(
+      ir_value, dtype(), GetDevice(),
+      [](const ir::ops::DeviceData& device_data) -> c10::optional<at::Tensor> {
+        auto* info = dynamic_cast<DeviceDataInfo*>(device_data.data()->info());
+        return info != nullptr ? info->host_tensor : absl::nullopt;
+      });
+  if (!tensor) {
+    return false;
+  }
+  // Dropping the IR value keeps the host resident values (like counters
+  // incremented at every step) out of the graphs sent to the device.
+  data()->xla_data = nullptr;
+  data()->tensor_data = std::move(*tensor);
+  AssignIrValue(ir::Value());
+  MarkDirty();
+  return true;
+}
+
 at::Tensor XLATensor::ToTensor(bool detached) {
   at::Tensor tensor(std::unique_ptr<at::AnyScalarBuffer>(nullptr), {});
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
+  if (!tensor_data && TryEvaluateOnHost()) {
+    tensor_data = CurrentTensorData();
+  }
   if (!tensor_data) {
-    DeviceBarrier(GetDevice());
+    // The device data can be the placeholder of an asynchronous operation
+    // still in flight, which has to complete before the data is accessed.
+    xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+    if (xla_data != nullptr) {
+      DeviceDataBarrier(GetDevice(), {xla_data});
+    }
     // The GetXlaData() call will trigger an ApplyPendingGraph() if an IR Node
     // is available on the tensor.
-    std::vector<at::Tensor> tensors = XlaDataToTensors({GetXlaData()}, dtype());
+    xla_data = GetXlaData();
+    std::vector<at::Tensor> tensors = XlaDataToTensors({xla_data}, dtype());
     tensor = std::move(tensors.front());
     if (!detached) {
       SetTensorData(tensor);
@@ -808,6 +1305,21 @@ std::vector<XLATensor> XLATensor::GetLiveTensors(const Device* device) {
   return DeviceContextArena::Get()->GetLiveTensors(device);
 }
 
+void XLATensor::PinDeviceData(
+    absl::Span<const xla::ComputationClient::DataPtr> data) {
+  DeviceContextArena::Get()->PinData(data);
+}
+
+void XLATensor::UnpinDeviceData(
+    absl::Span<const xla::ComputationClient::DataPtr> data) {
+  DeviceContextArena::Get()->UnpinData(data);
+}
+
+std::vector<DeviceMemorySnapshot> XLATensor::GetDeviceMemorySnapshots(
+    const Device* device) {
+  return DeviceContextArena::Get()->GetMemorySnapshots(device);
+}
+
 std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
     const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
     absl::Span<const xla::ComputationClient::DataPtr> tensors_data) {
@@ -868,6 +1380,9 @@ std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
 std::vector<at::Tensor> XLATensor::GetTensors(std::vector<XLATensor>* tensors) {
   static const bool op_by_op =
       xla::sys_util::GetEnvBool("XLA_GET_TENSORS_OPBYOP", false);
+  for (auto& tensor : *tensors) {
+    tensor.TryEvaluateOnHost();
+  }
   return op_by_op ? GetTensorsOpByOp(tensors) : GetTensorsFused(tensors);
 }
 
@@ -924,9 +1439,11 @@ std::vector<XLATensor> XLATensor::CreateTensors(
   return xla_tensors;
 }
 
-ir::Value XLATensor::CreateTensorNode(xla::ComputationClient::DataPtr data,
-                                      bool read_only) const {
-  data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only));
+ir::Value XLATensor::CreateTensorNode(
+    xla::ComputationClient::DataPtr data, bool read_only,
+    c10::optional<at::Tensor> host_tensor) const {
+  data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only,
+                                                 std::move(host_tensor)));
   return ir::MakeNode<ir::ops::DeviceData>(std::move(data));
 }
 
@@ -974,12 +1491,14 @@ XLATensor XLATensor::CreateFrom(ir::Value ir_value, const Device& device,
 }
 
 void XLATensor::ApplyPendingGraph() {
-  DeviceBarrier(GetDevice());
   // This method is called to ensure that the tensor data is available on
   // device, so that a call to CurrentXlaData() returns a valid pointer.
-  if (CurrentXlaData() == nullptr) {
+  xla::ComputationClient::DataPtr xla_data = CurrentXlaData();
+  if (xla_data == nullptr) {
     std::vector<XLATensor> tensors({*this});
     SyncTensorsGraph(&tensors, {}, /*wait=*/true, /*sync_xla_data=*/false);
+  } else {
+    DeviceDataBarrier(GetDevice(), {xla_data});
   }
 }
 
@@ -996,9 +1515,6 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
 
   std::vector<at::Tensor> at_tensors;
   std::vector<size_t> at_tensor_index;
-  // The force_xla_data controls aliasing compilation, so effectively the same
-  // graph with on/off force_xla_data should not match, hash wise.
-  coll.hash = xla::util::MHash(config.force_xla_data);
   coll.config = config;
   coll.device = *unique_device;
   coll.indices.reserve(tensors.size());
@@ -1016,7 +1532,6 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
       if (ir_value) {
         if (ShouldSyncIrValue(ir_value)) {
           // Add only tensors which need to be synced.
-          coll.hash = xla::util::HashCombine(coll.hash, ir_value.hash());
           coll.indices.push_back(i);
         }
       } else if (config.force_xla_data) {
@@ -1029,10 +1544,7 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
       }
     }
   }
-  // Mix the hash with the resource domain hashes as compile handles are only
-  // valid within a domain (usually a single host).
-  coll.hash = xla::util::MHash(
-      coll.hash, xla::GetX10Device(coll.device)->ResourceDomain());
+  coll.hash = ComputeGraphHash(coll, CollectRoots(tensors, coll.indices));
   if (!at_tensors.empty()) {
     XLA_COUNTER("SyncTensorsToData", at_tensors.size());
     std::vector<xla::ComputationClient::DataPtr> handles =
@@ -1050,6 +1562,20 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
   return coll;
 }
 
+xla::hash_t XLATensor::ComputeGraphHash(const SyncTensorCollection& coll,
+                                        absl::Span<const ir::Value> roots) {
+  // The force_xla_data controls aliasing compilation, so effectively the same
+  // graph with on/off force_xla_data should not match, hash wise.
+  xla::hash_t hash = xla::util::MHash(coll.config.force_xla_data);
+  for (auto& root : roots) {
+    hash = xla::util::HashCombine(hash, root.hash());
+  }
+  // Mix the hash with the resource domain hashes as compile handles are only
+  // valid within a domain (usually a single host).
+  return xla::util::MHash(hash,
+                          xla::GetX10Device(coll.device)->ResourceDomain());
+}
+
 XLATensor::ComputationCache::TypePtr XLATensor::LookupCachedCompile(
     const std::vector<XLATensor>& tensors, const xla::hash_t& hash) {
   ComputationCache::TypePtr cached_computation =
@@ -1092,15 +1618,15 @@ XLATensor::ComputationCache* XLATensor::GetComputationCache() {
 }
 
 XLATensor::PostOrderData XLATensor::RunPostOrder(
-    const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
-  std::vector<const ir::Node*> roots;
-  roots.reserve(indices.size());
-  for (auto index : indices) {
-    ir::Value ir_value = tensors.at(index).CurrentIrValue();
-    roots.push_back(ir_value.node.get());
+    absl::Span<const ir::Value> roots) {
+  std::vector<const ir::Node*> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (auto& root : roots) {
+    root_nodes.push_back(root.node.get());
   }
   PostOrderData po_data;
-  po_data.post_order = ir::Util::ComputePostOrder(roots, &po_data.emission_map);
+  po_data.post_order =
+      ir::Util::ComputePostOrder(root_nodes, &po_data.emission_map);
   absl::node_hash_map<xla::ComputationClient::Data::OpaqueHandle, size_t>
       data_handles;
   for (auto node : po_data.post_order) {
@@ -1144,7 +1670,8 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
     // asynchronously, if a tensor does not already have device data, we need to
     // install a placeholder. Since at this point we hold a lock on the device
     // where the tensors reside (locks held within the coll structure, and moved
-    // into the async variable), any other operation trying to access the
+    // into the async variable), the placeholders are registered as pending
+    // within the device locker, and any other operation trying to access the
     // tensor's device data will have to wait until the asynchronous operation
     // completes.
     xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
@@ -1158,6 +1685,11 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::FetchTensorData(
     }
     tensors_data.emplace_back(std::move(xla_data));
   }
+  if (!indices.empty()) {
+    DeviceLockerArena::Get()
+        ->GetLocker((*tensors)[indices.front()].GetDevice())
+        ->AddPendingData(tensors_data);
+  }
   return tensors_data;
 }
 
@@ -1175,12 +1707,27 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     try {
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " ...";
+      int64_t start_time = xla::sys_util::NowNs();
       auto results =
           xla::GetX10Device(async->device)
               ->ExecuteComputation(*async->cached_computation->computation,
                                    async->parameters_data, options);
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " done!";
+      GraphProfiler* profiler = GraphProfiler::Get();
+      if (profiler != nullptr) {
+        int64_t execute_time = xla::sys_util::NowNs() - start_time;
+        int64_t input_bytes = 0;
+        for (auto& data : async->parameters_data) {
+          input_bytes += data->bytes();
+        }
+        int64_t output_bytes = 0;
+        for (auto& data : results) {
+          output_bytes += data->bytes();
+        }
+        profiler->RecordExecute(hash, execute_time, input_bytes,
+                                output_bytes);
+      }
 
       for (size_t i = 0; i < results.size(); ++i) {
         if (async->tensors_data[i] != nullptr) {
@@ -1207,6 +1754,13 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     }
   };
 
+  // The parameter buffers and the computation are only needed by the
+  // execution, so drop them once it completes rather than when the last holder
+  // of the Async goes away. The closure holds the Async alive until then.
+  async->mwait.OnDone([async = async.get()](std::exception_ptr) {
+    async->parameters_data.clear();
+    async->cached_computation = nullptr;
+  });
   xla::env::ScheduleIoClosure(async->mwait.Completer(std::move(syncfn)));
   return async;
 }
@@ -1221,14 +1775,91 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
                                   std::move(cached_computation));
 }
 
+std::shared_ptr<XLATensor::Async> XLATensor::ScheduleOpByOpSyncTensorsGraph(
+    std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+    std::vector<ir::Value> roots, absl::Span<const std::string> devices) {
+  auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
+  std::shared_ptr<Async> async = std::make_shared<Async>(
+      coll, /*parameters_data=*/std::vector<xla::ComputationClient::DataPtr>(),
+      std::move(tensors_data), /*cached_computation=*/nullptr);
+
+  auto syncfn = [async, hash = coll->hash, roots = std::move(roots),
+                 devices = std::vector<std::string>(devices.begin(),
+                                                    devices.end())]() {
+    try {
+      XLA_TIMED("OpByOpFallbackExecuteTime");
+      TF_VLOG(3) << "Executing (OpByOp fallback) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " ...";
+      std::vector<xla::ComputationClient::DataPtr> results =
+          OpByOpExecutor::Get()->Execute(roots, async->device, devices);
+      TF_VLOG(3) << "Executing (OpByOp fallback) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " done!";
+
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (async->tensors_data[i] != nullptr) {
+          async->tensors_data[i]->Assign(*results[i]);
+        } else {
+          async->tensors_data[i] = std::move(results[i]);
+        }
+      }
+    } catch (...) {
+      std::exception_ptr exptr = std::current_exception();
+      for (auto& unlocker : async->unlocker) {
+        unlocker.SetStatus(exptr);
+      }
+    }
+  };
+
+  xla::env::ScheduleIoClosure(async->mwait.Completer(std::move(syncfn)));
+  return async;
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::TryCompileInBackground(
+    BackgroundCompiler* background_compiler, std::vector<XLATensor>* tensors,
+    absl::Span<const std::string> devices, SyncTensorCollection* coll,
+    absl::Span<const ir::Value> roots, const PostOrderData& po_data) {
+  // The compilation works on its own copy of the collection, as the device
+  // locks move to the op-by-op execution of the current step, and on a copy of
+  // the graph which only holds the shapes of the parameters, as their buffers
+  // can be released (or donated) while the compilation is queued.
+  auto compile_coll = std::make_shared<SyncTensorCollection>();
+  compile_coll->config = coll->config;
+  compile_coll->indices = coll->indices;
+  compile_coll->hash = coll->hash;
+  compile_coll->device = coll->device;
+  auto compile_fn = [compile_coll, output_aliases = po_data.output_aliases,
+                     roots = DetachParametersData(roots, po_data.post_order),
+                     devices = std::vector<std::string>(devices.begin(),
+                                                        devices.end())]() {
+    PostOrderData compile_po_data = RunPostOrder(roots);
+    compile_po_data.output_aliases = output_aliases;
+    CompilationResult compile_result =
+        Compile(devices, *compile_coll, roots, &compile_po_data);
+    XLA_VALUE_METRIC("TensorsGraphSize", compile_result.emitted_nodes);
+    GetComputationCache()->Add(compile_coll->hash,
+                               std::make_shared<CachedComputation>(
+                                   std::move(compile_result.computation)));
+  };
+  BackgroundCompiler::Status status =
+      background_compiler->Schedule(coll->hash, std::move(compile_fn));
+  if (status == BackgroundCompiler::Status::kFailed ||
+      status == BackgroundCompiler::Status::kQueueFull) {
+    return nullptr;
+  }
+  XLA_COUNTER("OpByOpFallbackSteps", 1);
+  return ScheduleOpByOpSyncTensorsGraph(
+      tensors, coll, std::vector<ir::Value>(roots.begin(), roots.end()),
+      devices);
+}
+
 void XLATensor::SyncTensorsGraph(std::vector<XLATensor>* tensors,
                                  absl::Span<const std::string> devices,
                                  bool wait, bool sync_xla_data) {
-  static const bool op_by_op =
-      xla::sys_util::GetEnvBool("XLA_SYNC_TENSORS_OPBYOP", false);
   SyncTensorsConfig config;
   config.sync_xla_data = sync_xla_data;
-  if (op_by_op) {
+  if (SyncTensorsOpByOpEnabled()->load()) {
     OpByOpAsync async = SyncTensorsGraphOpByOp(tensors, devices, config);
     if (wait) {
       async.Wait();
@@ -1241,15 +1872,32 @@ void XLATensor::SyncTensorsGraph(std::vector<XLATensor>* tensors,
   }
 }
 
+void XLATensor::SetSyncTensorsOpByOp(bool enabled) {
+  SyncTensorsOpByOpEnabled()->store(enabled);
+}
+
+void XLATensor::SetParallelLowering(bool enabled, size_t min_nodes) {
+  ParallelLoweringEnabled()->store(enabled);
+  ParallelLoweringMinNodes()->store(min_nodes);
+  GetComputationCache()->Clear();
+}
+
 void XLATensor::SyncLiveTensorsGraph(const Device* device,
                                      absl::Span<const std::string> devices,
                                      bool wait) {
-  auto tensors = GetLiveTensors(device);
+  // Only the tensors which got pending IR or host only data since the last
+  // sync can need one, so the other live tensors are not visited.
+  auto tensors = DeviceContextArena::Get()->GetDirtyTensors(device);
+  XLA_COUNTER("SyncLiveDirtyTensors", tensors.size());
   if (tensors.empty()) {
     return;
   }
-  TF_VLOG(4) << tensors.size() << " live tensors: devices=("
+  TF_VLOG(4) << tensors.size() << " dirty live tensors: devices=("
              << absl::StrJoin(devices, ",") << ")";
+  xla::util::ExceptionCleanup mark_pending(
+      [&](xla::util::ExceptionCleanup::StatusType) {
+        MarkDirtyIfPending(tensors);
+      });
   SyncTensorsGraph(&tensors, devices, wait, /*sync_xla_data=*/true);
 }
 
@@ -1258,6 +1906,11 @@ void XLATensor::MarkStep(const Device* device) {
   DeviceContextArena::Get()->StepRngSeed(device);
   ir::ScopePusher::ResetScopes();
   g_tls_data.Reset();
+  DeviceContextArena::Get()->MarkStepMemory(device);
+  GraphPartitioner* partitioner = GraphPartitioner::Get();
+  if (partitioner != nullptr) {
+    partitioner->MarkStep();
+  }
 }
 
 XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
@@ -1318,59 +1971,141 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
   return async_op.Schedule();
 }
 
-void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                        absl::Span<const size_t> indices,
-                                        ir::LoweringContext* lowering_ctx) {
+void XLATensor::ComputeDonatedParameters(
+    const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+    absl::Span<const ir::Value> roots, PostOrderData* po_data) {
+  static const bool enable_aliasing =
+      xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", true);
+  po_data->output_aliases.assign(roots.size(), -1);
+  if (!enable_aliasing || !coll.config.sync_xla_data ||
+      po_data->parameters_data.empty()) {
+    return;
+  }
+  // A parameter buffer can be donated to an output of the computation when
+  // nothing can read it after the computation has run. The tensors being
+  // synced get their IR graphs replaced by the outputs, so only the references
+  // held by the other live tensors of the device, and the pins, need to be
+  // checked.
+  absl::flat_hash_set<int64_t> synced_ids;
   absl::node_hash_map<int64_t, size_t> output_tensor_id_map;
-  for (size_t i = 0; i < indices.size(); ++i) {
-    size_t tensor_index = indices[i];
-    int64_t tensor_id = tensors[tensor_index].GetUniqueId();
+  for (size_t i = 0; i < coll.indices.size(); ++i) {
+    int64_t tensor_id = tensors[coll.indices[i]].GetUniqueId();
+    synced_ids.insert(tensor_id);
     output_tensor_id_map[tensor_id] = i;
   }
+  absl::flat_hash_set<const xla::ComputationClient::Data*> referenced_data =
+      DeviceContextArena::Get()->GetReferencedData(coll.device, synced_ids);
+  int64_t donated_bytes = 0;
+  for (size_t i = 0; i < po_data->parameters_data.size(); ++i) {
+    const xla::ComputationClient::DataPtr& data = po_data->parameters_data[i];
+    DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data->info());
+    if (data_info == nullptr || data_info->read_only ||
+        referenced_data.contains(data.get())) {
+      continue;
+    }
+    // Prefer the output of the tensor the data was uploaded for, which is the
+    // in-place update case, and fall back to any output of the same shape.
+    int64_t output_index = -1;
+    auto it = output_tensor_id_map.find(data_info->tensor_id);
+    if (it != output_tensor_id_map.end() &&
+        po_data->output_aliases[it->second] < 0 &&
+        xla::ShapeUtil::Compatible(roots[it->second].shape(), data->shape())) {
+      output_index = it->second;
+    }
+    for (size_t j = 0; j < roots.size() && output_index < 0; ++j) {
+      if (po_data->output_aliases[j] < 0 &&
+          xla::ShapeUtil::Compatible(roots[j].shape(), data->shape())) {
+        output_index = j;
+      }
+    }
+    if (output_index >= 0) {
+      po_data->output_aliases[output_index] = i;
+      donated_bytes += xla::ShapeUtil::ByteSizeOfElements(data->shape());
+    }
+  }
+  if (donated_bytes > 0) {
+    // Each donated buffer is one less copy of the tensor living on the device
+    // while the computation runs.
+    static xla::metrics::Metric* donated_bytes_metric =
+        new xla::metrics::Metric("DonatedBytes", xla::metrics::MetricFnBytes);
+    donated_bytes_metric->AddSample(donated_bytes);
+    XLA_COUNTER("DonatedBuffers",
+                std::count_if(po_data->output_aliases.begin(),
+                              po_data->output_aliases.end(),
+                              [](int64_t alias) { return alias >= 0; }));
+  }
+}
+
+void XLATensor::BuildInputOutputAliases(
+    absl::Span<const int64_t> output_aliases,
+    ir::LoweringContext* lowering_ctx) {
   const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
       lowering_ctx->GetParametersData();
-  std::vector<ssize_t> alias_map(indices.size(), -1);
-  for (size_t i = 0; i < parameters_data.size(); ++i) {
-    DeviceDataInfo* data_info =
-        dynamic_cast<DeviceDataInfo*>(parameters_data[i]->info());
-    if (data_info != nullptr && !data_info->read_only) {
-      auto it = output_tensor_id_map.find(data_info->tensor_id);
-      if (it != output_tensor_id_map.end()) {
-        size_t output_index = it->second;
-        xla::XlaOp root = lowering_ctx->GetResult(output_index);
-        const xla::Shape& root_shape = XlaHelpers::ShapeOfXlaOp(root);
-        if (parameters_data[i]->shape() == root_shape &&
-            alias_map[output_index] < 0) {
-          lowering_ctx->builder()->SetUpAlias(
-              {static_cast<int64_t>(output_index)}, i, {});
-          alias_map[output_index] = i;
-
-          TF_VLOG(6) << "Aliased paramter " << i << " with output "
-                     << output_index << ": " << parameters_data[i]->shape();
-        }
-      }
+  size_t alias_count = 0;
+  for (size_t output_index = 0; output_index < output_aliases.size();
+       ++output_index) {
+    int64_t i = output_aliases[output_index];
+    if (i < 0) {
+      continue;
+    }
+    xla::XlaOp root = lowering_ctx->GetResult(output_index);
+    const xla::Shape& root_shape = XlaHelpers::ShapeOfXlaOp(root);
+    if (parameters_data[i]->shape() == root_shape) {
+      lowering_ctx->builder()->SetUpAlias(
+          {static_cast<int64_t>(output_index)}, i, {});
+      alias_count += 1;
+
+      TF_VLOG(6) << "Aliased paramter " << i << " with output " << output_index
+                 << ": " << parameters_data[i]->shape();
     }
   }
-  XLA_VALUE_METRIC("InputOutputAliasCount", alias_map.size());
+  XLA_VALUE_METRIC("InputOutputAliasCount", alias_count);
 }
 
 XLATensor::CompilationResult XLATensor::Compile(
-    const std::vector<XLATensor>& tensors,
     absl::Span<const std::string> devices, const SyncTensorCollection& coll,
-    PostOrderData* po_data) {
-  static const bool enable_aliasing =
-      xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", false);
-  xla::util::Unique<Device> unique_device;
-  ir::RootLoweringContext lowering_ctx("SyncTensorsGraph", coll.device,
-                                       po_data->post_order,
-                                       std::move(po_data->emission_map));
-  for (auto index : coll.indices) {
-    ir::Value ir_value = tensors[index].CurrentIrValue();
-    xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
-    lowering_ctx.AddResult(root);
-    unique_device.set(tensors[index].GetDevice());
-  }
-  if (enable_aliasing && coll.config.sync_xla_data) {
+    absl::Span<const ir::Value> roots, PostOrderData* po_data) {
+  static const size_t parallel_lowering_threads = xla::sys_util::GetEnvInt(
+      "XLA_PARALLEL_LOWERING_THREADS", std::thread::hardware_concurrency());
+  static const size_t outline_min_nodes =
+      xla::sys_util::GetEnvInt("XLA_IR_OUTLINE_MIN_NODES", 32);
+  int64_t start_time = xla::sys_util::NowNs();
+  // The outlining only runs for the graphs missing from the computation cache.
+  // It is deterministic, so the hash of the graph before outlining, which the
+  // cache lookup used, identifies the outlined graph as well.
+  std::vector<ir::Value> outlined_roots;
+  if (ir::IsGraphOutliningEnabled()) {
+    XLA_TIMED("IrOutlineGraph");
+    outlined_roots = ir::OutlineRepeatedSubgraphs(roots, outline_min_nodes);
+    roots = outlined_roots;
+    po_data->post_order = ComputeOutlinedPostOrder(
+        roots, po_data->post_order, &po_data->emission_map);
+  }
+  std::unique_ptr<ir::RootLoweringContext> lowering_ctx_ptr;
+  absl::optional<size_t> emitted_nodes;
+  {
+    XLA_TIMED("IrLoweringTime");
+    if (ParallelLoweringEnabled()->load() && roots.size() > 1 &&
+        po_data->post_order.size() >= ParallelLoweringMinNodes()->load()) {
+      lowering_ctx_ptr = absl::make_unique<ir::RootLoweringContext>(
+          "SyncTensorsGraph", coll.device);
+      emitted_nodes = ir::LowerInParallel(
+          po_data->post_order, roots, po_data->parameters_data,
+          parallel_lowering_threads, lowering_ctx_ptr.get());
+    }
+    if (!emitted_nodes) {
+      lowering_ctx_ptr = absl::make_unique<ir::RootLoweringContext>(
+          "SyncTensorsGraph", coll.device, po_data->post_order,
+          std::move(po_data->emission_map));
+      for (size_t i = 0; i < coll.indices.size(); ++i) {
+        xla::XlaOp root = lowering_ctx_ptr->GetOutputOp(roots[i]);
+        lowering_ctx_ptr->AddResult(root);
+      }
+      emitted_nodes = lowering_ctx_ptr->GetEmittedNodeCount();
+    }
+  }
+  ir::RootLoweringContext& lowering_ctx = *lowering_ctx_ptr;
+  if (coll.config.sync_xla_data) {
     // We can only alias at the step barrier, when force_xla_data is true.
     // Consider the case:
     //   1. Tensor A(DEVICE_DATA)
@@ -1394,11 +2129,15 @@ XLATensor::CompilationResult XLATensor::Compile(
     // include all live tensors, if the B value is not part of the graph, it
     // will later fetch the new value of A, which is incorrect.
     // But, when we issue a step barrier (force_xla_data == true) we have to
-    // turn everything into DEVICE_DATA, so we can activate aliasing.
-    BuildInputOutputAliases(tensors, coll.indices, &lowering_ctx);
+    // turn everything into DEVICE_DATA, so we can activate aliasing for the
+    // parameters which ComputeDonatedParameters() found exclusively owned.
+    BuildInputOutputAliases(po_data->output_aliases, &lowering_ctx);
   }
 
-  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  xla::XlaComputation computation = [&]() {
+    XLA_TIMED("XlaBuildTime");
+    return ConsumeValue(lowering_ctx.Build());
+  }();
   xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
   xla::Shape shape =
       MakeShapeWithDeviceLayout(program_shape.result(), coll.device.hw_type);
@@ -1409,11 +2148,13 @@ XLATensor::CompilationResult XLATensor::Compile(
   TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
              << " on device " << coll.device << " ...";
   std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
-      computations =
-          xla::GetX10Device(coll.device.ToString())
-              ->Compile(xla::ComputationClient::GetCompilationDevices(
-                            coll.device.ToString(), devices),
-                        std::move(instances));
+      computations = [&]() {
+        XLA_TIMED("XlaCompileTime");
+        return xla::GetX10Device(coll.device.ToString())
+            ->Compile(xla::ComputationClient::GetCompilationDevices(
+                          coll.device.ToString(), devices),
+                      std::move(instances));
+      }();
   TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
              << " on device " << coll.device << " done!";
   TF_VLOG(5)
@@ -1423,9 +2164,14 @@ XLATensor::CompilationResult XLATensor::Compile(
              computations.front()->computation().proto().SerializeAsString()));
   XLA_CHECK_EQ(program_shape.parameters_size(),
                po_data->parameters_data.size());
+  GraphProfiler* profiler = GraphProfiler::Get();
+  if (profiler != nullptr) {
+    profiler->RecordCompile(coll.hash, roots, *emitted_nodes,
+                            xla::sys_util::NowNs() - start_time);
+  }
 
   return {/*device=*/coll.device,
-          /*emitted_nodes=*/lowering_ctx.GetEmittedNodeCount(),
+          /*emitted_nodes=*/*emitted_nodes,
           /*computation=*/std::move(computations.front()),
           /*parameters_data=*/std::move(po_data->parameters_data)};
 }
@@ -1440,18 +2186,42 @@ std::shared_ptr<XLATensor::Async> XLATensor::SyncTensorsGraphInternal(
   DebugUtil::SaveTensorsGraphInfo("ScheduleSyncTensorsGraph", *tensors,
                                   &coll.indices);
 
-  PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
-  InsertTraceletCutpoint(po_data);
-  coll.hash = xla::util::HashCombine(
-      coll.hash, xla::util::Hash(po_data.parameter_sequence));
+  std::vector<ir::Value> roots = CollectRoots(*tensors, coll.indices);
+  if (ir::IsGraphOptimizationEnabled()) {
+    XLA_TIMED("IrOptimizeGraph");
+    roots = ir::OptimizeGraph(roots);
+    // Cached computations are looked up by the hash of the rewritten graph, as
+    // that is the one which gets compiled.
+    coll.hash = ComputeGraphHash(coll, roots);
+  }
+  PostOrderData po_data = RunPostOrder(roots);
+  ComputeDonatedParameters(*tensors, coll, roots, &po_data);
+  // The donations are baked into the compiled computation, so they are part of
+  // its cache key.
+  coll.hash = xla::util::MHash(coll.hash, po_data.parameter_sequence,
+                               po_data.output_aliases);
   TF_VLOG(4) << "Parameter sequence graph hash "
              << xla::util::HexHash(coll.hash);
   std::shared_ptr<Async> async = TryRunCachedSync(tensors, &coll, &po_data);
+  GraphPartitioner* partitioner = GraphPartitioner::Get();
+  if (partitioner != nullptr) {
+    partitioner->RecordSync(po_data.post_order, async != nullptr);
+  }
   if (async != nullptr) {
     return async;
   }
 
-  CompilationResult compile_result = Compile(*tensors, devices, coll, &po_data);
+  BackgroundCompiler* background_compiler = BackgroundCompiler::Get();
+  if (background_compiler != nullptr) {
+    async =
+        TryCompileInBackground(background_compiler, tensors, devices, &coll,
+                               roots, po_data);
+    if (async != nullptr) {
+      return async;
+    }
+  }
+
+  CompilationResult compile_result = Compile(devices, coll, roots, &po_data);
 
   XLA_VALUE_METRIC("TensorsGraphSize", compile_result.emitted_nodes);
   TF_VLOG(5) << "TensorsGraphSize=" << compile_result.emitted_nodes;
@@ -1474,89 +2244,64 @@ void XLATensor::SetRngSeed(const Device* device, uint64_t seed) {
   DeviceContextArena::Get()->SetRngSeed(device, seed);
 }
 
+void XLATensor::WaitDeviceData(
+    absl::Span<const xla::ComputationClient::DataPtr> data) {
+  for (auto& xla_data : data) {
+    DeviceDataBarrier(xla_data->device()->device_id(), {xla_data});
+  }
+}
+
+void XLATensor::WaitDeviceOps(absl::Span<const std::string> devices) {
+  std::set<Device> wait_devices;
+  if (!devices.empty()) {
+    for (auto& device_str : devices) {
+      wait_devices.insert(Device(device_str));
+    }
+  } else {
+    for (auto& device_str : xla::ComputationClient::AllDevices()) {
+      wait_devices.insert(Device(device_str));
+    }
+  }
+  // The LockDevices() API returns a vector of xla::util::ExceptionCleanup
+  // objects, which are freed right away, turning this into a lock barrier.
+  LockDevices(wait_devices);
+}
+
 uint64_t XLATensor::GetRunningSeed(const Device& device) {
   return DeviceContextArena::Get()->GetRunningSeed(device);
 }
 
-bool XLATensor::ApplyTraceletCutpoint() {
-  static const bool tracelets =
-      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
-  if (!tracelets) {
+bool XLATensor::ApplyPartitionCutpoint() {
+  GraphPartitioner* partitioner = GraphPartitioner::Get();
+  if (partitioner == nullptr || !data()->ir_value) {
     return false;
   }
-  if (!data()->ir_value) {
+  absl::optional<GraphPartitioner::Role> role =
+      partitioner->FindCut(data()->ir_value.node->hash());
+  if (!role) {
     return false;
   }
-  xla::hash_t hash = data()->ir_value.node->hash();
-  if (g_tracelet_state.cutpoints.find(hash) !=
-      g_tracelet_state.cutpoints.end()) {
-    ApplyPendingGraph();
-    return true;
-  }
-  return false;
-}
-
-void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data) {
-  // Wait for steady state: don't trigger any tracelet detection for the first
-  // two steps.
-  static const int64_t kSteadyStateStep = 3;
-  static const bool tracelets =
-      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
-  if (!tracelets) {
-    return;
-  }
-  xla::metrics::CounterData* mark_step = xla::metrics::GetCounter("MarkStep");
-  int64_t steps = mark_step ? mark_step->Value() : 0;
-  if (steps < kSteadyStateStep) {
-    return;
-  }
-  // For the first steady state step, just record number of compilations seen so
-  // far and return.
-  if (steps == kSteadyStateStep) {
-    xla::metrics::CounterData* uncached_compile =
-        xla::metrics::GetCounter("UncachedCompile");
-    if (uncached_compile) {
-      g_tracelet_state.prev_uncached_compile = uncached_compile->Value();
-    }
-    return;
-  }
-  xla::metrics::CounterData* uncached_compile =
-      xla::metrics::GetCounter("UncachedCompile");
-  XLA_CHECK_GE(uncached_compile->Value(),
-               g_tracelet_state.prev_uncached_compile);
-  if (!uncached_compile ||
-      uncached_compile->Value() == g_tracelet_state.prev_uncached_compile) {
-    // No new compilations, nothing to do.
-    return;
-  }
-  XLA_CHECK(!po_data.post_order.empty());
-  // Construct the new tracelet out of post-order nodes.
-  // TODO(asuhan): Consider all nodes as possible tracelet start?
-  std::vector<xla::hash_t> po_trace;
-  for (const ir::Node* node : po_data.post_order) {
-    po_trace.push_back(node->hash());
-  }
-  xla::hash_t trace_key = po_data.post_order.front()->hash();
-  const auto tracelet_it = g_tracelet_state.tracelet_by_prefix.find(trace_key);
-  if (tracelet_it != g_tracelet_state.tracelet_by_prefix.end()) {
-    // Old tracelet found starting with the same prefix as current trace. We
-    // might need to check if the two diverge and shorten it further, up to the
-    // point of divergence.
-    const auto divergent_node =
-        FindTraceDivergence(tracelet_it->second, po_trace);
-    if (divergent_node &&
-        po_data.post_order[*divergent_node]->op() != ir::ops::xla_device_data) {
-      const auto cutpoint_it = po_trace.begin() + *divergent_node;
-      g_tracelet_state.tracelet_by_prefix[trace_key] =
-          std::vector<xla::hash_t>(po_trace.begin(), cutpoint_it);
-      g_tracelet_state.cutpoints.insert(*(cutpoint_it - 1));
-    }
-  } else {
-    const auto tracelet_it_ok =
-        g_tracelet_state.tracelet_by_prefix.emplace(trace_key, po_trace);
-    XLA_CHECK(tracelet_it_ok.second);
-  }
-  g_tracelet_state.prev_uncached_compile = uncached_compile->Value();
+  XLA_COUNTER("PartitionCuts", 1);
+  // All the pending computations are synced, and not only this tensor's, for
+  // the partition to be closed. This tensor is not yet registered with the
+  // arena when it is being constructed, so it is added explicitly.
+  std::vector<XLATensor> tensors =
+      DeviceContextArena::Get()->GetDirtyTensors(&GetDevice());
+  bool live = false;
+  for (const XLATensor& tensor : tensors) {
+    live |= tensor.data() == data();
+  }
+  if (!live) {
+    tensors.push_back(*this);
+  }
+  xla::util::ExceptionCleanup mark_pending(
+      [&](xla::util::ExceptionCleanup::StatusType) {
+        MarkDirtyIfPending(tensors);
+      });
+  partitioner->SetCutRole(role);
+  SyncTensorsGraph(&tensors, {}, /*wait=*/false, /*sync_xla_data=*/true);
+  partitioner->SetCutRole(absl::nullopt);
+  return true;
 }
 
 }  // namespace swift_xla
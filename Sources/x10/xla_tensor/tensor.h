@@ -16,13 +16,16 @@
 
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
+#include "tensorflow/compiler/tf2xla/xla_tensor/background_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/device_memory.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
@@ -60,6 +63,11 @@ class XLATensor {
   // Creates an empty/null tensor.
   XLATensor() = default;
 
+  // The tensor handles returned by the C API are allocated for every traced
+  // operation, so they come from the ObjectPool.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
   bool is_null() const { return data_ptr() == nullptr; }
 
   size_t generation() const { return data()->generation; }
@@ -109,6 +117,11 @@ class XLATensor {
   // Applies the queue of operations in preparation for using the data.
   void ApplyPendingGraph();
 
+  // Evaluates the pending IR graph on the host if it is tiny and only depends
+  // on host resident values, in which case the tensor becomes host resident
+  // (see EvaluateOnHost()). Returns whether the evaluation happened.
+  bool TryEvaluateOnHost();
+
   static ir::Value GetIrValueForScalar(at::Scalar value,
                                        xla::PrimitiveType type,
                                        const Device& device);
@@ -151,6 +164,21 @@ class XLATensor {
   // key, and by unique ID as secondary key.
   static std::vector<XLATensor> GetLiveTensors(const Device* device);
 
+  // Keeps the given device data from being donated to the computations, while
+  // they are referenced from outside of the tensors (like by an in-flight
+  // checkpoint). Pins are counted, and released with UnpinDeviceData().
+  static void PinDeviceData(
+      absl::Span<const xla::ComputationClient::DataPtr> data);
+  static void UnpinDeviceData(
+      absl::Span<const xla::ComputationClient::DataPtr> data);
+
+  // Takes a snapshot of the device memory held by the live buffers of the given
+  // device (or of all the devices, if nullptr), attributed to the origins of
+  // the live tensors holding them. Meant for leak hunting and for sizing the
+  // batches, its cost is only paid when called.
+  static std::vector<DeviceMemorySnapshot> GetDeviceMemorySnapshots(
+      const Device* device);
+
   // Applies all the pending IR operations queued over the input tensors. All
   // the tensors must be on the same device. If wait is true, the sync operation
   // will be run synchronously. The devices argument, if not empty, tells the
@@ -159,6 +187,16 @@ class XLATensor {
                                absl::Span<const std::string> devices, bool wait,
                                bool sync_xla_data);
 
+  // Sets whether SyncTensorsGraph() runs the graphs op by op, overriding
+  // XLA_SYNC_TENSORS_OPBYOP.
+  static void SetSyncTensorsOpByOp(bool enabled);
+
+  // Sets whether the graphs of at least min_nodes nodes are lowered in
+  // parallel, overriding XLA_PARALLEL_LOWERING and
+  // XLA_PARALLEL_LOWERING_MIN_NODES. Drops the cached computations, so that
+  // the next graphs get lowered again.
+  static void SetParallelLowering(bool enabled, size_t min_nodes);
+
   // Makes sure that any outstanding IR operation accumulated over live tensors,
   // gets turned into device data. If wait is true, the sync operation will be
   // run synchronously. The devices argument, if not empty, tells the devices
@@ -175,6 +213,11 @@ class XLATensor {
   // If devices is empty, the wait will happen for all local devices.
   static void WaitDeviceOps(absl::Span<const std::string> devices);
 
+  // Waits for the outstanding operations producing the given device data, so
+  // that it can be read.
+  static void WaitDeviceData(
+      absl::Span<const xla::ComputationClient::DataPtr> data);
+
   // Retrieves the CPU tensors behind the XLA tensors IR operations. All the
   // tensors must be on the same device.
   static std::vector<at::Tensor> GetTensors(std::vector<XLATensor>* tensors);
@@ -218,10 +261,42 @@ class XLATensor {
   static XLATensor get_dimensions_size(const XLATensor& input,
                                        std::vector<int64_t> dimensions);
 
+  // Marks dimension dim of input as dynamic, with its runtime size given by the
+  // size scalar tensor. The static size of dim becomes the upper bound.
+  static XLATensor set_dimension_size(const XLATensor& input,
+                                      const XLATensor& size, int64_t dim);
+
   static std::vector<XLATensor> user_computation(
       const std::string& opname, absl::Span<const XLATensor> inputs,
       ComputationPtr computation);
 
+  // Fused Adam update of a group of weights, returning the updated weights
+  // followed by the updated first and second moments. The hyperparameters are
+  // scalar tensors, so that changing them does not recompile the graph.
+  static std::vector<XLATensor> multi_tensor_adam(
+      absl::Span<const XLATensor> weights, absl::Span<const XLATensor> grads,
+      absl::Span<const XLATensor> first_moments,
+      absl::Span<const XLATensor> second_moments,
+      const XLATensor& learning_rate, const XLATensor& beta1,
+      const XLATensor& beta2, const XLATensor& weight_decay, double epsilon);
+
+  // Fused SGD (with momentum) update of a group of weights, returning the
+  // updated weights followed by the updated velocities.
+  static std::vector<XLATensor> multi_tensor_sgd(
+      absl::Span<const XLATensor> weights, absl::Span<const XLATensor> grads,
+      absl::Span<const XLATensor> velocities, const XLATensor& learning_rate,
+      const XLATensor& momentum, const XLATensor& weight_decay,
+      bool nesterov);
+
+  // Returns the elements of the given tensors, which share their element type,
+  // concatenated in a single flat vector.
+  static XLATensor flat_pack(absl::Span<const XLATensor> tensors);
+
+  // Splits a flat vector back into tensors of the given dimensions, the way
+  // flat_pack laid them out.
+  static std::vector<XLATensor> flat_unpack(
+      const XLATensor& flat, std::vector<std::vector<int64_t>> dimensions);
+
   //////////////////////////////////////////////////////////////////////////////
   // ATEN operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
@@ -310,6 +385,9 @@ class XLATensor {
     ir::Util::EmissionMap emission_map;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::vector<size_t> parameter_sequence;
+    // For each output of the computation, the index of the parameter whose
+    // buffer is donated to it, or -1.
+    std::vector<int64_t> output_aliases;
   };
 
   struct CompilationResult {
@@ -378,6 +456,12 @@ class XLATensor {
     const Device device;
     const int64_t unique_id = 0;
     size_t generation = 1;
+    // The IR scope of the graph which computed xla_data, for the device memory
+    // snapshots. Empty if xla_data was uploaded from host data.
+    std::string origin;
+    // Whether the tensor is in the dirty set of the live tensors registry,
+    // which the live tensors syncs walk instead of all the live tensors.
+    std::atomic<bool> dirty{false};
   };
 
   XLATensor(const at::Tensor& tensor, const Device& device);
@@ -398,10 +482,20 @@ class XLATensor {
 
   void AssignIrValue(ir::Value ir_value) const;
 
+  // Adds the tensor to the set of the live tensors visited by the next
+  // SyncLiveTensorsGraph() call.
+  void MarkDirty() const;
+
+  // Marks again the tensors collected from the dirty set which still hold
+  // pending IR or host only data, because the sync skipped them or failed.
+  static void MarkDirtyIfPending(absl::Span<const XLATensor> tensors);
+
   void SetTensorData(at::Tensor tensor_data);
 
-  ir::Value CreateTensorNode(xla::ComputationClient::DataPtr data,
-                             bool read_only) const;
+  // The host_tensor is the host copy of the data content, if available.
+  ir::Value CreateTensorNode(
+      xla::ComputationClient::DataPtr data, bool read_only,
+      c10::optional<at::Tensor> host_tensor = absl::nullopt) const;
 
   XLATensor CopyTensorToDevice(const Device& device);
 
@@ -458,6 +552,11 @@ class XLATensor {
   static std::vector<ir::Value> CollectRoots(
       const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices);
 
+  // Computes the hash of the graph with the given roots, which identifies its
+  // compiled computation within the device and configuration of coll.
+  static xla::hash_t ComputeGraphHash(const SyncTensorCollection& coll,
+                                      absl::Span<const ir::Value> roots);
+
   static std::vector<xla::ComputationClient::DataPtr> FetchTensorData(
       std::vector<XLATensor>* tensors, const SyncTensorsConfig& config,
       absl::Span<const size_t> indices);
@@ -476,8 +575,7 @@ class XLATensor {
       std::vector<xla::ComputationClient::DataPtr> parameters_data,
       std::string device, ComputationCache::TypePtr cached_computation);
 
-  static PostOrderData RunPostOrder(const std::vector<XLATensor>& tensors,
-                                    absl::Span<const size_t> indices);
+  static PostOrderData RunPostOrder(absl::Span<const ir::Value> roots);
 
   static ComputationCache::TypePtr LookupCachedCompile(
       const std::vector<XLATensor>& tensors, const xla::hash_t& hash);
@@ -486,32 +584,51 @@ class XLATensor {
       std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
       PostOrderData* po_data);
 
-  static void BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                      absl::Span<const size_t> indices,
+  // Selects the parameters of the computation whose buffers can be donated to
+  // its outputs, which are the ones no other live tensor references, and
+  // stores them within po_data->output_aliases. Donation is enabled by default,
+  // and can be disabled with XLA_ENABLE_PARAM_ALIASING=0.
+  static void ComputeDonatedParameters(const std::vector<XLATensor>& tensors,
+                                       const SyncTensorCollection& coll,
+                                       absl::Span<const ir::Value> roots,
+                                       PostOrderData* po_data);
+
+  static void BuildInputOutputAliases(absl::Span<const int64_t> output_aliases,
                                       ir::LoweringContext* lowering_ctx);
 
-  static CompilationResult Compile(const std::vector<XLATensor>& tensors,
-                                   absl::Span<const std::string> devices,
+  // Compiles the graph whose roots are given, which produce the values of the
+  // tensors selected by coll.indices.
+  static CompilationResult Compile(absl::Span<const std::string> devices,
                                    const SyncTensorCollection& coll,
+                                   absl::Span<const ir::Value> roots,
                                    PostOrderData* po_data);
 
+  // Schedules the op-by-op execution of the graph whose roots are given, which
+  // produce the values of the tensors selected by coll->indices.
+  static std::shared_ptr<Async> ScheduleOpByOpSyncTensorsGraph(
+      std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+      std::vector<ir::Value> roots, absl::Span<const std::string> devices);
+
+  // On a computation cache miss, schedules the compilation of the graph in
+  // background and runs the current step op-by-op, so that it does not wait
+  // for the compilation. Returns nullptr if the graph needs to be compiled
+  // synchronously.
+  static std::shared_ptr<Async> TryCompileInBackground(
+      BackgroundCompiler* background_compiler, std::vector<XLATensor>* tensors,
+      absl::Span<const std::string> devices, SyncTensorCollection* coll,
+      absl::Span<const ir::Value> roots, const PostOrderData& po_data);
+
   static std::shared_ptr<Async> SyncTensorsGraphInternal(
       std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
       const SyncTensorsConfig& config);
 
   static int64_t GetNextTensorId();
 
-  // Check if the current node is a cutpoint (by hash) and apply pending graph -
-  // in other words, cut the trace - and return true iff that's the case.
-  bool ApplyTraceletCutpoint();
-
-  // Detect when new compilations are triggered after first few steps and
-  // attempt to find common portions, after which the trace is cut. This is
-  // meant to address variable upper bound loops, which lead to different
-  // unrolled sequences of code despite the body being identical. The hope is to
-  // reach a steady state in which no new tracelets are created after a
-  // relatively small number of cuts.
-  static void InsertTraceletCutpoint(const PostOrderData& po_data);
+  // If the IR value of the tensor is a cut point of the graph partitioner,
+  // syncs the live tensors to close the current partition of the step graph,
+  // and returns true. Only the nodes which become the IR value of a tensor can
+  // cut the graph.
+  bool ApplyPartitionCutpoint();
 
   std::shared_ptr<Data> data_;
 };
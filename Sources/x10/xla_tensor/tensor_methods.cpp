@@ -25,6 +25,11 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_reduce.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/annotate.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/flat_pack.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/flat_unpack.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/multi_tensor_adam.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/multi_tensor_sgd.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/replica_id.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_stateless_random_normal.h"
@@ -32,6 +37,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_avg_pool_grad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_max_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_max_pool_grad.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_pad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_slice.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/shape_builder.h"
@@ -176,6 +182,22 @@ void CheckIsIntegralOrPred(const xla::Shape& shape,
       << shape;
 }
 
+// Returns the IR values of the optimizer state tensors, which must have the
+// shapes of the weights.
+std::vector<ir::Value> GetOptimizerIrValues(
+    absl::Span<const XLATensor> tensors, absl::Span<const XLATensor> weights) {
+  XLA_CHECK_EQ(tensors.size(), weights.size());
+  std::vector<ir::Value> values;
+  values.reserve(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    values.push_back(tensors[i].GetIrValue());
+    XLA_CHECK(xla::ShapeUtil::Compatible(values.back().shape(),
+                                         weights[i].shape().get()))
+        << values.back().shape() << " vs. " << weights[i].shape().get();
+  }
+  return values;
+}
+
 }  // namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -200,6 +222,118 @@ std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce(
   return {results, ir::Value(node, inputs.size())};
 }
 
+std::vector<XLATensor> XLATensor::multi_tensor_adam(
+    absl::Span<const XLATensor> weights, absl::Span<const XLATensor> grads,
+    absl::Span<const XLATensor> first_moments,
+    absl::Span<const XLATensor> second_moments,
+    const XLATensor& learning_rate, const XLATensor& beta1,
+    const XLATensor& beta2, const XLATensor& weight_decay, double epsilon) {
+  XLA_CHECK(!weights.empty()) << "multi_tensor_adam cannot take an empty list";
+  CheckRank(learning_rate, 0, "multi_tensor_adam", "learning_rate", 5);
+  CheckRank(beta1, 0, "multi_tensor_adam", "beta1", 6);
+  CheckRank(beta2, 0, "multi_tensor_adam", "beta2", 7);
+  CheckRank(weight_decay, 0, "multi_tensor_adam", "weight_decay", 8);
+  ir::NodePtr node = ir::MakeNode<ir::ops::MultiTensorAdam>(
+      GetOptimizerIrValues(weights, weights),
+      GetOptimizerIrValues(grads, weights),
+      GetOptimizerIrValues(first_moments, weights),
+      GetOptimizerIrValues(second_moments, weights),
+      learning_rate.GetIrValue(), beta1.GetIrValue(), beta2.GetIrValue(),
+      weight_decay.GetIrValue(), epsilon);
+  std::vector<XLATensor> results;
+  results.reserve(3 * weights.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    results.push_back(weights[i].CreateFrom(ir::Value(node, i)));
+  }
+  for (size_t i = 0; i < first_moments.size(); ++i) {
+    results.push_back(
+        first_moments[i].CreateFrom(ir::Value(node, weights.size() + i)));
+  }
+  for (size_t i = 0; i < second_moments.size(); ++i) {
+    results.push_back(
+        second_moments[i].CreateFrom(ir::Value(node, 2 * weights.size() + i)));
+  }
+  return results;
+}
+
+std::vector<XLATensor> XLATensor::multi_tensor_sgd(
+    absl::Span<const XLATensor> weights, absl::Span<const XLATensor> grads,
+    absl::Span<const XLATensor> velocities, const XLATensor& learning_rate,
+    const XLATensor& momentum, const XLATensor& weight_decay, bool nesterov) {
+  XLA_CHECK(!weights.empty()) << "multi_tensor_sgd cannot take an empty list";
+  CheckRank(learning_rate, 0, "multi_tensor_sgd", "learning_rate", 4);
+  CheckRank(momentum, 0, "multi_tensor_sgd", "momentum", 5);
+  CheckRank(weight_decay, 0, "multi_tensor_sgd", "weight_decay", 6);
+  ir::NodePtr node = ir::MakeNode<ir::ops::MultiTensorSgd>(
+      GetOptimizerIrValues(weights, weights),
+      GetOptimizerIrValues(grads, weights),
+      GetOptimizerIrValues(velocities, weights), learning_rate.GetIrValue(),
+      momentum.GetIrValue(), weight_decay.GetIrValue(), nesterov);
+  std::vector<XLATensor> results;
+  results.reserve(2 * weights.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    results.push_back(weights[i].CreateFrom(ir::Value(node, i)));
+  }
+  for (size_t i = 0; i < velocities.size(); ++i) {
+    results.push_back(
+        velocities[i].CreateFrom(ir::Value(node, weights.size() + i)));
+  }
+  return results;
+}
+
+XLATensor XLATensor::flat_pack(absl::Span<const XLATensor> tensors) {
+  XLA_CHECK(!tensors.empty()) << "flat_pack cannot take an empty list";
+  std::vector<ir::Value> values;
+  values.reserve(tensors.size());
+  for (auto& tensor : tensors) {
+    values.push_back(tensor.GetIrValue());
+  }
+  return tensors.front().CreateFrom(ir::MakeNode<ir::ops::FlatPack>(values));
+}
+
+std::vector<XLATensor> XLATensor::flat_unpack(
+    const XLATensor& flat, std::vector<std::vector<int64_t>> dimensions) {
+  size_t num_tensors = dimensions.size();
+  ir::NodePtr node = ir::MakeNode<ir::ops::FlatUnpack>(flat.GetIrValue(),
+                                                      std::move(dimensions));
+  std::vector<XLATensor> results;
+  results.reserve(num_tensors);
+  for (size_t i = 0; i < num_tensors; ++i) {
+    results.push_back(flat.CreateFrom(ir::Value(node, i)));
+  }
+  return results;
+}
+
+XLATensor XLATensor::set_dimension_size(const XLATensor& input,
+                                        const XLATensor& size, int64_t dim) {
+  ir::Value input_value = input.GetIrValue();
+  ir::Value size_value = size.GetIrValue();
+  dim = XlaHelpers::GetCanonicalDimensionIndex(dim,
+                                               input_value.shape().rank());
+  auto lower_for_shape_fn =
+      [dim](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    return xla::SetDimensionSize(
+        operands[0], xla::ConvertElementType(operands[1], xla::S32), dim);
+  };
+  auto lower_fn = [dim](const ir::Node& node,
+                        ir::LoweringContext* loctx) -> ir::XlaOpVector {
+    xla::XlaOp xla_input = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_size = loctx->GetOutputOp(node.operand(1));
+    return node.ReturnOp(
+        xla::SetDimensionSize(xla_input,
+                              xla::ConvertElementType(xla_size, xla::S32), dim),
+        loctx);
+  };
+  ir::NodePtr node = ir::ops::GenericOp(
+      ir::ops::xla_set_dimension_size, {input_value, size_value},
+      [&]() {
+        return ir::ops::InferOutputShape(
+            {input_value.shape(), size_value.shape()}, lower_for_shape_fn);
+      },
+      std::move(lower_fn), /*num_outputs=*/1, xla::util::MHash(dim));
+  return input.CreateFrom(ir::Value(node));
+}
+
 XLATensor XLATensor::annotate(const XLATensor& input, std::string annotation) {
   return input.CreateFrom(
       ir::MakeNode<ir::ops::Annotate>(input.GetIrValue(), annotation));
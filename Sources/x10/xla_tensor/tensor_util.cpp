@@ -659,6 +659,13 @@ std::vector<at::Tensor> XlaDataToTensors(
 }
 
 xla::hash_t TensorHash(const at::Tensor& tensor) {
+  // The hash is memoized within the buffer, which the XLA data cache looks up
+  // again every time the same host tensor gets uploaded.
+  return tensor.buffer().content_hash(
+      [&tensor]() { return TensorContentHash(tensor); });
+}
+
+xla::hash_t TensorContentHash(const at::Tensor& tensor) {
   int64_t size =
       tensor.buffer().size() * at::internal::GetSizeof(tensor.scalar_type());
   switch (tensor.scalar_type()) {
@@ -54,8 +54,12 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
 xla::ComputationClient::TensorSource TensorToTensorSource(
     const at::Tensor& tensor, const Device& device);
 
+// Returns the hash of the tensor content, memoized within its buffer.
 xla::hash_t TensorHash(const at::Tensor& tensor);
 
+// Same as above, but always hashes the full content.
+xla::hash_t TensorContentHash(const at::Tensor& tensor);
+
 // Retrieves the device data handles by parallel uploading data onto the
 // corresponding devices.
 std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
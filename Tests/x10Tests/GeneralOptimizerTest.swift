@@ -0,0 +1,63 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import TensorFlow
+import XCTest
+import x10_optimizers_optimizer
+import x10_optimizers_tensor_visitor_plan
+
+final class GeneralOptimizerTests: XCTestCase {
+  // On XLA devices the whole parameter group is updated by the fused group callback, elsewhere by
+  // the per-weight callbacks: both must take the same steps.
+  func checkGroupCallbackMatchesPerWeightCallbacks(
+    _ makeOptimizer: () -> ParameterGroupOptimizer
+  ) {
+    var eagerModel = Classifier(copying: Classifier(), to: Device.defaultTFEager)
+    var xlaModel = Classifier(copying: eagerModel, to: Device.defaultXLA)
+    let plan = TensorVisitorPlan(eagerModel.differentiableVectorView)
+    let eagerOptimizer = GeneralOptimizer(
+      for: eagerModel, plan, defaultOptimizer: makeOptimizer())
+    let xlaOptimizer = GeneralOptimizer(for: xlaModel, plan, defaultOptimizer: makeOptimizer())
+    XCTAssertNotNil(xlaOptimizer.parameterGroups[0].groupCallback)
+    for _ in 0..<3 {
+      let input = Tensor<Float>(randomNormal: [4, 784], on: Device.defaultTFEager)
+      let eagerGrad = gradient(at: eagerModel) { $0(input).squared().sum() }
+      eagerOptimizer.update(&eagerModel, along: eagerGrad)
+      let xlaInput = Tensor(copying: input, to: Device.defaultXLA)
+      let xlaGrad = gradient(at: xlaModel) { $0(xlaInput).squared().sum() }
+      xlaOptimizer.update(&xlaModel, along: xlaGrad)
+      LazyTensorBarrier()
+    }
+    let eagerWeights = plan.allTensors(eagerModel.differentiableVectorView)
+    let xlaWeights = plan.allTensors(xlaModel.differentiableVectorView)
+    for (eagerWeight, xlaWeight) in zip(eagerWeights, xlaWeights) {
+      let difference = abs(eagerWeight - Tensor(copying: xlaWeight, to: eagerWeight.device))
+      XCTAssertLessThan(difference.max().scalarized(), 1e-4)
+    }
+  }
+
+  func testSGDGroupCallback() {
+    for nesterov in [false, true] {
+      checkGroupCallbackMatchesPerWeightCallbacks {
+        makeSGD(learningRate: 0.01, momentum: 0.9, weightDecay: 0.01, nesterov: nesterov)
+      }
+    }
+  }
+
+  func testAdamGroupCallback() {
+    checkGroupCallbackMatchesPerWeightCallbacks {
+      makeAdam(learningRate: 0.01, weightDecayRate: 0.01)
+    }
+  }
+}
@@ -2537,6 +2537,88 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  // The last weight is larger than XLA_MULTI_TENSOR_CONCAT_ELEMENTS and is updated in place,
+  // the others are concatenated.
+  private let multiTensorShapes = [[3, 2], [5], [300, 300]]
+
+  func testMultiTensorAdam() throws {
+    let (learningRate, beta1, beta2, weightDecay, epsilon): (Float, Float, Float, Float, Float) =
+      (0.01, 0.9, 0.999, 0.01, 1e-6)
+    var weights = multiTensorShapes.map { Tensor<Float>.rand($0) }
+    var firstMoments = weights.map { Tensor(zerosLike: $0) }
+    var secondMoments = weights.map { Tensor(zerosLike: $0) }
+    var expectedWeights = weights.map { TF($0) }
+    var expectedFirstMoments = firstMoments.map { TF($0) }
+    var expectedSecondMoments = secondMoments.map { TF($0) }
+    for _ in 0..<3 {
+      let grads = multiTensorShapes.map { Tensor<Float>.rand($0) - 0.5 }
+      // The unfused update from makeAdam().
+      for i in weights.indices {
+        let grad = TF(grads[i])
+        expectedFirstMoments[i] = beta1 * expectedFirstMoments[i] + grad * (1 - beta1)
+        expectedSecondMoments[i] =
+          beta2 * expectedSecondMoments[i] + grad .* grad * (1 - beta2)
+        let denominator = sqrt(expectedSecondMoments[i]) + epsilon
+        let update = expectedFirstMoments[i] ./ denominator + expectedWeights[i] * weightDecay
+        expectedWeights[i] = expectedWeights[i] - learningRate * update
+      }
+      (weights, firstMoments, secondMoments) = _RawXLA.multiTensorAdam(
+        weights: weights, grads: grads, firstMoments: firstMoments, secondMoments: secondMoments,
+        learningRate: Tensor(learningRate, on: x10), beta1: Tensor(beta1, on: x10),
+        beta2: Tensor(beta2, on: x10), weightDecay: Tensor(weightDecay, on: x10),
+        epsilon: Double(epsilon))
+      LazyTensorBarrier()
+      for i in weights.indices {
+        XCTAssertEqual(weights[i].shape, expectedWeights[i].shape)
+        XCTAssert(
+          allClose(
+            actual: TF(weights[i]), expected: expectedWeights[i], absTolerance: 1e-6))
+        XCTAssert(
+          allClose(
+            actual: TF(firstMoments[i]), expected: expectedFirstMoments[i], absTolerance: 1e-6))
+        XCTAssert(
+          allClose(
+            actual: TF(secondMoments[i]), expected: expectedSecondMoments[i], absTolerance: 1e-6))
+      }
+    }
+  }
+
+  func testMultiTensorSGD() throws {
+    let (learningRate, momentum, weightDecay): (Float, Float, Float) = (0.1, 0.9, 0.01)
+    for nesterov in [false, true] {
+      var weights = multiTensorShapes.map { Tensor<Float>.rand($0) }
+      var velocities = weights.map { Tensor(zerosLike: $0) }
+      var expectedWeights = weights.map { TF($0) }
+      var expectedVelocities = velocities.map { TF($0) }
+      for _ in 0..<3 {
+        let grads = multiTensorShapes.map { Tensor<Float>.rand($0) - 0.5 }
+        // The unfused update from makeSGD().
+        for i in weights.indices {
+          let grad = TF(grads[i]) + expectedWeights[i] * weightDecay
+          expectedVelocities[i] = momentum * expectedVelocities[i] - grad * learningRate
+          let step =
+            nesterov
+            ? momentum * expectedVelocities[i] - grad * learningRate : expectedVelocities[i]
+          expectedWeights[i] = expectedWeights[i] + step
+        }
+        (weights, velocities) = _RawXLA.multiTensorSGD(
+          weights: weights, grads: grads, velocities: velocities,
+          learningRate: Tensor(learningRate, on: x10), momentum: Tensor(momentum, on: x10),
+          weightDecay: Tensor(weightDecay, on: x10), nesterov: nesterov)
+        LazyTensorBarrier()
+        for i in weights.indices {
+          XCTAssertEqual(weights[i].shape, expectedWeights[i].shape)
+          XCTAssert(
+            allClose(
+              actual: TF(weights[i]), expected: expectedWeights[i], absTolerance: 1e-6))
+          XCTAssert(
+            allClose(
+              actual: TF(velocities[i]), expected: expectedVelocities[i], absTolerance: 1e-6))
+        }
+      }
+    }
+  }
+
   func testNotEqual() throws {
     var x = Tensor<Float>(shape: [4], scalars: [1, 22, 3, 5], on: x10)
     var y = Tensor<Float>(shape: [4], scalars: [7, 19, 3, 5], on: x10)
@@ -1,6 +1,34 @@
+import Foundation
 import TensorFlow
 import XCTest
 
+@_silgen_name("SetIrOptimization")
+internal func SetIrOptimization(_: Bool) -> Void
+
+@_silgen_name("SetIrOutlining")
+internal func SetIrOutlining(_: Bool) -> Void
+
+@_silgen_name("GetCounterValue")
+internal func GetCounterValue(_: UnsafePointer<CChar>) -> Int64
+
+@_silgen_name("SetGraphProfiling")
+internal func SetGraphProfiling(_: Bool) -> Void
+
+@_silgen_name("SetOpByOpExecution")
+internal func SetOpByOpExecution(_ enabled: Bool, _ splitChained: Bool) -> Void
+
+@_silgen_name("SetGraphPartitioning")
+internal func SetGraphPartitioning(_: Bool) -> Void
+
+@_silgen_name("SetBackgroundCompilation")
+internal func SetBackgroundCompilation(_: Bool) -> Void
+
+@_silgen_name("SetParallelLowering")
+internal func SetParallelLowering(_ enabled: Bool, _ minNodes: Int64) -> Void
+
+@_silgen_name("RunMultiWaitChecks")
+internal func RunMultiWaitChecks(_ rounds: Int64) -> Int64
+
 /// Direct tests of xla tensor.
 final class XLATensorTests: XCTestCase {
   #if FALLBACK_X10_BINARY
@@ -24,6 +52,725 @@ final class XLATensorTests: XCTestCase {
     let annotated = tensor.annotate("type=Tensor<Float>")
     XCTAssertEqual(annotated.annotations, "{\n  shape=[1, 2, 3] type=Tensor<Float>\n}")
   }
+
+  func testIrOptimizerSimplifiedMultiOutputUse() throws {
+    let x = Tensor<Float>(shape: [3, 2], scalars: [1, 2, 3, 4, 5, 7], on: Device.defaultXLA)
+    let expected = x.svd(fullMatrices: false)
+    LazyTensorBarrier()
+    SetIrOptimization(true)
+    defer { SetIrOptimization(false) }
+    // The additions and multiplications get simplified to the outputs 1 and 2 of the SVD node.
+    let actual = x.svd(fullMatrices: false)
+    let u = actual.u! + 0
+    let v = actual.v! * 1
+    LazyTensorBarrier()
+    XCTAssertEqual(u.shape, expected.u!.shape)
+    XCTAssertEqual(u.scalars, expected.u!.scalars)
+    XCTAssertEqual(v.shape, expected.v!.shape)
+    XCTAssertEqual(v.scalars, expected.v!.scalars)
+  }
+
+  func testHostEvaluation() throws {
+    // A learning rate schedule, small enough to be evaluated on the host.
+    func learningRate(on device: Device) -> Tensor<Float> {
+      let step = Tensor<Int32>(7, on: device)
+      let decay = pow(Tensor<Float>(0.5, on: device), Tensor<Float>(step / 2))
+      let warmup = Tensor<Float>(step + 1) / 10
+      let scales = Tensor<Float>(shape: [4], scalars: [1, 2, 3, 4], on: device)
+      return min(warmup, Tensor<Float>(0.1, on: device) * decay) * scales.mean()
+    }
+    let expected = learningRate(on: Device.defaultTFEager).scalarized()
+    let hostEvaluations = GetCounterValue("HostEvaluations")
+    let actual = learningRate(on: Device.defaultXLA).scalarized()
+    XCTAssertEqual(GetCounterValue("HostEvaluations"), hostEvaluations + 1)
+    XCTAssertEqual(actual, expected, accuracy: 1e-7)
+    XCTAssertEqual(actual, 0.03125, accuracy: 1e-7)
+  }
+
+  func testHostEvaluationFallsBackToDevice() throws {
+    // The integer division by zero has device defined semantics.
+    let quotient = Tensor<Int32>(7, on: Device.defaultXLA) / Tensor<Int32>(0, on: Device.defaultXLA)
+    let hostEvaluations = GetCounterValue("HostEvaluations")
+    _ = quotient.scalarized()
+    XCTAssertEqual(GetCounterValue("HostEvaluations"), hostEvaluations)
+  }
+
+  func testHostEvaluationMatchesDevice() throws {
+    // Every case is small enough for the host and has to match the device results.
+    func check<Scalar: TensorFlowScalar & Equatable>(
+      _ compute: (Device) -> Tensor<Scalar>, file: StaticString = #file, line: UInt = #line
+    ) {
+      let expected = compute(Device.defaultTFEager)
+      let hostEvaluations = GetCounterValue("HostEvaluations")
+      let actual = compute(Device.defaultXLA)
+      XCTAssertEqual(actual.shape, expected.shape, file: file, line: line)
+      XCTAssertEqual(actual.scalars, expected.scalars, file: file, line: line)
+      XCTAssertEqual(
+        GetCounterValue("HostEvaluations"), hostEvaluations + 1, file: file, line: line)
+    }
+    // Integer wraparound.
+    check { Tensor<Int8>(127, on: $0) + Tensor<Int8>(1, on: $0) }
+    check { Tensor<Int8>(-128, on: $0) - Tensor<Int8>(1, on: $0) }
+    check { Tensor<Int32>(Int32.max, on: $0) * Tensor<Int32>(2, on: $0) }
+    check { Tensor<UInt8>(0, on: $0) - Tensor<UInt8>(1, on: $0) }
+    // Casts.
+    check { Tensor<Int32>(Tensor<Float>([-2.7, -0.5, 0.5, 2.7], on: $0)) }
+    check { Tensor<Float>(Tensor<Int32>([-3, 0, 7], on: $0)) / 2 }
+    check { Tensor<Int8>(Tensor<Int32>([255, 256, -129], on: $0)) }
+    check { Tensor<Float>(Tensor<Float>([1, 2], on: $0) .> Tensor<Float>(1, on: $0)) }
+    // Reductions.
+    func matrix(on device: Device) -> Tensor<Float> {
+      Tensor<Float>(shape: [2, 3], scalars: [1, -2, 3, 4, 5, -6], on: device)
+    }
+    check { matrix(on: $0).sum(squeezingAxes: 1) }
+    check { matrix(on: $0).mean(alongAxes: 0) }
+    check { matrix(on: $0).product(alongAxes: 1) }
+    check { (matrix(on: $0) .> 0).all(squeezingAxes: 1) }
+    check { (matrix(on: $0) .> 4).any(squeezingAxes: 0) }
+    check { Tensor<Int32>(matrix(on: $0)).sum() }
+    // Where and clamp.
+    check { (device: Device) -> Tensor<Float> in
+      let x = matrix(on: device)
+      return x.replacing(with: -x, where: x .< 0)
+    }
+    check { matrix(on: $0).clipped(min: Tensor(-1, on: $0), max: Tensor(4, on: $0)) }
+    check {
+      Tensor<Int32>([-5, 0, 5], on: $0).clipped(min: Tensor(-2, on: $0), max: Tensor(2, on: $0))
+    }
+    // Broadcasting.
+    check { Tensor<Float>([[1], [2]], on: $0) + Tensor<Float>([10, 20, 30], on: $0) }
+    check { max(matrix(on: $0), Tensor<Float>([0, 2, 4], on: $0)) }
+    check { Tensor<Int32>([[1], [2]], on: $0) .== Tensor<Int32>([2, 1], on: $0) }
+  }
+
+  func testHostEvaluationFallsBackOnIntegerDivisionByZero() throws {
+    // The device defines the division and remainder by zero, the host leaves them to it.
+    let device = Device.defaultXLA
+    let dividend = Tensor<Int32>([7, -7, 0], on: device)
+    let divisor = Tensor<Int32>([0, 2, 0], on: device)
+    let hostEvaluations = GetCounterValue("HostEvaluations")
+    let quotient = (dividend / divisor).scalars
+    let remainder = (dividend % divisor).scalars
+    XCTAssertEqual(GetCounterValue("HostEvaluations"), hostEvaluations)
+    XCTAssertEqual(quotient[1], -3)
+    XCTAssertEqual(remainder[1], -1)
+  }
+
+  func testScalarsOfManyTensors() throws {
+    let x = Tensor<Float>(shape: [2, 3], scalars: [1, 2, 3, 4, 5, 6], on: Device.defaultXLA)
+    let materialized = Tensor<Float>([10, 20], on: Device.defaultXLA)
+    _ = materialized.scalars
+    let tensors = [x * 2, x.sum(alongAxes: 1), materialized, x.transposed() - 1]
+    let scalars = Tensor.scalars(of: tensors)
+    XCTAssertEqual(scalars.count, tensors.count)
+    XCTAssertEqual(scalars[0], [2, 4, 6, 8, 10, 12])
+    XCTAssertEqual(scalars[1], [6, 15])
+    XCTAssertEqual(scalars[2], [10, 20])
+    XCTAssertEqual(scalars[3], [0, 3, 1, 4, 2, 5])
+    for (tensor, tensorScalars) in zip(tensors, scalars) {
+      XCTAssertEqual(tensor.scalars, tensorScalars)
+    }
+    XCTAssertEqual(Tensor<Float>.scalars(of: []), [])
+  }
+
+  func testFlatParameterGroupRoundTrip() throws {
+    let weights = [
+      Tensor<Float>(shape: [2, 3], scalars: [1, 2, 3, 4, 5, 6], on: Device.defaultXLA),
+      Tensor<Float>(7, on: Device.defaultXLA),
+      Tensor<Float>(shape: [3], scalars: [8, 9, 10], on: Device.defaultXLA),
+    ]
+    let group = FlatParameterGroup(weights)
+    XCTAssertEqual(group.buffer.shape, [10])
+    XCTAssertEqual(group.buffer.scalars, Array(1...10).map { Float($0) })
+    let unpacked = group.unpack()
+    XCTAssertEqual(unpacked.map { $0.shape }, weights.map { $0.shape })
+    XCTAssertEqual(unpacked.map { $0.scalars }, weights.map { $0.scalars })
+
+    // Packing the gradients and updating the whole buffer at once.
+    let grads = weights.map { $0 * 2 }
+    let flatGrads = group.pack(grads)
+    XCTAssertEqual(flatGrads.scalars, Array(1...10).map { Float($0 * 2) })
+    group.buffer = group.buffer - flatGrads * 0.5
+    LazyTensorBarrier()
+    XCTAssertEqual(
+      group.unpack().map { $0.scalars },
+      weights.map { [Float](repeating: 0, count: $0.shape.contiguousSize) })
+    XCTAssertEqual(group.unpack(flatGrads).map { $0.scalars }, grads.map { $0.scalars })
+  }
+
+  func testGraphProfileReport() throws {
+    SetGraphProfiling(true)
+    defer { SetGraphProfiling(false) }
+    ResetGraphProfile()
+    XCTAssertTrue(GraphProfileReport().hasPrefix("Graphs: 0, "))
+    // A graph which was not compiled before (and too large for the host evaluation), executed
+    // twice.
+    let x = Tensor<Float>(
+      shape: [10, 10], scalars: (0..<100).map { Float($0) }, on: Device.defaultXLA)
+    for _ in 0..<2 {
+      let y = (x * 3 - 1).sum(alongAxes: 1)
+      LazyTensorBarrier()
+      XCTAssertEqual(y.scalars, (0..<10).map { Float(300 * $0 + 125) })
+    }
+    let report = GraphProfileReport(top: 0)
+    XCTAssertTrue(report.hasPrefix("Graphs: 1, "), report)
+    XCTAssertTrue(report.contains("% of the execution time\n  executions=2 "), report)
+    XCTAssertTrue(report.contains("\n  compilations=1 "), report)
+    ResetGraphProfile()
+    XCTAssertTrue(GraphProfileReport().hasPrefix("Graphs: 0, "))
+  }
+
+  func testDefaultParameterDonation() throws {
+    let scalars = (0..<256).map { Float($0) }
+    var weight = Tensor<Float>(shape: [4, 64], scalars: scalars, on: Device.defaultXLA) * 1
+    let grad = Tensor<Float>(repeating: 2, shape: [4, 64], on: Device.defaultXLA) * 1
+    LazyTensorBarrier()
+
+    // The previous weight buffer is only read by the update, so it gets donated to its result.
+    var donatedBuffers = GetCounterValue("DonatedBuffers")
+    weight = weight - grad * 0.5
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("DonatedBuffers"), donatedBuffers + 1)
+    XCTAssertEqual(weight.scalars, scalars.map { $0 - 1 })
+
+    // A buffer still referenced by a live tensor is not donated, and keeps its value.
+    let previousWeight = weight
+    donatedBuffers = GetCounterValue("DonatedBuffers")
+    weight = weight - grad * 0.5
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("DonatedBuffers"), donatedBuffers)
+    XCTAssertEqual(weight.scalars, scalars.map { $0 - 2 })
+    XCTAssertEqual(previousWeight.scalars, scalars.map { $0 - 1 })
+    XCTAssertEqual(grad.scalars, [Float](repeating: 2, count: scalars.count))
+  }
+
+  func testInputPrefetcher() throws {
+    let batches = (0..<5).map { step in
+      [
+        ShapedArray<Float>(shape: [2, 3], scalars: (0..<6).map { Float(step * 10 + $0) }),
+        ShapedArray<Float>(shape: [], scalars: [Float(step)]),
+      ]
+    }
+    let prefetcher = InputPrefetcher(on: Device.defaultXLA, depth: 2)
+    // Keeps the queue full, as an input pipeline running ahead of the steps does.
+    prefetcher.enqueue(batches[0])
+    prefetcher.enqueue(batches[1])
+    for step in batches.indices {
+      let tensors = prefetcher.dequeue(Float.self)
+      if step + 2 < batches.count {
+        prefetcher.enqueue(batches[step + 2])
+      }
+      XCTAssertEqual(tensors.count, 2)
+      for (tensor, expected) in zip(tensors, batches[step]) {
+        XCTAssertEqual(tensor.device, Device.defaultXLA)
+        XCTAssertEqual(tensor.shape.dimensions, expected.shape)
+        XCTAssertEqual(tensor.scalars, expected.scalars)
+      }
+    }
+  }
+
+  func testDeviceBufferPoolReuse() throws {
+    // The buffer pool only sits in front of the local (GPU) devices.
+    guard let device = Device.allDevices.first(where: { $0.kind == .GPU }) else { return }
+    let scalars = (0..<(37 * 41)).map { Float($0) }
+    func step(_ offset: Float) -> [Float] {
+      let x = Tensor<Float>(shape: [37, 41], scalars: scalars, on: device)
+      let y = x + offset
+      LazyTensorBarrier(on: device)
+      return y.scalars
+    }
+    // Nothing of this size has been released yet, so the buffers are allocated.
+    var hits = GetCounterValue("DeviceBufferPoolHit")
+    var misses = GetCounterValue("DeviceBufferPoolMiss")
+    XCTAssertEqual(step(1), scalars.map { $0 + 1 })
+    XCTAssertEqual(GetCounterValue("DeviceBufferPoolHit"), hits)
+    let firstStepMisses = GetCounterValue("DeviceBufferPoolMiss") - misses
+    XCTAssertGreaterThan(firstStepMisses, 0)
+
+    // The buffers of the previous step are released and the computation which read them is done,
+    // so they are handed out again and get overwritten with the new values.
+    LazyTensorBarrier(on: device, wait: true)
+    hits = GetCounterValue("DeviceBufferPoolHit")
+    misses = GetCounterValue("DeviceBufferPoolMiss")
+    XCTAssertEqual(step(2), scalars.map { $0 + 2 })
+    XCTAssertGreaterThan(GetCounterValue("DeviceBufferPoolHit"), hits)
+    XCTAssertLessThan(GetCounterValue("DeviceBufferPoolMiss") - misses, firstStepMisses)
+  }
+
+  func testShapeBucketsShareCompilation() throws {
+    SetShapeBucketBoundaries([8, 16], dimension: 0)
+    defer { SetShapeBucketBoundaries([], dimension: 0) }
+    func step(_ length: Int) -> Float {
+      let scalars = (0..<(length * 3)).map { Float($0) }
+      let input = BucketedTensor(shape: [length, 3], scalars: scalars, on: Device.defaultXLA)
+      XCTAssertEqual(input.shape, [length, 3])
+      XCTAssertEqual(input.tensor.shape, [8, 3])
+      let result = (input.tensor * 2).sum()
+      LazyTensorBarrier()
+      return result.scalarized()
+    }
+    XCTAssertEqual(step(5), Float(14 * 15))
+
+    // A new size within the same bucket hashes to the same graph, so it reuses its compilation.
+    let compilesSaved = GetCounterValue("ShapeBucketCompilesSaved")
+    let uncachedCompiles = GetCounterValue("UncachedCompile")
+    XCTAssertEqual(step(7), Float(20 * 21))
+    XCTAssertEqual(GetCounterValue("ShapeBucketCompilesSaved"), compilesSaved + 1)
+    XCTAssertEqual(GetCounterValue("UncachedCompile"), uncachedCompiles)
+  }
+
+  func testSplitChainedExecutionReusesSessions() throws {
+    SetOpByOpExecution(true, true)
+    defer { SetOpByOpExecution(false, false) }
+    let x = Tensor<Float>(shape: [2, 3], scalars: [1, 2, 3, 4, 5, 6], on: Device.defaultXLA)
+    // More chained ops than the execute nodes a session is created with, so the sessions only
+    // avoid growing their graphs if they get rewound between ops.
+    func step() -> [Float] {
+      var y = (x * 2 + 1) * (x - 1)
+      for _ in 0..<20 {
+        y = y + 1
+      }
+      let result = y.sum(alongAxes: 1)
+      LazyTensorBarrier()
+      return result.scalars
+    }
+    XCTAssertEqual(step(), [79, 196])
+
+    // The sessions checked out by the ops of the previous step went back to the cache, and have
+    // their execute nodes reused.
+    let executeNodes = GetCounterValue("XrtExecute_Empty")
+    XCTAssertEqual(step(), [79, 196])
+    XCTAssertEqual(GetCounterValue("XrtExecute_Empty"), executeNodes)
+  }
+
+  func testTensorAllocatorThreadCacheFlush() throws {
+    // A single transfer of 24 MB in 1 MB tensors, whose staging buffers are all released by the
+    // same thread, overflows its thread cache (16 MB by default), which then gets flushed.
+    let count = 256 * 1024
+    func upload(_ offset: Int) -> [Tensor<Float>] {
+      let tensors = (0..<24).map { i in
+        Tensor<Float>(
+          shape: [count], scalars: [Float](repeating: Float(offset + i), count: count),
+          on: Device.defaultXLA)
+      }
+      LazyTensorBarrier()
+      return tensors
+    }
+    func reuses() -> Int64 {
+      GetCounterValue("TensorAllocatorHit") + GetCounterValue("TensorAllocatorThreadCacheHit")
+    }
+    let flushes = GetCounterValue("TensorAllocatorThreadCacheFlush")
+    _ = upload(0)
+    XCTAssertGreaterThan(GetCounterValue("TensorAllocatorThreadCacheFlush"), flushes)
+
+    // At least the 16 flushed blocks are reused by the next transfer, whichever threads run it.
+    let hits = reuses()
+    let tensors = upload(100)
+    XCTAssertGreaterThanOrEqual(reuses() - hits, 16)
+    for (i, tensor) in tensors.enumerated() {
+      XCTAssertEqual(tensor[count - 1].scalarized(), Float(100 + i))
+    }
+  }
+
+  func testNativeShapeRules() throws {
+    // Checks the shape inferred when the op gets traced, and the one of its device result, against
+    // the shape computed by TensorFlow.
+    func check<R>(
+      _ inputs: [Tensor<Float>], _ op: ([Tensor<Float>]) -> Tensor<R>,
+      file: StaticString = #file, line: UInt = #line
+    ) {
+      let expected = op(inputs.map { Tensor(copying: $0, to: Device.defaultTFEager) }).shape
+      let result = op(inputs.map { Tensor(copying: $0, to: Device.defaultXLA) })
+      XCTAssertEqual(result.shape, expected, "traced", file: file, line: line)
+      LazyTensorBarrier()
+      XCTAssertEqual(result.shape, expected, "computed", file: file, line: line)
+    }
+    func checkAll() {
+      let a = Tensor<Float>(randomUniform: [2, 1, 3], on: Device.defaultTFEager)
+      let b = Tensor<Float>(randomUniform: [4, 1], on: Device.defaultTFEager)
+      let c = Tensor<Float>(randomUniform: [2, 4, 3], on: Device.defaultTFEager)
+      check([a, b]) { $0[0] + $0[1] }
+      check([a, b]) { $0[0] * $0[1] - $0[1] }
+      check([a, b]) { $0[0] .< $0[1] }
+      check([a, b]) { ($0[0] .<= $0[1]).all(squeezingAxes: 1) }
+      check([a, b]) { ($0[0] .> $0[1]).any(alongAxes: 0, 2) }
+      check([c]) { $0[0].sum(squeezingAxes: 0, 2) }
+      check([c]) { $0[0].sum(alongAxes: 1) }
+      check([c]) { $0[0].mean(squeezingAxes: 2, 0) }
+      check([c]) { $0[0].product(squeezingAxes: 1) }
+      check([a]) { $0[0].broadcasted(to: [5, 2, 4, 3]) }
+      check([c]) { $0[0].transposed(permutation: 2, 0, 1) }
+      check([c]) { $0[0][1..., 1..<3] }
+      check([c, Tensor<Float>(randomUniform: [2, 3, 5], on: Device.defaultTFEager)]) {
+        matmul($0[0], $0[1])
+      }
+      let images = Tensor<Float>(randomUniform: [1, 9, 10, 2], on: Device.defaultTFEager)
+      let filter = Tensor<Float>(randomUniform: [3, 2, 2, 4], on: Device.defaultTFEager)
+      for padding in [Padding.valid, .same] {
+        check([images, filter]) {
+          conv2D($0[0], filter: $0[1], strides: (1, 2, 3, 1), padding: padding)
+        }
+        check([images, filter]) {
+          conv2D(
+            $0[0], filter: $0[1], strides: (1, 1, 1, 1), padding: padding,
+            dilations: (1, 2, 3, 1))
+        }
+        check([images, filter]) {
+          depthwiseConv2D($0[0], filter: $0[1], strides: (1, 2, 2, 1), padding: padding)
+        }
+      }
+      let sliced = _RawXLA.xlaSlice(
+        Tensor<Float>(copying: c, to: Device.defaultXLA), start_indices: [0, 1, 0],
+        limit_indices: [2, 4, 3], strides: [1, 2, 2])
+      XCTAssertEqual(sliced.shape, [2, 2, 2])
+      LazyTensorBarrier()
+      XCTAssertEqual(sliced.shape, [2, 2, 2])
+    }
+    checkAll()
+
+    // The shape cache is keyed by the op and the operand shapes, so the same ops over new data
+    // find their shapes there.
+    let misses = GetCounterValue("IrShapeCacheMiss")
+    checkAll()
+    XCTAssertEqual(GetCounterValue("IrShapeCacheMiss"), misses)
+  }
+
+  func testIrOutliningSharesOneBody() throws {
+    SetIrOutlining(true)
+    defer { SetIrOutlining(false) }
+    // Two copies of a block well above the outlining threshold (32 nodes), differing only by
+    // their weights.
+    func block(_ x: Tensor<Float>, _ weight: Tensor<Float>) -> Tensor<Float> {
+      var result = x
+      for _ in 0..<12 {
+        result = tanh(result * weight + 1)
+      }
+      return result
+    }
+    func step(on device: Device) -> Tensor<Float> {
+      let x = Tensor<Float>(shape: [3, 7], scalars: (0..<21).map { Float($0) / 21 }, on: device)
+      // Uploaded data, unlike constants, is an input of the copies.
+      let weight1 = Tensor<Float>(
+        shape: [3, 7], scalars: Array(repeating: 0.5, count: 21), on: device)
+      let weight2 = Tensor<Float>(
+        shape: [3, 7], scalars: Array(repeating: -0.25, count: 21), on: device)
+      return block(block(x, weight1), weight2)
+    }
+    let expected = step(on: Device.defaultTFEager)
+
+    let calls = GetCounterValue("IrOutlinedCalls")
+    let bodies = GetCounterValue("IrOutlinedBodies")
+    let result = step(on: Device.defaultXLA)
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("IrOutlinedCalls"), calls + 2)
+    XCTAssertEqual(GetCounterValue("IrOutlinedBodies"), bodies + 1)
+    let error = abs(Tensor(copying: result, to: Device.defaultTFEager) - expected).max()
+    XCTAssertLessThan(error.scalarized(), 1e-5)
+
+    // The same graph over new data is found in the computation cache, before any outlining.
+    let cachedResult = step(on: Device.defaultXLA)
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("IrOutlinedCalls"), calls + 2)
+    XCTAssertEqual(cachedResult.scalars, result.scalars)
+  }
+
+  func testGraphPartitionCacheHits() throws {
+    // Two variants of a step graph, which share a prefix and a suffix longer than
+    // XLA_GRAPH_PARTITION_MIN_NODES around a volatile region.
+    func step(_ variant: Int, on device: Device) -> [Float] {
+      var x = Tensor<Float>(shape: [3, 7], scalars: (0..<21).map { Float($0) / 21 }, on: device)
+      let y = Tensor<Float>(shape: [3, 7], scalars: Array(repeating: 0.5, count: 21), on: device)
+      for _ in 0..<40 { x = x + y }
+      for _ in 0..<4 { x = variant == 0 ? x * y : x - y }
+      for _ in 0..<40 { x = x - y }
+      LazyTensorBarrier()
+      return x.scalars
+    }
+    let roles = ["Whole", "Prefix", "Volatile", "Suffix"]
+    func counters(_ kind: String) -> [Int64] {
+      roles.map { GetCounterValue("Partition\($0)Cache\(kind)") }
+    }
+    SetGraphPartitioning(true)
+    defer { SetGraphPartitioning(false) }
+    // Past XLA_GRAPH_PARTITION_WARMUP_STEPS.
+    LazyTensorBarrier()
+    LazyTensorBarrier()
+    // The first steps find the cut points between the variants, and then compile the
+    // partitions closed by them.
+    let cutPoints = GetCounterValue("PartitionCutPoints")
+    for _ in 0..<3 {
+      for variant in 0..<2 {
+        XCTAssertEqual(
+          step(variant, on: Device.defaultXLA), step(variant, on: Device.defaultTFEager))
+      }
+    }
+    XCTAssertGreaterThan(GetCounterValue("PartitionCutPoints"), cutPoints)
+    let cuts = GetCounterValue("PartitionCuts")
+    let hits = counters("Hits")
+    let misses = counters("Misses")
+    for variant in 0..<2 {
+      XCTAssertEqual(step(variant, on: Device.defaultXLA), step(variant, on: Device.defaultTFEager))
+    }
+    // Every partition of both variants is found in the cache.
+    XCTAssertEqual(GetCounterValue("PartitionCuts"), cuts + 4)
+    XCTAssertEqual(counters("Hits"), zip(hits, [0, 2, 2, 2]).map { $0 + $1 })
+    XCTAssertEqual(counters("Misses"), misses)
+  }
+
+  func testDeviceMemorySnapshot() throws {
+    func bytes<S: StringProtocol>(_ value: S) -> Double {
+      let suffixes = ["B", "KB", "MB", "GB", "TB", "PB"]
+      let suffix = String(value.drop { $0.isNumber || $0 == "." })
+      let scale = pow(1024, Double(suffixes.firstIndex(of: suffix)!))
+      return Double(value.dropLast(suffix.count))! * scale
+    }
+    let device = Device.defaultXLA
+    let megabyte = 1024.0 * 1024
+    let x = Tensor<Float>(
+      shape: [256, 1024], scalars: Array(repeating: 1, count: 256 * 1024), on: device)
+    let y = x * 2
+    LazyTensorBarrier()
+    let lines = DeviceMemorySnapshot(on: device).split(separator: "\n")
+    // Device <device>: live=<bytes> peak=<bytes> last_step_peak=<bytes>
+    let header = lines[0].split(separator: " ").suffix(3)
+    XCTAssertTrue(lines[0].hasPrefix("Device "))
+    XCTAssertEqual(header.map { $0.split(separator: "=")[0] }, ["live", "peak", "last_step_peak"])
+    let liveBytes = bytes(header.first!.dropFirst("live=".count))
+    let peakBytes = bytes(header.dropFirst().first!.dropFirst("peak=".count))
+    XCTAssertGreaterThanOrEqual(liveBytes, 2 * megabyte)
+    XCTAssertGreaterThanOrEqual(peakBytes, liveBytes)
+    // <bytes> in <count> buffers: <origin>, with the uploaded x attributed to the host data.
+    let usages = lines.dropFirst().map {
+      $0.drop { $0 == " " }.split(separator: " ", maxSplits: 4)
+    }
+    let hostData = usages.first { $0[4] == "(host data)" }
+    XCTAssertGreaterThanOrEqual(bytes(hostData?[0] ?? "0B"), megabyte)
+    let usageBytes = usages.map { bytes($0[0]) }.reduce(0, +)
+    XCTAssertEqual(usageBytes, liveBytes, accuracy: 0.01 * liveBytes)
+    XCTAssertEqual(x.scalars[0] + y.scalars[0], 3)
+  }
+
+  func testBackgroundCompilationFallsBackOpByOp() throws {
+    func step(on device: Device) -> [Float] {
+      let x = Tensor<Float>(shape: [16, 8], scalars: (0..<128).map { Float($0 % 9) }, on: device)
+      let y = ((x * x + 3) * x).sum(alongAxes: 0) - 0.25
+      LazyTensorBarrier()
+      return y.scalars
+    }
+    let expected = step(on: Device.defaultTFEager)
+    SetBackgroundCompilation(true)
+    defer { SetBackgroundCompilation(false) }
+    // The first step misses the computation cache, and runs op-by-op while the graph
+    // gets compiled in background.
+    let fallbackSteps = GetCounterValue("OpByOpFallbackSteps")
+    let backgroundCompiles = GetCounterValue("BackgroundCompiles")
+    XCTAssertEqual(step(on: Device.defaultXLA), expected)
+    XCTAssertEqual(GetCounterValue("OpByOpFallbackSteps"), fallbackSteps + 1)
+    XCTAssertEqual(GetCounterValue("BackgroundCompiles"), backgroundCompiles + 1)
+    // The next steps fall back as well until the compilation is done, and then pick up
+    // the compiled graph from the cache.
+    let cachedCompiles = GetCounterValue("CachedCompile")
+    var pickedUp = false
+    for _ in 0..<500 where !pickedUp {
+      let fallbackSteps = GetCounterValue("OpByOpFallbackSteps")
+      XCTAssertEqual(step(on: Device.defaultXLA), expected)
+      pickedUp = GetCounterValue("OpByOpFallbackSteps") == fallbackSteps
+      if !pickedUp {
+        Thread.sleep(forTimeInterval: 0.01)
+      }
+    }
+    XCTAssertTrue(pickedUp)
+    XCTAssertGreaterThan(GetCounterValue("CachedCompile"), cachedCompiles)
+    XCTAssertEqual(GetCounterValue("BackgroundCompiles"), backgroundCompiles + 1)
+  }
+
+  func testParallelLoweringMatchesSerialLowering() throws {
+    // Independent roots using the parameters in different orders, so that the lowering
+    // groups see them in another order than the serial lowering declares them in.
+    func step(on device: Device) -> [[Int32]] {
+      let parameters = (1...4).map { i in
+        Tensor<Int32>(shape: [6, 5], scalars: (0..<30).map { Int32($0 * i % 7) }, on: device)
+      }
+      let roots: [Tensor<Int32>] = (0..<4).map { i in
+        var x = parameters[(i + 1) % 4]
+        for j in 0..<8 {
+          x = x * parameters[(i + j) % 4] + parameters[(3 * j + i) % 4]
+        }
+        return x.sum(alongAxes: 1)
+      }
+      LazyTensorBarrier()
+      return roots.map { $0.scalars }
+    }
+    let expected = step(on: Device.defaultTFEager)
+    let parallelLowerings = GetCounterValue("ParallelLowerings")
+    SetParallelLowering(false, 0)
+    let serial = step(on: Device.defaultXLA)
+    XCTAssertEqual(GetCounterValue("ParallelLowerings"), parallelLowerings)
+    SetParallelLowering(true, 16)
+    defer { SetParallelLowering(false, 10000) }
+    let parallel = step(on: Device.defaultXLA)
+    XCTAssertEqual(GetCounterValue("ParallelLowerings"), parallelLowerings + 1)
+    XCTAssertEqual(serial, expected)
+    XCTAssertEqual(parallel, serial)
+  }
+
+  func testSyncLiveTensorsVisitsDirtyTensors() throws {
+    let device = Device.defaultXLA
+    LazyTensorBarrier()
+    // The uploaded tensors only hold host data until the next sync. They are spread over
+    // all the shards of the registry.
+    let uploaded = (0..<64).map { Tensor<Float>(shape: [2], scalars: [Float($0), 1], on: device) }
+    var dirtyTensors = GetCounterValue("SyncLiveDirtyTensors")
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("SyncLiveDirtyTensors"), dirtyTensors + 64)
+    // Nothing changed since, so the next sync visits no tensor.
+    dirtyTensors = GetCounterValue("SyncLiveDirtyTensors")
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("SyncLiveDirtyTensors"), dirtyTensors)
+    // Only the tensors with pending IR are visited, including the ones created by other
+    // threads, and the dropped ones are skipped.
+    var products = [Tensor<Float>?](repeating: nil, count: 32)
+    products.withUnsafeMutableBufferPointer { buffer in
+      DispatchQueue.concurrentPerform(iterations: buffer.count) { i in
+        buffer[i] = uploaded[i] * uploaded[i + 32]
+        _ = uploaded[i] + uploaded[i + 32]
+      }
+    }
+    LazyTensorBarrier()
+    XCTAssertEqual(GetCounterValue("SyncLiveDirtyTensors"), dirtyTensors + 32)
+    for (i, product) in products.enumerated() {
+      XCTAssertEqual(product!.scalars, [Float(i * (i + 32)), 1])
+    }
+    XCTAssertEqual(uploaded[5].scalars, [5, 1])
+  }
+
+  func testObjectPoolReusesBlocks() throws {
+    let x = Tensor<Float>(shape: [2], scalars: [1, 2], on: Device.defaultXLA)
+    // Fills the free lists of this thread with the blocks of the dropped results.
+    for _ in 0..<100 {
+      _ = x * x + x
+    }
+    // In the steady state, the handles and the tensor data of the new results reuse them.
+    let heapAllocations = GetCounterValue("PoolHeapAllocations")
+    for _ in 0..<1000 {
+      _ = x * x + x
+    }
+    XCTAssertEqual(GetCounterValue("PoolHeapAllocations"), heapAllocations)
+    XCTAssertEqual((x * x + x).scalars, [2, 6])
+  }
+
+  func testCheckpointReaderLoadsTensors() throws {
+    // Writes an X10 checkpoint by hand: the header, padded to the 64 bytes alignment, with the
+    // index of the entries, and their contents at aligned offsets within the data section.
+    func append<T: FixedWidthInteger>(_ value: T, to bytes: inout [UInt8]) {
+      withUnsafeBytes(of: value.littleEndian) { bytes.append(contentsOf: $0) }
+    }
+    func padded(_ bytes: [UInt8]) -> [UInt8] {
+      bytes + [UInt8](repeating: 0, count: (64 - bytes.count % 64) % 64)
+    }
+    let weights: [Float] = (0..<12).map { Float($0) / 4 }
+    let steps: [Int32] = [7, -3, 1 << 20]
+    // Names, xla::PrimitiveType (F32 and S32), dimensions and contents.
+    let entries: [(String, Int32, [Int64], [UInt8])] = [
+      ("weights", 11, [3, 4], weights.withUnsafeBytes { Array($0) }),
+      ("steps", 4, [3], steps.withUnsafeBytes { Array($0) }),
+    ]
+    var index: [UInt8] = []
+    append(UInt64(entries.count), to: &index)
+    var offset = 0
+    for (name, type, dimensions, content) in entries {
+      append(UInt32(name.utf8.count), to: &index)
+      index += Array(name.utf8)
+      append(type, to: &index)
+      append(UInt32(dimensions.count), to: &index)
+      dimensions.forEach { append($0, to: &index) }
+      append(UInt64(offset), to: &index)
+      append(UInt64(content.count), to: &index)
+      append(UInt32(0), to: &index)
+      append(UInt64(content.count), to: &index)
+      offset += padded(content).count
+    }
+    var header = Array("X10CKPT1".utf8)
+    append(UInt64(index.count), to: &header)
+    let file = padded(header + index) + entries.flatMap { padded($0.3) }
+    let path =
+      NSTemporaryDirectory() + "x10_reader_\(ProcessInfo.processInfo.processIdentifier).ckpt"
+    XCTAssertTrue(FileManager.default.createFile(atPath: path, contents: Data(file)))
+    defer { try? FileManager.default.removeItem(atPath: path) }
+
+    let reader = XLACheckpointReader(path: path)
+    XCTAssertEqual(reader.names, ["weights", "steps"])
+    let tensors = reader.load(on: Device.defaultXLA)
+    let loadedWeights = try XCTUnwrap(tensors["weights"] as? Tensor<Float>)
+    XCTAssertEqual(loadedWeights.device, Device.defaultXLA)
+    XCTAssertEqual(loadedWeights.shape, [3, 4])
+    XCTAssertEqual(loadedWeights.scalars, weights)
+    let loadedSteps = try XCTUnwrap(tensors["steps"] as? Tensor<Int32>)
+    XCTAssertEqual(loadedSteps.shape, [3])
+    XCTAssertEqual(loadedSteps.scalars, steps)
+  }
+
+  func testCheckpointWriterRoundTrip() throws {
+    let device = Device.defaultXLA
+    let weights = Tensor<Float>(
+      shape: [64, 32], scalars: (0..<2048).map { Float($0 % 16) }, on: device)
+    let tensors: [String: AnyTensor] = [
+      "weights": weights * 2,
+      "steps": Tensor<Int32>([7, -3, 1 << 20], on: device),
+      "mask": Tensor<Bool>([true, false, true, true], on: device),
+    ]
+    var sizes: [Int] = []
+    for compress in [false, true] {
+      let path =
+        NSTemporaryDirectory() + "x10_writer_\(ProcessInfo.processInfo.processIdentifier).ckpt"
+      defer { try? FileManager.default.removeItem(atPath: path) }
+      LazyTensorBarrier()
+      let writer = XLACheckpointWriter(path: path, tensors: tensors, compress: compress)
+      sizes.append(writer.wait())
+      XCTAssertTrue(writer.isDone)
+
+      let reader = XLACheckpointReader(path: path)
+      XCTAssertEqual(reader.names, ["mask", "steps", "weights"])
+      let loaded = reader.load(on: device)
+      let loadedWeights = try XCTUnwrap(loaded["weights"] as? Tensor<Float>)
+      XCTAssertEqual(loadedWeights.shape, [64, 32])
+      XCTAssertEqual(loadedWeights.scalars, (weights * 2).scalars)
+      XCTAssertEqual((loaded["steps"] as? Tensor<Int32>)?.scalars, [7, -3, 1 << 20])
+      XCTAssertEqual((loaded["mask"] as? Tensor<Bool>)?.scalars, [true, false, true, true])
+    }
+    // The repeated weights compress well.
+    XCTAssertLessThan(sizes[1], sizes[0])
+  }
+
+  func testMultiWaitCompletionsAndContinuations() throws {
+    XCTAssertEqual(RunMultiWaitChecks(200), 0)
+  }
+
+  func testDataBarrierWaitsOnlyForPendingData() throws {
+    let device = Device.defaultXLA
+    // Materialized by a completed computation, so its data is on device and not pending.
+    let unrelated = Tensor<Float>(shape: [2, 3], scalars: [1, 2, 3, 4, 5, 6], on: device) * 2
+    LazyTensorBarrier(on: device, wait: true)
+
+    // A long chain of matmuls, scheduled without waiting: its result is the placeholder of the
+    // computation in flight. The operand is uploaded, so that the chain is not constant folded.
+    let m = Tensor<Float>(
+      shape: [1024, 1024], scalars: [Float](repeating: 1.0 / 1024, count: 1024 * 1024),
+      on: device)
+    var pending = m
+    for _ in 0..<24 {
+      pending = matmul(pending, m)
+    }
+    LazyTensorBarrier(on: device)
+
+    let waits = GetCounterValue("DataBarrierWaits")
+    XCTAssertEqual(unrelated.scalars, [2, 4, 6, 8, 10, 12])
+    XCTAssertEqual(GetCounterValue("DataBarrierWaits"), waits)
+    // The computation is still running when the placeholder is read, since the read of the
+    // unrelated tensor did not wait for it.
+    XCTAssertEqual(pending.scalars.count, 1024 * 1024)
+    XCTAssertEqual(GetCounterValue("DataBarrierWaits"), waits + 1)
+  }
 }
 
 final class MultiDeviceAPITests: XCTestCase {